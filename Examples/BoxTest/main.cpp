@@ -1,7 +1,10 @@
 #include "main.h"
 
-int main()
+int main(int argc, char *argv[])
 {
+	// Pass --measure-recording to see how draw recording scales with the number of threads
+	bool measureRecording = (argc > 1 && std::string(argv[1]) == "--measure-recording");
+
 	try
 	{
 		// Window settings
@@ -42,10 +45,30 @@ int main()
 		srand(static_cast<unsigned int>(time(0)));
 
 		// And 99,999 of its friends...
-		for (int i = 0; i < 99999; ++i)
+		std::vector<glm::vec3> positions(99999);
+
+		for (auto &position : positions)
+		{
+			position = glm::vec3(rand() % 200000 / 250.0f, rand() % 200000 / 250.f, rand() % 200000 / 250.0f);
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		yay->CreateInstances(static_cast<uint32_t>(positions.size()), positions.data());
+		std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+
+		std::cout << "Created " << positions.size() << " instances in " << took.count() * 1000.0 << " ms ("
+		          << positions.size() / took.count() / 1e6 << " million per second)" << std::endl;
+
+		// Recording only has something to split up when there are lots of separate objects
+		if (measureRecording)
 		{
-			auto inst = yay->CreateInstance();
-			inst->SetPosition(glm::vec3(rand() % 200000 / 250.0f, rand() % 200000 / 250.f, rand() % 200000 / 250.0f));
+			for (int i = 0; i < 20000; ++i)
+			{
+				auto box = scene->LoadModel("../../Models/box.obj");
+				box->SetPosition(glm::vec3(rand() % 200000 / 250.0f, rand() % 200000 / 250.f, rand() % 200000 / 250.0f));
+				box->SetMaterial(txt);
+				box->SetScale(0.1f);
+			}
 		}
 
 		// Let there be light!
@@ -68,6 +91,21 @@ int main()
 		// The scene must now be actualized. This is how loaded resources are handed over to Vulkan.
 		scene->Actualize();
 
+		if (measureRecording)
+		{
+			uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+
+			for (uint32_t threads = 1; threads <= cores; ++threads)
+			{
+				kitty->SetRecordingThreads(threads);
+				std::cout << "Recorded scene draws with " << threads << " thread(s) in "
+				          << kitty->GetLastRecordTime() << " ms" << std::endl;
+			}
+
+			// Back to one thread per core
+			kitty->SetRecordingThreads(0);
+		}
+
 		// Now we go watch the pretties!
 		while (kitty->IsRunning() && !stopRunning)
 		{
@@ -1,9 +1,11 @@
 #ifndef KENGINE_MAIN_H
 #define KENGINE_MAIN_H
 
+#include <chrono>
 #include <cmath>
 #include <iostream>
 #include <sstream>
+#include <thread>
 #include "../../Kitty/include/KEngine.h"
 #include <random>
 
@@ -3,7 +3,8 @@
  * IObject.cpp
  *
  * This class is a generic scene node, it just has a more newbie friendly name because
- * friendly names are nice. :)
+ * friendly names are nice. :) The node's data lives in the scene's entity store, the
+ * node itself only knows which entity is its own.
  *
  * \author Krista Koivisto
  * \copyright Read included LICENSE file.
@@ -16,25 +17,33 @@ namespace Kitty
 {
 	KInstancedObject *IObject::CreateInstance()
 	{
-		instanceCount++;
+		context->GetEntityStore().Render(handle)->instanceCount++;
 		return context->AddObjectInstance(this);
 	}
 
+	KInstancedObject *IObject::CreateInstances(uint32_t count, const glm::vec3 *positions,
+	                                           const glm::quat *rotations, const float *scales)
+	{
+		context->GetEntityStore().Render(handle)->instanceCount += count;
+		return context->AddObjectInstances(this, count, positions, rotations, scales);
+	}
+
 	void IObject::SetMaterial(KMaterial *material)
 	{
-		mat = material;
+		context->GetEntityStore().Render(handle)->material = material;
+		context->ObjectChanged(this, true);
 	}
 
 	void IObject::SetPosition(glm::vec3 newPosition)
 	{
-		position = newPosition;
-		translationMatrix = glm::translate(glm::mat4(), position);
+		context->GetEntityStore().Transform(handle)->position = newPosition;
+		TransformChanged();
 	}
 
 	void IObject::SetScale(glm::vec3 newScale)
 	{
-		scale = newScale;
-		scaleMatrix = glm::scale(glm::mat4(), scale);
+		context->GetEntityStore().Transform(handle)->scale = newScale;
+		TransformChanged();
 	}
 
 	void IObject::SetScale(float newScale)
@@ -44,9 +53,8 @@ namespace Kitty
 
 	void IObject::SetRotation(glm::vec4 newRotation)
 	{
-		rotation = newRotation;
-		rotationMatrix = glm::rotate(glm::mat4(), rotation.w * 3.14159f / 180,
-		                             glm::vec3(rotation.x, rotation.y, rotation.z));
+		context->GetEntityStore().Transform(handle)->rotation = newRotation;
+		TransformChanged();
 	}
 
 	void IObject::SetRotation(glm::vec3 axis, float newRotation)
@@ -54,8 +62,75 @@ namespace Kitty
 		SetRotation(glm::vec4(axis, newRotation));
 	}
 
-	void IObject::SetIndex(uint32_t objectIndex)
+	void IObject::SetStatic(bool makeStatic)
+	{
+		// Only takes effect when the scene is next actualized, nothing to tell it yet
+		context->GetEntityStore().Render(handle)->isStatic = makeStatic;
+	}
+
+	void IObject::SetHidden(bool hide)
+	{
+		context->GetEntityStore().Render(handle)->hidden = hide;
+		context->ObjectChanged(this, true, true);
+	}
+
+	void IObject::TransformChanged()
+	{
+		KTransformComponent *transform = context->GetEntityStore().Transform(handle);
+
+		glm::mat4 rotationMatrix = glm::rotate(glm::mat4(), transform->rotation.w * 3.14159f / 180,
+		                                       glm::vec3(transform->rotation));
+		transform->matrix = glm::translate(glm::mat4(), transform->position) * rotationMatrix *
+		                    glm::scale(glm::mat4(), transform->scale);
+
+		context->ObjectChanged(this, false);
+	}
+
+	KMesh *IObject::GetMesh()
+	{
+		return context->GetEntityStore().Render(handle)->mesh;
+	}
+
+	KMaterial *IObject::GetMaterial()
+	{
+		return context->GetEntityStore().Render(handle)->material;
+	}
+
+	glm::vec3 IObject::GetPosition()
 	{
-		index = objectIndex;
+		return context->GetEntityStore().Transform(handle)->position;
+	}
+
+	glm::vec4 IObject::GetRotation()
+	{
+		return context->GetEntityStore().Transform(handle)->rotation;
+	}
+
+	glm::vec3 IObject::GetScale()
+	{
+		return context->GetEntityStore().Transform(handle)->scale;
+	}
+
+	glm::mat4 IObject::GetModelMatrix()
+	{
+		return context->GetEntityStore().Transform(handle)->matrix;
+	}
+
+	uint32_t IObject::GetInstanceCount()
+	{
+		return context->GetEntityStore().Render(handle)->instanceCount;
+	}
+
+	bool IObject::IsStatic()
+	{
+		return context->GetEntityStore().Render(handle)->isStatic;
+	}
+
+	uint32_t IObject::GetIndex()
+	{
+		uint32_t archetype = 0, row = 0;
+		context->GetEntityStore().Resolve(handle, archetype, row);
+
+		return row;
 	}
-}
\ No newline at end of file
+}
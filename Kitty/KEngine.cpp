@@ -13,6 +13,7 @@
 
 #include "include/KEngine.h"
 #include "include/KWindowGLFW.h"
+#include "include/Vulkan/KVulkanCommandRecorder.h"
 
 namespace Kitty
 {
@@ -71,6 +72,31 @@ namespace Kitty
 	{
 		if (window->Update() == Window::KW_OK)
 		{
+			if (resizePending)
+			{
+				Vector2<int> size = window->GetDimensions();
+
+				// Nothing can be drawn to a minimized window, wait until it has a size again
+				if (size.x == 0 || size.y == 0) return KE_OK;
+
+				auto sinceResize = std::chrono::duration_cast<std::chrono::milliseconds>(
+						std::chrono::high_resolution_clock::now() - lastResize).count();
+
+				if (sinceResize >= settings.swapChainResizeDelay)
+				{
+					resizePending = false;
+
+					if (vulkan->outdatedSwapChainCallback != nullptr)
+					{
+						vulkan->outdatedSwapChainCallback();
+					}
+					else
+					{
+						vulkan->RecreateSwapChain();
+					}
+				}
+			}
+
 			vulkan->DrawFrame();
 
 			return KE_OK;
@@ -97,18 +123,21 @@ namespace Kitty
 		return fps;
 	}
 
-	void KEngine::OnWindowResize(Window::IWindow *window, int width, int height)
+	void KEngine::SetRecordingThreads(uint32_t threadCount)
 	{
-		vulkan->FinishDrawing();
+		vulkan->SetRecordingThreads(threadCount);
+	}
 
-		if (vulkan->outdatedSwapChainCallback != nullptr)
-		{
-			vulkan->outdatedSwapChainCallback();
-		}
-		else
-		{
-			vulkan->RecreateSwapChain();
-		}
+	double KEngine::GetLastRecordTime()
+	{
+		return vulkan->recorder->GetLastRecordTime();
+	}
+
+	void KEngine::OnWindowResize(Window::IWindow *window, int width, int height)
+	{
+		// Dragging the window edge fires lots of these, only resize once the size has settled
+		resizePending = true;
+		lastResize = std::chrono::high_resolution_clock::now();
 	}
 
 	KScene *KEngine::CreateScene(ITextureLoader *textureLoader)
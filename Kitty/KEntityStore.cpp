@@ -0,0 +1,171 @@
+/**
+ * Kitty Engine
+ * KEntityStore.cpp
+ *
+ * Archetype based storage for scene objects. Objects with the same set
+ * of components share an archetype, which keeps each component in a
+ * column of its own so systems run over tightly packed arrays instead
+ * of chasing object pointers. Rows are removed by moving the last row
+ * into their place, and entities are found through generational handles
+ * which follow them as they move.
+ *
+ * \author Krista Koivisto
+ * \copyright Read included LICENSE file.
+ */
+
+#include "include/KEntityStore.h"
+
+namespace Kitty
+{
+	uint32_t KArchetype::Add(KObject *owner, KHandle entity)
+	{
+		owners.push_back(owner);
+		entities.push_back(entity);
+
+		if (Has(KC_TRANSFORM)) transforms.emplace_back();
+		if (Has(KC_RENDER)) renders.emplace_back();
+		if (Has(KC_BOUNDS)) bounds.emplace_back(0.0f);
+		if (Has(KC_LIGHTS)) lights.emplace_back();
+
+		return Size() - 1;
+	}
+
+	void KArchetype::Remove(uint32_t row)
+	{
+		uint32_t last = Size() - 1;
+		if (row != last) Swap(row, last);
+
+		owners.pop_back();
+		entities.pop_back();
+
+		if (Has(KC_TRANSFORM)) transforms.pop_back();
+		if (Has(KC_RENDER)) renders.pop_back();
+		if (Has(KC_BOUNDS)) bounds.pop_back();
+		if (Has(KC_LIGHTS)) lights.pop_back();
+	}
+
+	void KArchetype::Swap(uint32_t a, uint32_t b)
+	{
+		std::swap(owners[a], owners[b]);
+		std::swap(entities[a], entities[b]);
+
+		if (Has(KC_TRANSFORM)) std::swap(transforms[a], transforms[b]);
+		if (Has(KC_RENDER)) std::swap(renders[a], renders[b]);
+		if (Has(KC_BOUNDS)) std::swap(bounds[a], bounds[b]);
+		if (Has(KC_LIGHTS)) std::swap(lights[a], lights[b]);
+	}
+
+	KEntityStore::KEntityStore()
+	{
+		archetypes.emplace_back(KC_TRANSFORM | KC_RENDER | KC_BOUNDS | KC_LIGHTS); // KA_DRAWN
+		archetypes.emplace_back(KC_TRANSFORM | KC_RENDER); // KA_STATIC
+	}
+
+	void KEntityStore::SetJobRunner(KJobRunner runner)
+	{
+		for (auto &archetype : archetypes)
+		{
+			archetype.runner = runner;
+		}
+	}
+
+	KHandle KEntityStore::Create(uint32_t archetype, KObject *owner)
+	{
+		KArchetype &target = archetypes[archetype];
+		auto row = target.Size();
+
+		KHandle entity = handles.Create((archetype << KE_ENTITY_ROW_BITS) | row);
+		target.Add(owner, entity);
+
+		return entity;
+	}
+
+	bool KEntityStore::Destroy(KHandle entity)
+	{
+		uint32_t archetype = 0, row = 0;
+		if (!Resolve(entity, archetype, row)) return false;
+
+		KArchetype &source = archetypes[archetype];
+		uint32_t last = source.Size() - 1;
+
+		if (row != last) handles.Move(source.entities[last], (archetype << KE_ENTITY_ROW_BITS) | row);
+
+		source.Remove(row);
+		handles.Release(entity);
+
+		return true;
+	}
+
+	void KEntityStore::Migrate(KHandle entity, uint32_t archetype)
+	{
+		uint32_t from = 0, row = 0;
+		if (!Resolve(entity, from, row) || from == archetype) return;
+
+		KArchetype &source = archetypes[from];
+		KArchetype &target = archetypes[archetype];
+		uint32_t newRow = target.Add(source.owners[row], entity);
+
+		if (source.Has(KC_TRANSFORM) && target.Has(KC_TRANSFORM)) target.transforms[newRow] = source.transforms[row];
+		if (source.Has(KC_RENDER) && target.Has(KC_RENDER)) target.renders[newRow] = source.renders[row];
+		if (source.Has(KC_BOUNDS) && target.Has(KC_BOUNDS)) target.bounds[newRow] = source.bounds[row];
+		if (source.Has(KC_LIGHTS) && target.Has(KC_LIGHTS)) target.lights[newRow] = source.lights[row];
+
+		uint32_t last = source.Size() - 1;
+		if (row != last) handles.Move(source.entities[last], (from << KE_ENTITY_ROW_BITS) | row);
+
+		source.Remove(row);
+		handles.Move(entity, (archetype << KE_ENTITY_ROW_BITS) | newRow);
+	}
+
+	void KEntityStore::Swap(uint32_t archetype, uint32_t a, uint32_t b)
+	{
+		if (a == b) return;
+
+		KArchetype &rows = archetypes[archetype];
+		rows.Swap(a, b);
+
+		handles.Move(rows.entities[a], (archetype << KE_ENTITY_ROW_BITS) | a);
+		handles.Move(rows.entities[b], (archetype << KE_ENTITY_ROW_BITS) | b);
+	}
+
+	bool KEntityStore::Resolve(KHandle entity, uint32_t &archetype, uint32_t &row) const
+	{
+		uint32_t location = 0;
+		if (!handles.Resolve(entity, location)) return false;
+
+		archetype = location >> KE_ENTITY_ROW_BITS;
+		row = location & KE_ENTITY_ROW_MASK;
+
+		return true;
+	}
+
+	KTransformComponent *KEntityStore::Transform(KHandle entity)
+	{
+		uint32_t archetype = 0, row = 0;
+		if (!Resolve(entity, archetype, row) || !archetypes[archetype].Has(KC_TRANSFORM)) return nullptr;
+
+		return &archetypes[archetype].transforms[row];
+	}
+
+	KRenderComponent *KEntityStore::Render(KHandle entity)
+	{
+		uint32_t archetype = 0, row = 0;
+		if (!Resolve(entity, archetype, row) || !archetypes[archetype].Has(KC_RENDER)) return nullptr;
+
+		return &archetypes[archetype].renders[row];
+	}
+
+	void KEntityStore::Clear()
+	{
+		for (auto &archetype : archetypes)
+		{
+			// Rows go, the job runner stays for whatever is created next
+			KJobRunner runner = archetype.runner;
+
+			archetype = KArchetype(archetype.components);
+			archetype.runner = runner;
+		}
+
+		handles.Clear();
+	}
+}
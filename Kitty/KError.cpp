@@ -57,6 +57,10 @@ namespace Kitty
 				case KE_UNSUPPORTED_LAYOUT: return "Unsupported layout transition when loading image for texture!";
 				case KE_MODEL_LOAD_FAIL: return "Failed to load object model!";
 				case KE_UNKNOWN_BUFFER_TYPE: return "Can't create buffer; unknown buffer type!";
+				case KE_VULKAN_FENCE_FAIL: return "Failed to create Vulkan fence!";
+				case KE_VULKAN_TRANSFER_FAIL: return "Failed to submit data to the transfer queue. It's stuck in the mail somewhere. :(";
+				case KE_VULKAN_PIPELINE_CACHE_FAIL: return "Failed to create Vulkan pipeline cache!";
+				case KE_VULKAN_CPIPELINE_FAIL: return "Failed to create Vulkan compute pipeline! (This could indicate an error with your shaders.)";
 
 				case KE_UNKNOWN_VULKAN:
 				case KE_UNKNOWN_ERR:
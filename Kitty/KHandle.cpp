@@ -0,0 +1,76 @@
+/**
+ * Kitty Engine
+ * KHandle.cpp
+ *
+ * Generational handles for scene entities. A handle names a slot in a
+ * handle table and the generation the slot was on when the handle was
+ * made, so handles to removed entities are recognized as stale even
+ * after their slot has been reused. The table maps slots to wherever
+ * the entity currently sits in its densely packed storage.
+ *
+ * \author Krista Koivisto
+ * \copyright Read included LICENSE file.
+ */
+
+#include "include/KHandle.h"
+
+namespace Kitty
+{
+	KHandle KHandleTable::Create(uint32_t index)
+	{
+		KHandle handle = {};
+
+		if (!freeSlots.empty())
+		{
+			handle.slot = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		else
+		{
+			handle.slot = static_cast<uint32_t>(indices.size());
+			indices.push_back(0);
+			generations.push_back(0);
+		}
+
+		indices[handle.slot] = index;
+		handle.generation = generations[handle.slot];
+
+		return handle;
+	}
+
+	bool KHandleTable::Resolve(KHandle handle, uint32_t &index) const
+	{
+		if (handle.slot >= indices.size() || generations[handle.slot] != handle.generation) return false;
+
+		index = indices[handle.slot];
+		return true;
+	}
+
+	void KHandleTable::Move(KHandle handle, uint32_t index)
+	{
+		if (handle.slot >= indices.size() || generations[handle.slot] != handle.generation) return;
+
+		indices[handle.slot] = index;
+	}
+
+	void KHandleTable::Release(KHandle handle)
+	{
+		if (handle.slot >= indices.size() || generations[handle.slot] != handle.generation) return;
+
+		// Handles still pointing at the slot no longer match its generation
+		generations[handle.slot]++;
+		freeSlots.push_back(handle.slot);
+	}
+
+	void KHandleTable::Clear()
+	{
+		// Generations are kept so handles from before the clear stay stale
+		freeSlots.clear();
+
+		for (uint32_t slot = 0; slot < generations.size(); ++slot)
+		{
+			generations[slot]++;
+			freeSlots.push_back(slot);
+		}
+	}
+}
@@ -30,4 +30,27 @@ namespace Kitty
 
 		return buffer;
 	}
+
+	bool KHelper::WriteBinaryFile(const std::string& filename, const std::vector<char>& data)
+	{
+		std::string tempName = filename + ".tmp";
+		std::ofstream file(tempName, std::ios::trunc | std::ios::binary);
+
+		if (!file.is_open())
+			return false;
+
+		file.write(data.data(), data.size());
+		file.close();
+
+		if (file.fail())
+		{
+			std::remove(tempName.c_str());
+			return false;
+		}
+
+		// rename() won't replace an existing file everywhere
+		std::remove(filename.c_str());
+
+		return std::rename(tempName.c_str(), filename.c_str()) == 0;
+	}
 }
\ No newline at end of file
@@ -9,20 +9,70 @@
  */
 
 
+#include <glm/gtc/packing.hpp>
 #include "include/KInstancedObject.h"
+#include "include/KScene.h"
 
 namespace Kitty
 {
 	KInstancedObject::KInstancedObject(IObject *parent)
 	{
 		instanceParent = parent;
-		instanceData.rot = glm::vec3(0, 0, 0);
-		instanceData.pos = glm::vec3(0, 0, 0);
-		instanceData.scale = 1;
+		instanceData = {};
+		PackInstanceData();
+	}
+
+	KInstancedObject::KInstancedObject(IObject *parent, glm::vec3 newPosition, glm::quat newRotation, float newScale)
+	{
+		instanceParent = parent;
+		instanceData = {};
+		position = newPosition;
+		rotation = glm::normalize(newRotation);
+		scale = newScale;
+		PackInstanceData();
 	}
 
 	void KInstancedObject::SetPosition(glm::vec3 newPosition)
 	{
-		instanceData.pos = newPosition;
+		position = newPosition;
+		PackInstanceData();
+		InstanceChanged();
+	}
+
+	void KInstancedObject::SetRotation(glm::vec3 axis, float newRotation)
+	{
+		SetRotation(glm::angleAxis(glm::radians(newRotation), glm::normalize(axis)));
+	}
+
+	void KInstancedObject::SetRotation(glm::quat newRotation)
+	{
+		rotation = glm::normalize(newRotation);
+		PackInstanceData();
+		InstanceChanged();
+	}
+
+	void KInstancedObject::SetScale(float newScale)
+	{
+		scale = newScale;
+		PackInstanceData();
+		InstanceChanged();
+	}
+
+	void KInstancedObject::InstanceChanged()
+	{
+		KScene *scene = (instanceParent != nullptr) ? instanceParent->GetScene() : nullptr;
+		if (scene != nullptr) scene->InstanceChanged(this);
+	}
+
+	void KInstancedObject::PackInstanceData()
+	{
+		instanceData.pos = position;
+
+		// The shader normalizes the quaternion again, which takes care of the rounding
+		instanceData.rot[0] = static_cast<int16_t>(glm::packSnorm1x16(rotation.x));
+		instanceData.rot[1] = static_cast<int16_t>(glm::packSnorm1x16(rotation.y));
+		instanceData.rot[2] = static_cast<int16_t>(glm::packSnorm1x16(rotation.z));
+		instanceData.rot[3] = static_cast<int16_t>(glm::packSnorm1x16(rotation.w));
+		instanceData.scale = glm::packHalf1x16(scale);
 	}
 }
@@ -8,6 +8,7 @@
  * \copyright Read included LICENSE file.
  */
 
+#include <algorithm>
 #include "include/KLight.h"
 
 namespace Kitty
@@ -33,4 +34,29 @@ namespace Kitty
 	{
 		SetRotation(glm::vec4(axis, newRotation));
 	}
+
+	float KLight::GetRange()
+	{
+		float brightest = std::max(color.r, std::max(color.g, color.b));
+		if (brightest <= 0.0f) return 0.0f;
+		if (cutoff <= 0.0f) return std::numeric_limits<float>::infinity();
+
+		// Solve brightest / (c + l * d + q * d^2) = cutoff for d
+		float c = constantAttenuation - brightest / cutoff;
+		float l = linearAttenuation;
+		float q = quadraticAttenuation;
+
+		if (q > 0.0f)
+		{
+			return std::max((-l + std::sqrt(l * l - 4.0f * q * c)) / (2.0f * q), 0.0f);
+		}
+
+		if (l > 0.0f)
+		{
+			return std::max(-c / l, 0.0f);
+		}
+
+		// Constant attenuation only, the light reaches everything or nothing
+		return (c < 0.0f) ? std::numeric_limits<float>::infinity() : 0.0f;
+	}
 }
@@ -0,0 +1,128 @@
+/**
+ * Kitty Engine
+ * KLightClusters.cpp
+ *
+ * Light culling for clustered forward shading. The view frustum is split
+ * into screen space tiles and exponential depth slices, and each light is
+ * binned into the clusters its range reaches so fragments only need to
+ * consider the lights of the cluster they fall in.
+ *
+ * \author Krista Koivisto
+ * \copyright Read included LICENSE file.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include "include/KLightClusters.h"
+
+namespace Kitty
+{
+	KLightClusters::KLightClusters(uint32_t tileCountX, uint32_t tileCountY, uint32_t sliceCount, uint32_t maxLights)
+	{
+		tilesX = std::max(tileCountX, 1u);
+		tilesY = std::max(tileCountY, 1u);
+		slices = std::max(sliceCount, 1u);
+		maxLightsPerCluster = std::max(maxLights, 1u);
+	}
+
+	void KLightClusters::Build(const glm::mat4 &view, const glm::mat4 &proj, float zNear, float zFar, uint32_t width,
+	                           uint32_t height, const std::vector<KLight*> &lights, uint32_t lightCount, void *grid,
+	                           void *indices)
+	{
+		counts.assign(GetClusterCount(), 0);
+		auto lightIndices = static_cast<uint32_t *>(indices);
+
+		// Slices are spaced exponentially so clusters stay roughly cube shaped with distance
+		float logDepth = std::log(zFar / zNear);
+		float sliceScale = slices / logDepth;
+		float sliceBias = -(slices * std::log(zNear)) / logDepth;
+
+		auto SliceOf = [&](float depth) {
+			float slice = std::floor(std::log(depth) * sliceScale + sliceBias);
+			return static_cast<uint32_t>(glm::clamp(slice, 0.0f, slices - 1.0f));
+		};
+
+		// Map a normalized device coordinate to the tile containing it
+		auto TileOf = [](float ndc, uint32_t tiles) {
+			float tile = std::floor((glm::clamp(ndc, -1.0f, 1.0f) + 1.0f) * 0.5f * tiles);
+			return static_cast<uint32_t>(glm::clamp(tile, 0.0f, tiles - 1.0f));
+		};
+
+		lightCount = std::min(lightCount, static_cast<uint32_t>(lights.size()));
+
+		for (uint32_t i = 0; i < lightCount; ++i)
+		{
+			float range = lights[i]->GetRange();
+			if (range <= 0.0f) continue;
+
+			uint32_t minX = 0, maxX = tilesX - 1;
+			uint32_t minY = 0, maxY = tilesY - 1;
+			uint32_t minZ = 0, maxZ = slices - 1;
+
+			if (!std::isinf(range))
+			{
+				// View space looks down -z, work with positive depth instead
+				glm::vec3 center = glm::vec3(view * glm::vec4(lights[i]->GetPosition(), 1.0f));
+				float depth = -center.z;
+
+				float nearest = std::max(depth - range, zNear);
+				float farthest = std::min(depth + range, zFar);
+				if (nearest > farthest) continue;
+
+				minZ = SliceOf(nearest);
+				maxZ = SliceOf(farthest);
+
+				// x / depth is monotonic in both, so the corners of the sphere's bounds give the extents
+				const float big = std::numeric_limits<float>::max();
+				float ndc[2][2] = {{ big, -big }, { big, -big }};
+
+				for (float depthBound : { nearest, farthest })
+				{
+					for (float sign : { -1.0f, 1.0f })
+					{
+						float x = (center.x + sign * range) * proj[0][0] / depthBound;
+						float y = (center.y + sign * range) * proj[1][1] / depthBound;
+
+						ndc[0][0] = std::min(ndc[0][0], x);
+						ndc[0][1] = std::max(ndc[0][1], x);
+						ndc[1][0] = std::min(ndc[1][0], y);
+						ndc[1][1] = std::max(ndc[1][1], y);
+					}
+				}
+
+				if (ndc[0][0] > 1.0f || ndc[0][1] < -1.0f || ndc[1][0] > 1.0f || ndc[1][1] < -1.0f) continue;
+
+				minX = TileOf(ndc[0][0], tilesX);
+				maxX = TileOf(ndc[0][1], tilesX);
+				minY = TileOf(ndc[1][0], tilesY);
+				maxY = TileOf(ndc[1][1], tilesY);
+			}
+
+			for (uint32_t z = minZ; z <= maxZ; ++z)
+			{
+				for (uint32_t y = minY; y <= maxY; ++y)
+				{
+					for (uint32_t x = minX; x <= maxX; ++x)
+					{
+						uint32_t cluster = x + tilesX * (y + tilesY * z);
+						uint32_t &count = counts[cluster];
+
+						if (count < maxLightsPerCluster)
+						{
+							lightIndices[cluster * maxLightsPerCluster + count++] = i;
+						}
+					}
+				}
+			}
+		}
+
+		KClusterGridHeader header = {};
+		header.size = glm::uvec4(tilesX, tilesY, slices, maxLightsPerCluster);
+		header.params = glm::vec4(width / (float) tilesX, height / (float) tilesY, sliceScale, sliceBias);
+
+		memcpy(grid, &header, sizeof(header));
+		memcpy(static_cast<char *>(grid) + sizeof(header), counts.data(), counts.size() * sizeof(uint32_t));
+	}
+}
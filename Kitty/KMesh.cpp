@@ -10,6 +10,7 @@
 
 #include "include/KMesh.h"
 
+#include <algorithm>
 #include <utility>
 
 namespace Kitty
@@ -19,6 +20,37 @@ namespace Kitty
 		vertices = std::move(vx);
 		indices = std::move(ix);
 
+		UpdateBoundingSphere();
+
 		return KE_OK;
 	}
+
+	void KMesh::UpdateBoundingSphere()
+	{
+		if (vertices.empty())
+		{
+			boundingSphere = glm::vec4(0.0f);
+			return;
+		}
+
+		// Center of the bounding box is close enough to the optimal center for light selection
+		glm::vec3 low = vertices[0].pos;
+		glm::vec3 high = vertices[0].pos;
+
+		for (auto &vertex : vertices)
+		{
+			low = glm::min(low, vertex.pos);
+			high = glm::max(high, vertex.pos);
+		}
+
+		glm::vec3 center = (low + high) * 0.5f;
+		float radius = 0.0f;
+
+		for (auto &vertex : vertices)
+		{
+			radius = std::max(radius, glm::length(vertex.pos - center));
+		}
+
+		boundingSphere = glm::vec4(center, radius);
+	}
 }
@@ -10,12 +10,16 @@
  */
 
 #include "include/KObject.h"
+#include "include/KScene.h"
 
 namespace Kitty
 {
 	KObject::KObject(KScene *contextScene, KMesh *model)
 	{
 		context = contextScene;
-		mesh = model;
+
+		// Objects start out drawn on their own, the scene moves them around as they're marked static
+		handle = context->GetEntityStore().Create(KA_DRAWN, this);
+		context->GetEntityStore().Render(handle)->mesh = model;
 	}
 }
@@ -0,0 +1,168 @@
+/**
+ * Kitty Engine
+ * KPrefab.cpp
+ *
+ * Groups of objects instanced as a unit. Each part of a prefab is an
+ * object placed relative to the prefab, and every prefab instance is
+ * expanded into one instance of each part, so a structure made of
+ * several meshes still draws with one instanced draw per mesh.
+ *
+ * \author Krista Koivisto
+ * \copyright Read included LICENSE file.
+ */
+
+#include "include/KPrefab.h"
+#include "include/KScene.h"
+
+namespace Kitty
+{
+	KPrefab::KPrefabTransform KPrefab::Compose(const KPrefabTransform &outer, const KPrefabTransform &inner)
+	{
+		KPrefabTransform combined = {};
+		combined.position = outer.position + outer.rotation * (inner.position * outer.scale);
+		combined.rotation = outer.rotation * inner.rotation;
+		combined.scale = outer.scale * inner.scale;
+
+		return combined;
+	}
+
+	KPrefab::KPrefabTransform KPrefab::WorldToObject(KObject *object)
+	{
+		glm::vec4 rotation = object->GetRotation();
+
+		// Same rotation the object's model matrix is built with, the angle is in degrees
+		glm::quat objectRotation = glm::angleAxis(glm::radians(rotation.w), glm::normalize(glm::vec3(rotation)));
+
+		KPrefabTransform inverse = {};
+		inverse.rotation = glm::conjugate(objectRotation);
+		inverse.scale = 1.0f / object->GetScale().x;
+		inverse.position = inverse.rotation * (-object->GetPosition() * inverse.scale);
+
+		return inverse;
+	}
+
+	void KPrefab::InstancePart(KPrefabPart &part, uint32_t first, uint32_t count)
+	{
+		KObject *object = context->FindObject(part.object);
+		part.instances.resize(transforms.size());
+
+		if (object == nullptr || count == 0) return;
+
+		std::vector<glm::vec3> positions(count);
+		std::vector<glm::quat> rotations(count);
+		std::vector<float> scales(count);
+
+		KPrefabTransform objectSpace = WorldToObject(object);
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			KPrefabTransform placed = Compose(objectSpace, Compose(transforms[first + i], part.transform));
+			positions[i] = placed.position;
+			rotations[i] = placed.rotation;
+			scales[i] = placed.scale;
+		}
+
+		// One bulk creation per part keeps each part's instances in a single range
+		KInstancedObject *instances = object->CreateInstances(count, positions.data(), rotations.data(),
+		                                                      scales.data());
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			part.instances[first + i] = instances[i].GetHandle();
+
+			// Removed prefab instances don't get parts, but bulk creation made one anyway
+			if (removed[first + i])
+			{
+				context->RemoveInstance(part.instances[first + i]);
+				part.instances[first + i] = {};
+			}
+		}
+	}
+
+	int32_t KPrefab::AddPart(KObject *object, glm::vec3 position, glm::quat rotation, float scale)
+	{
+		if (object == nullptr || context->FindObject(object->GetHandle()) != object) return -1;
+
+		// The object is a template for its instances now, the prefab instances are what's seen of it
+		object->SetHidden(true);
+
+		KPrefabPart part = {};
+		part.object = object->GetHandle();
+		part.transform.position = position;
+		part.transform.rotation = glm::normalize(rotation);
+		part.transform.scale = scale;
+
+		InstancePart(part, 0, static_cast<uint32_t>(transforms.size()));
+		parts.push_back(part);
+
+		return static_cast<int32_t>(parts.size()) - 1;
+	}
+
+	uint32_t KPrefab::CreateInstance(glm::vec3 position, glm::quat rotation, float scale)
+	{
+		return CreateInstances(1, &position, &rotation, &scale);
+	}
+
+	uint32_t KPrefab::CreateInstances(uint32_t count, const glm::vec3 *positions, const glm::quat *rotations,
+	                                  const float *scales)
+	{
+		auto first = static_cast<uint32_t>(transforms.size());
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			KPrefabTransform transform = {};
+			if (positions != nullptr) transform.position = positions[i];
+			if (rotations != nullptr) transform.rotation = glm::normalize(rotations[i]);
+			if (scales != nullptr) transform.scale = scales[i];
+
+			transforms.push_back(transform);
+			removed.push_back(false);
+		}
+
+		for (auto &part : parts)
+		{
+			InstancePart(part, first, count);
+		}
+
+		return first;
+	}
+
+	bool KPrefab::SetInstanceTransform(uint32_t instance, glm::vec3 position, glm::quat rotation, float scale)
+	{
+		if (instance >= transforms.size() || removed[instance]) return false;
+
+		KPrefabTransform &transform = transforms[instance];
+		transform.position = position;
+		transform.rotation = glm::normalize(rotation);
+		transform.scale = scale;
+
+		for (auto &part : parts)
+		{
+			KObject *object = context->FindObject(part.object);
+			KInstancedObject *partInstance = context->FindInstance(part.instances[instance]);
+			if (object == nullptr || partInstance == nullptr) continue;
+
+			KPrefabTransform placed = Compose(WorldToObject(object), Compose(transform, part.transform));
+			partInstance->SetPosition(placed.position);
+			partInstance->SetRotation(placed.rotation);
+			partInstance->SetScale(placed.scale);
+		}
+
+		return true;
+	}
+
+	bool KPrefab::RemoveInstance(uint32_t instance)
+	{
+		if (instance >= transforms.size() || removed[instance]) return false;
+
+		for (auto &part : parts)
+		{
+			context->RemoveInstance(part.instances[instance]);
+			part.instances[instance] = {};
+		}
+
+		removed[instance] = true;
+
+		return true;
+	}
+}
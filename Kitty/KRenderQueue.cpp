@@ -0,0 +1,47 @@
+/**
+ * Kitty Engine
+ * KRenderQueue.cpp
+ *
+ * Draw ordering for the scene. Every draw gets a 64-bit key made of
+ * its pipeline, material, mesh and depth, and the keys are radix
+ * sorted so draws sharing state end up next to each other and can
+ * skip binding it again.
+ *
+ * \author Krista Koivisto
+ * \copyright Read included LICENSE file.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include "include/KRenderQueue.h"
+
+namespace Kitty
+{
+	uint64_t KRenderQueue::MakeKey(uint32_t pipeline, uint32_t material, uint32_t mesh, float depth, float zNear,
+	                               float zFar)
+	{
+		float clamped = std::min(std::max(depth, zNear), zFar);
+		float scaled = std::log(clamped / zNear) / std::log(zFar / zNear);
+		auto quantized = static_cast<uint64_t>(scaled * (KE_RENDER_QUEUE_DEPTH_BANDS - 1));
+
+		return (static_cast<uint64_t>(pipeline & 0xFF) << 56) |
+		       (static_cast<uint64_t>(material & 0xFFFFF) << 36) |
+		       (static_cast<uint64_t>(mesh & 0xFFFFF) << 16) |
+		       (quantized & 0xFFFF);
+	}
+
+	void KRenderQueue::Clear(size_t reserve)
+	{
+		sorter.Clear(reserve);
+	}
+
+	void KRenderQueue::Push(uint64_t key, uint32_t index)
+	{
+		sorter.Push(key, index);
+	}
+
+	void KRenderQueue::Sort()
+	{
+		sorter.Sort();
+	}
+}
@@ -19,8 +19,6 @@ namespace Kitty
 		context = mainContext;
 		vulkan = vulkanContext;
 
-		CreateUniformBuffers();
-
 		if (textureLoader == nullptr)
 		{
 			textureLoader = new KTextureLoaderSTB(context, vulkan);
@@ -45,8 +43,12 @@ namespace Kitty
 
 		objLoader = modelLoader;
 
-		context->settings.commands.sceneStaticRenderCallback = [this](VkCommandBuffer buf) {
-			StaticRenderCallback(buf);
+		context->settings.commands.sceneBatchCount = [this](uint32_t threadCount) {
+			return GetDrawBatchCount(threadCount);
+		};
+
+		context->settings.commands.sceneBatchRenderCallback = [this](VkCommandBuffer buf, uint32_t ii, uint32_t batch) {
+			BatchRenderCallback(buf, ii, batch);
 		};
 
 		context->settings.commands.sceneRenderCallback = [this](VkCommandBuffer *buf, uint32_t ii)
@@ -54,10 +56,30 @@ namespace Kitty
 			RenderCallback(buf, ii);
 		};
 
+		context->settings.commands.sceneLightingRenderCallback = [this](VkCommandBuffer buf, uint32_t ii) {
+			LightingRenderCallback(buf, ii);
+		};
+
 		dummyInstanceBuffer = new Vulkan::KVulkanBuffer(vulkan, 1, vertexBufferFlags, vertexMemFlags);
 		dummyVertexBuffer = new Vulkan::KVulkanBuffer(vulkan, 1, vertexBufferFlags, vertexMemFlags);
 		dummyIndexBuffer = new Vulkan::KVulkanBuffer(vulkan, 1, indexBufferFlags, indexMemFlags);
 		dummyMat = LoadImageTexture("");
+
+		renderQueue = new KRenderQueue();
+
+		// Systems and sorts borrow the command recorder's worker threads, they're idle while the scene updates
+		KJobRunner jobRunner = [this](uint32_t count, const std::function<void(uint32_t job)> &job) {
+			if (vulkan->recorder == nullptr)
+			{
+				for (uint32_t i = 0; i < count; ++i) job(i);
+				return;
+			}
+
+			vulkan->recorder->Run(count, job);
+		};
+
+		entities.SetJobRunner(jobRunner);
+		spatialSort.SetJobRunner(jobRunner);
 	}
 
 	KError KScene::Clear()
@@ -71,9 +93,8 @@ namespace Kitty
 
 	KObject *KScene::LoadModel(std::string filename)
 	{
+		// Objects add themselves to the entity store as they're created
 		auto obj = objLoader->LoadModel(std::move(filename));
-		objects.push_back(obj);
-
 		obj->SetMaterial(dummyMat);
 
 		return obj;
@@ -81,15 +102,313 @@ namespace Kitty
 
 	KInstancedObject *KScene::AddObjectInstance(IObject *parent)
 	{
-		auto obj = new KInstancedObject(parent);
+		auto obj = new (AllocateInstances(1)) KInstancedObject(parent);
+		obj->SetHandle(instanceHandles.Create(static_cast<uint32_t>(instancedObjects.size())));
 		instancedObjects.push_back(obj);
 
 		return obj;
 	}
 
+	KInstancedObject *KScene::AddObjectInstances(IObject *parent, uint32_t count, const glm::vec3 *positions,
+	                                             const glm::quat *rotations, const float *scales)
+	{
+		if (count == 0) return nullptr;
+
+		KInstancedObject *first = AllocateInstances(count);
+		instancedObjects.reserve(instancedObjects.size() + count);
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			glm::vec3 position = (positions != nullptr) ? positions[i] : glm::vec3(0.0f);
+			glm::quat rotation = (rotations != nullptr) ? rotations[i] : glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+			float scale = (scales != nullptr) ? scales[i] : 1.0f;
+
+			auto obj = new (first + i) KInstancedObject(parent, position, rotation, scale);
+			obj->SetHandle(instanceHandles.Create(static_cast<uint32_t>(instancedObjects.size())));
+			instancedObjects.push_back(obj);
+		}
+
+		return first;
+	}
+
+	KPrefab *KScene::CreatePrefab()
+	{
+		auto prefab = new KPrefab(this);
+		prefabs.push_back(prefab);
+
+		return prefab;
+	}
+
+	KInstancedObject *KScene::AllocateInstances(uint32_t count)
+	{
+		// Single instances take the place of removed ones first
+		if (count == 1 && !freeInstances.empty())
+		{
+			KInstancedObject *storage = freeInstances.back();
+			freeInstances.pop_back();
+
+			return storage;
+		}
+
+		if (instanceBlocks.empty() || instanceBlocks.back().capacity - instanceBlocks.back().used < count)
+		{
+			// Whatever is left of the previous block stays unused, bulk creations get a block of their own
+			KInstanceBlock block = {};
+			block.capacity = std::max(count, static_cast<uint32_t>(KE_INSTANCE_BLOCK_SIZE));
+			block.data = static_cast<KInstancedObject *>(::operator new(sizeof(KInstancedObject) * block.capacity));
+			instanceBlocks.push_back(block);
+		}
+
+		KInstanceBlock &block = instanceBlocks.back();
+		KInstancedObject *storage = block.data + block.used;
+		block.used += count;
+
+		return storage;
+	}
+
+	void KScene::FreeInstances()
+	{
+		// Removed instances are never destroyed one by one, which only works while there's nothing to destroy
+		static_assert(std::is_trivially_destructible<KInstancedObject>::value,
+		              "Instances are freed without running their destructors");
+
+		for (auto &block : instanceBlocks)
+		{
+			::operator delete(block.data);
+		}
+
+		instanceBlocks.clear();
+		freeInstances.clear();
+		instancedObjects.clear();
+		instanceRanges.clear();
+		instanceRangeOf.clear();
+		movedInstances.clear();
+		instanceCodes.clear();
+		actualizedInstances = 0;
+		instanceHandles.Clear();
+	}
+
+	void KScene::BuildInstanceRanges()
+	{
+		instancedObjects.erase(std::remove(instancedObjects.begin(), instancedObjects.end(), nullptr),
+		                       instancedObjects.end());
+
+		// Each object's instances are drawn with one call, so they have to sit next to each other.
+		// Parents are resolved to their rows once per run of instances sharing one, not per comparison.
+		std::vector<std::pair<uint32_t, KInstancedObject*>> keyed(instancedObjects.size());
+		IObject *lastParent = nullptr;
+		uint32_t parentRow = 0;
+
+		for (uint32_t i = 0; i < instancedObjects.size(); ++i)
+		{
+			IObject *parent = instancedObjects[i]->GetParent();
+
+			if (parent != lastParent)
+			{
+				lastParent = parent;
+				parentRow = parent->GetIndex();
+			}
+
+			keyed[i] = std::make_pair(parentRow, instancedObjects[i]);
+		}
+
+		std::stable_sort(keyed.begin(), keyed.end(), [](const std::pair<uint32_t, KInstancedObject*> &a,
+		                                                const std::pair<uint32_t, KInstancedObject*> &b) {
+			return a.first < b.first;
+		});
+
+		for (uint32_t i = 0; i < instancedObjects.size(); ++i)
+		{
+			instancedObjects[i] = keyed[i].second;
+		}
+
+		instanceRanges.clear();
+		instanceRangeOf.clear();
+
+		for (uint32_t i = 0; i < instancedObjects.size(); ++i)
+		{
+			IObject *parent = instancedObjects[i]->GetParent();
+			instanceHandles.Move(instancedObjects[i]->GetHandle(), i);
+
+			if (instanceRanges.empty() || instanceRanges.back().parent != parent)
+			{
+				instanceRangeOf[parent] = static_cast<uint32_t>(instanceRanges.size());
+				instanceRanges.push_back({ parent, i, 0 });
+			}
+
+			instanceRanges.back().count++;
+		}
+
+		actualizedInstances = static_cast<uint32_t>(instancedObjects.size());
+		movedInstances.clear();
+		instanceCodes.clear();
+
+		if (spatialInstanceOrder)
+		{
+			instanceCodes.assign(instancedObjects.size(), 0);
+
+			for (auto &range : instanceRanges)
+			{
+				SortInstanceRange(range);
+			}
+		}
+	}
+
+	void KScene::SortInstanceRange(KInstanceRange &range)
+	{
+		if (range.count < 2) return;
+
+		sortPositions.resize(range.count);
+
+		for (uint32_t i = 0; i < range.count; ++i)
+		{
+			sortPositions[i] = instancedObjects[range.first + i]->GetPosition();
+		}
+
+		const std::vector<uint32_t> &order = spatialSort.Sort(sortPositions.data(), range.count);
+		const std::vector<uint32_t> &codes = spatialSort.GetCodes();
+		sortScratch.assign(instancedObjects.begin() + range.first, instancedObjects.begin() + range.first + range.count);
+
+		// Instances moving later are placed by codes made in the same bounds
+		spatialSort.GetBounds(range.low, range.high);
+
+		for (uint32_t i = 0; i < range.count; ++i)
+		{
+			uint32_t index = range.first + i;
+			instanceCodes[index] = codes[i];
+
+			if (order[i] == i) continue;
+
+			instancedObjects[index] = sortScratch[order[i]];
+			instanceHandles.Move(instancedObjects[index]->GetHandle(), index);
+		}
+	}
+
+	void KScene::PlaceInstance(const KInstanceRange &range, uint32_t index, uint32_t code)
+	{
+		auto codes = instanceCodes.begin();
+		auto objects = instancedObjects.begin();
+		uint32_t end = range.first + range.count;
+		uint32_t first = index, last = index + 1;
+
+		// Every other instance of the range is in order, so the new place is found by binary search and
+		// only the instances between the old and the new place shift over by one
+		instanceCodes[index] = code;
+
+		if (index > range.first && code < instanceCodes[index - 1])
+		{
+			first = static_cast<uint32_t>(std::upper_bound(codes + range.first, codes + index, code) - codes);
+			std::rotate(codes + first, codes + index, codes + index + 1);
+			std::rotate(objects + first, objects + index, objects + index + 1);
+		}
+		else if (index + 1 < end && code > instanceCodes[index + 1])
+		{
+			last = static_cast<uint32_t>(std::lower_bound(codes + index + 1, codes + end, code) - codes);
+			std::rotate(codes + index, codes + index + 1, codes + last);
+			std::rotate(objects + index, objects + index + 1, objects + last);
+		}
+
+		for (uint32_t i = first; i < last; ++i)
+		{
+			instanceHandles.Move(instancedObjects[i]->GetHandle(), i);
+		}
+
+		UploadInstances(first, last - first);
+	}
+
+	void KScene::UpdateMovedInstances()
+	{
+		if (movedInstances.empty()) return;
+
+		// Instances are reported every time they change, several times a frame for some
+		std::sort(movedInstances.begin(), movedInstances.end());
+		movedInstances.erase(std::unique(movedInstances.begin(), movedInstances.end()), movedInstances.end());
+
+		// Codes are only made when the ranges were sorted at actualization
+		bool ordered = spatialInstanceOrder && !instanceCodes.empty();
+
+		for (auto instance : movedInstances)
+		{
+			uint32_t index = 0;
+
+			// Removed since it moved, or its storage went to a new instance which isn't actualized yet
+			if (!instanceHandles.Resolve(instance->GetHandle(), index) || index >= actualizedInstances) continue;
+
+			auto found = instanceRangeOf.find(instance->GetParent());
+
+			if (!ordered || found == instanceRangeOf.end())
+			{
+				UploadInstances(index, 1);
+				continue;
+			}
+
+			const KInstanceRange &range = instanceRanges[found->second];
+			PlaceInstance(range, index, KSpatialSort::MortonCode(instance->GetPosition(), range.low, range.high));
+		}
+
+		movedInstances.clear();
+	}
+
+	void KScene::UploadInstances(uint32_t first, uint32_t count)
+	{
+		if (count == 0 || first + count > instanceData.Size()) return;
+
+		IObject *lastParent = nullptr;
+		uint32_t parentRow = 0;
+
+		// Frames in flight still read their own slices, each slice picks the change up before it's drawn again
+		for (uint32_t i = first; i < first + count; ++i)
+		{
+			IObject *parent = instancedObjects[i]->GetParent();
+
+			// Spans normally lie within one range, so its parent only needs resolving once
+			if (parent != lastParent)
+			{
+				lastParent = parent;
+				parentRow = parent->GetIndex();
+			}
+
+			Vulkan::InstanceData data = instancedObjects[i]->GetInstanceData();
+			data.parent = parentRow;
+
+			instanceData.Write(i, data);
+		}
+
+		// The instances now in the slots may sit elsewhere than the ones before them
+		auto buckets = static_cast<uint32_t>(staleBuckets.size());
+
+		for (uint32_t b = first / KE_INSTANCE_BUCKET_SIZE; b < buckets && b * KE_INSTANCE_BUCKET_SIZE < first + count; ++b)
+		{
+			staleBuckets[b] = 1;
+		}
+	}
+
+	void KScene::CreateInstanceBuffer()
+	{
+		if (instanceBuffer != nullptr && instanceBuffer != dummyInstanceBuffer) delete (instanceBuffer);
+
+		if (instanceData.Empty())
+		{
+			instanceBuffer = dummyInstanceBuffer;
+			instanceSliceSize = 0;
+			return;
+		}
+
+		instanceSliceSize = sizeof(Vulkan::InstanceData) * instanceData.Size();
+
+		VkBufferUsageFlags usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+		VkMemoryPropertyFlags flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+		instanceBuffer = new Vulkan::KVulkanBuffer(vulkan, instanceSliceSize * uniformSlices, usage, flags);
+		instanceBuffer->Map();
+
+		instanceData.Reset(uniformSlices);
+	}
+
 	KMaterial *KScene::LoadImageTexture(std::string filename)
 	{
 		auto mat = texLoader->LoadImage(std::move(filename), KT_PROP_DIFFUSE);
+		mat->SetHandle(materialHandles.Create(static_cast<uint32_t>(materials.size())));
 		materials.push_back(mat);
 
 		return mat;
@@ -101,302 +420,1781 @@ namespace Kitty
 		auto mat = new KMaterial();
 		tex->SetImage2D_8R8G8B8A(data, width, height);
 		mat->SetTextureImage(tex, KT_PROP_DIFFUSE);
+		mat->SetHandle(materialHandles.Create(static_cast<uint32_t>(materials.size())));
 		materials.push_back(mat);
 
-		return mat;
-	}
+		return mat;
+	}
+
+	KLight *KScene::CreateLight()
+	{
+		auto light = new KLight(this);
+		light->SetHandle(lightHandles.Create(static_cast<uint32_t>(lights.size())));
+		lights.push_back(light);
+
+		return light;
+	}
+
+	bool KScene::RemoveObject(KHandle handle)
+	{
+		uint32_t archetype = 0, index = 0;
+		if (!entities.Resolve(handle, archetype, index)) return false;
+
+		KObject *object = entities.Get(archetype).owners[index];
+		KMesh *mesh = object->GetMesh();
+
+		if (object->GetInstanceCount() > 0) RemoveObjectInstances(object);
+
+		// The object's range stays empty until the next actualization, another object may get its address
+		auto range = instanceRangeOf.find(object);
+
+		if (range != instanceRangeOf.end())
+		{
+			instanceRanges[range->second].parent = nullptr;
+			instanceRangeOf.erase(range);
+		}
+
+		// Baked objects leave their chunk, the next update bakes it again without them
+		auto chunk = staticChunkOf.find(object);
+
+		if (chunk != staticChunkOf.end())
+		{
+			KStaticChunk &baked = staticChunks[chunk->second];
+			baked.objects.erase(std::find(baked.objects.begin(), baked.objects.end(), object));
+			baked.stale = true;
+			staticChunkOf.erase(chunk);
+		}
+
+		if (archetype == KA_DRAWN && index < actualizedObjects)
+		{
+			KArchetype &drawn = entities.Get(KA_DRAWN);
+
+			// Mesh data shared with other objects stays until the last of them is gone
+			auto users = meshUsers.find(mesh->GetBufferOffset());
+
+			if (users != meshUsers.end() && --users->second == 0)
+			{
+				RetireGeometry(mesh->GetBufferOffset(), static_cast<uint32_t>(mesh->vertices.size()),
+				               mesh->GetFirstIndex(), static_cast<uint32_t>(mesh->indices.size()));
+				meshUsers.erase(users);
+			}
+
+			// The last drawn object takes over the removed one's table entry
+			uint32_t last = actualizedObjects - 1;
+
+			if (index != last)
+			{
+				entities.Swap(KA_DRAWN, index, last);
+				objectData.Write(index, objectData[last]);
+
+				// Its instances find it through its table index
+				KObject *moved = drawn.owners[index];
+
+				if (moved->GetInstanceCount() > 0 && instanceRangeOf.count(moved))
+				{
+					KInstanceRange &instances = instanceRanges[instanceRangeOf[moved]];
+					UploadInstances(instances.first, instances.count);
+				}
+			}
+
+			// Static chunks follow the drawn objects in the table, a handful of entries to shift down
+			objectData.Erase(last);
+
+			// Not yet actualized objects aren't drawn from their row, the last of them can fill the gap
+			entities.Swap(KA_DRAWN, last, drawn.Size() - 1);
+
+			actualizedObjects--;
+			actualizedDraws--;
+		}
+
+		entities.Destroy(handle);
+
+		objLoader->RemoveFromCache(mesh);
+		delete(object);
+
+		return true;
+	}
+
+	bool KScene::RemoveInstance(KHandle handle)
+	{
+		uint32_t index = 0;
+		if (!instanceHandles.Resolve(handle, index)) return false;
+
+		KInstancedObject *instance = instancedObjects[index];
+		IObject *parent = instance->GetParent();
+
+		if (index < actualizedInstances)
+		{
+			// The last instance of the same object takes over the slot, the range is drawn one shorter
+			KInstanceRange &range = instanceRanges[instanceRangeOf[parent]];
+			uint32_t last = range.first + --range.count;
+
+			if (index != last)
+			{
+				instancedObjects[index] = instancedObjects[last];
+				instanceHandles.Move(instancedObjects[index]->GetHandle(), index);
+
+				// Ordered ranges put the instance taking over the slot back in its place
+				if (spatialInstanceOrder && !instanceCodes.empty()) PlaceInstance(range, index, instanceCodes[last]);
+				else UploadInstances(index, 1);
+			}
+
+			instancedObjects[last] = nullptr;
+			if (last / KE_INSTANCE_BUCKET_SIZE < staleBuckets.size()) staleBuckets[last / KE_INSTANCE_BUCKET_SIZE] = 1;
+
+			InvalidateInstanceBatches();
+		}
+		else
+		{
+			instancedObjects[index] = instancedObjects.back();
+			instanceHandles.Move(instancedObjects[index]->GetHandle(), index);
+			instancedObjects.pop_back();
+		}
+
+		entities.Render(parent->GetHandle())->instanceCount--;
+		instanceHandles.Release(handle);
+		freeInstances.push_back(instance);
+
+		return true;
+	}
+
+	void KScene::RemoveObjectInstances(IObject *parent)
+	{
+		auto range = instanceRangeOf.find(parent);
+
+		if (range != instanceRangeOf.end())
+		{
+			KInstanceRange &instances = instanceRanges[range->second];
+			MarkInstanceBuckets(parent);
+
+			for (uint32_t i = instances.first; i < instances.first + instances.count; ++i)
+			{
+				instanceHandles.Release(instancedObjects[i]->GetHandle());
+				freeInstances.push_back(instancedObjects[i]);
+				instancedObjects[i] = nullptr;
+			}
+
+			instances.count = 0;
+			InvalidateInstanceBatches();
+		}
+
+		for (uint32_t i = actualizedInstances; i < instancedObjects.size();)
+		{
+			if (instancedObjects[i]->GetParent() != parent)
+			{
+				++i;
+				continue;
+			}
+
+			instanceHandles.Release(instancedObjects[i]->GetHandle());
+			freeInstances.push_back(instancedObjects[i]);
+
+			instancedObjects[i] = instancedObjects.back();
+			instanceHandles.Move(instancedObjects[i]->GetHandle(), i);
+			instancedObjects.pop_back();
+		}
+
+		entities.Render(parent->GetHandle())->instanceCount = 0;
+	}
+
+	bool KScene::RemoveMaterial(KHandle handle)
+	{
+		uint32_t index = 0;
+		if (!materialHandles.Resolve(handle, index) || materials[index] == dummyMat) return false;
+
+		KMaterial *material = materials[index];
+
+		// Frames in flight may still be sampling its textures
+		vulkan->FinishDrawing();
+
+		for (uint32_t archetype = 0; archetype < KA_COUNT; ++archetype)
+		{
+			for (auto object : entities.Get(archetype).owners)
+			{
+				if (object->GetMaterial() == material) object->SetMaterial(dummyMat);
+			}
+		}
+
+		for (auto &chunk : staticChunks)
+		{
+			if (chunk.material == material) chunk.material = dummyMat;
+		}
+
+		materials[index] = materials.back();
+		materialHandles.Move(materials[index]->GetHandle(), index);
+		materials.pop_back();
+
+		materialHandles.Release(handle);
+		delete(material);
+
+		// Chunks and instances bind the material too, neither is tracked per batch
+		vulkan->cmdPool->InvalidateAllBatches();
+
+		return true;
+	}
+
+	bool KScene::RemoveLight(KHandle handle)
+	{
+		uint32_t index = 0;
+		if (!lightHandles.Resolve(handle, index)) return false;
+
+		KLight *light = lights[index];
+
+		// The light moved into the slot gets uploaded by the next update, which notices its data changed
+		lights[index] = lights.back();
+		lightHandles.Move(lights[index]->GetHandle(), index);
+		lights.pop_back();
+
+		lightHandles.Release(handle);
+		delete(light);
+
+		return true;
+	}
+
+	KObject *KScene::FindObject(KHandle handle)
+	{
+		uint32_t archetype = 0, index = 0;
+		return entities.Resolve(handle, archetype, index) ? entities.Get(archetype).owners[index] : nullptr;
+	}
+
+	KInstancedObject *KScene::FindInstance(KHandle handle)
+	{
+		uint32_t index = 0;
+		return instanceHandles.Resolve(handle, index) ? instancedObjects[index] : nullptr;
+	}
+
+	KMaterial *KScene::FindMaterial(KHandle handle)
+	{
+		uint32_t index = 0;
+		return materialHandles.Resolve(handle, index) ? materials[index] : nullptr;
+	}
+
+	KLight *KScene::FindLight(KHandle handle)
+	{
+		uint32_t index = 0;
+		return lightHandles.Resolve(handle, index) ? lights[index] : nullptr;
+	}
+
+	void KScene::RetireGeometry(uint32_t vertexOffset, uint32_t vertexCount, uint32_t firstIndex,
+	                            uint32_t indexCount)
+	{
+		vertexRanges.Retire(vertexOffset, vertexCount, frameNumber);
+		indexRanges.Retire(firstIndex, indexCount, frameNumber);
+	}
+
+	void KScene::InvalidateInstanceBatches()
+	{
+		if (instanceRanges.empty() || batchStats.empty()) return;
+
+		// The instance batch comes after the object batches, in both passes
+		if (prePassBatches > 0) vulkan->cmdPool->InvalidateBatch(objectBatches);
+		vulkan->cmdPool->InvalidateBatch(prePassBatches + objectBatches);
+	}
+
+	void KScene::Actualize()
+	{
+		std::vector<Vulkan::Vertex> vx;
+		std::vector<glm::vec3> px;
+		std::vector<uint32_t> ix;
+
+		uint32_t offset = 0;
+
+		// Buffers are about to be replaced, frames still in flight may be using them
+		vulkan->FinishDrawing();
+
+		// Static objects get baked into chunks, the rest keep their own table entries in the drawn archetype.
+		// Instances are drawn relative to their parent's entry, so parents are never baked.
+		KArchetype &drawn = entities.Get(KA_DRAWN);
+		KArchetype &baked = entities.Get(KA_STATIC);
+
+		auto Bakes = [](const KRenderComponent &render) {
+			return render.isStatic && render.instanceCount == 0 && !render.hidden;
+		};
+
+		// Walk backwards, migrating swaps the last row into the freed one
+		for (uint32_t i = drawn.Size(); i-- > 0;)
+		{
+			if (Bakes(drawn.renders[i])) entities.Migrate(drawn.entities[i], KA_STATIC);
+		}
+
+		for (uint32_t i = baked.Size(); i-- > 0;)
+		{
+			if (!Bakes(baked.renders[i])) entities.Migrate(baked.entities[i], KA_DRAWN);
+		}
+
+		actualizedObjects = drawn.Size();
+
+		// The buffers are rebuilt without gaps, and nothing is in flight to retire ranges for
+		vertexRanges.Clear();
+		indexRanges.Clear();
+		meshUsers.clear();
+
+		// Objects loaded from the same file each carry a copy of the same data, upload it only once
+		std::unordered_map<std::string, std::vector<KMesh*>> uploaded;
+
+		auto SameData = [](KMesh *a, KMesh *b) {
+			return memcmp(a->vertices.data(), b->vertices.data(), a->vertices.size() * sizeof(Vulkan::Vertex)) == 0 &&
+			       memcmp(a->indices.data(), b->indices.data(), a->indices.size() * sizeof(uint32_t)) == 0;
+		};
+
+		// Load object vertex and index data
+		for (uint32_t i = 0; i < actualizedObjects; ++i)
+		{
+			KMesh *mesh = drawn.renders[i].mesh;
+			std::string key = mesh->filename + ':' + std::to_string(mesh->vertices.size()) + ':' +
+			                  std::to_string(mesh->indices.size());
+
+			auto &candidates = uploaded[key];
+			auto same = std::find_if(candidates.begin(), candidates.end(), [&](KMesh *other) {
+				return SameData(mesh, other);
+			});
+
+			if (same != candidates.end())
+			{
+				mesh->SetBufferOffset((*same)->GetBufferOffset());
+				mesh->SetFirstIndex((*same)->GetFirstIndex());
+				meshUsers[mesh->GetBufferOffset()]++;
+				continue;
+			}
+
+			candidates.push_back(mesh);
+			mesh->SetBufferOffset(offset);
+			mesh->SetFirstIndex(static_cast<uint32_t>(ix.size()));
+			meshUsers[offset]++;
+
+			for (auto vert : mesh->vertices)
+			{
+				vx.push_back(vert);
+			}
+
+			for (auto index : mesh->indices)
+			{
+				ix.push_back(index);
+			}
+
+			offset += mesh->vertices.size();
+		}
+
+		BuildStaticChunks(vx, ix);
+		actualizedDraws = actualizedObjects + static_cast<uint32_t>(staticChunks.size());
+
+		// The depth pre-pass reads positions from a tightly packed stream of their own
+		if (vulkan->graphicsSettings->depthPrePass)
+		{
+			px.reserve(vx.size());
+			for (auto &vert : vx) px.push_back(vert.pos);
+		}
+
+		if (vertexBuffer != nullptr && vertexBuffer != dummyVertexBuffer) delete (vertexBuffer);
+		if (positionBuffer != nullptr && positionBuffer != dummyVertexBuffer) delete (positionBuffer);
+		if (indexBuffer != nullptr && indexBuffer != dummyIndexBuffer) delete (indexBuffer);
+		vertexBuffer = CreateObjectBuffer(vx, KT_BUFFER_VERTEX);
+		positionBuffer = CreateObjectBuffer(px, KT_BUFFER_VERTEX);
+		indexBuffer = CreateObjectBuffer(ix, KT_BUFFER_INDEX);
+
+		// Instanced object data
+		BuildInstanceRanges();
+
+		instanceData.Assign(instancedObjects.size(), {});
+
+		for (auto &range : instanceRanges)
+		{
+			// Instances find their parent's data in the object table
+			uint32_t parentRow = range.parent->GetIndex();
+
+			for (uint32_t i = range.first; i < range.first + range.count; ++i)
+			{
+				Vulkan::InstanceData data = instancedObjects[i]->GetInstanceData();
+				data.parent = parentRow;
+
+				instanceData.Write(i, data);
+			}
+		}
+
+		// Send all object data off in a single batch
+		vulkan->transfer->Flush();
+
+
+		CreateUniformBuffers();
+		CreateObjectTables();
+		CreateInstanceBuffer();
+		CreateMaterialTable();
+		UpdateMaterialTable();
+
+		for (uint32_t i = 0; i < actualizedObjects; ++i)
+		{
+			UpdateObjectData(i);
+		}
+
+		for (uint32_t c = 0; c < staticChunks.size(); ++c)
+		{
+			UpdateChunkData(c);
+		}
+
+		UpdateObjectBounds();
+
+		PrepareDescriptorLayouts();
+		vulkan->RecreateDescriptorPool();
+		InitializeDescriptorSets();
+
+		if (!instanceRanges.empty()) vulkan->graphicsSettings->doCreateInstancingPipeline = true;
+		PrepareShaderVariants();
+		vulkan->RecreatePipelines();
+
+		// Everything is about to be recorded anyway, start from a fresh order
+		drawOrder.clear();
+		SortDraws();
+
+		vulkan->RecreateCommandPool();
+	}
+
+	void KScene::BuildStaticChunks(std::vector<Vulkan::Vertex> &vx, std::vector<uint32_t> &ix)
+	{
+		staticChunks.clear();
+		staticChunkOf.clear();
+
+		// Group by material and the grid cell each object's center falls in. Chunks keep the objects
+		// rather than their rows, which move as static objects are removed.
+		std::map<std::tuple<KMaterial*, int32_t, int32_t, int32_t>, std::vector<KObject*>> cells;
+		float cellSize = std::max(staticChunkSize, 1e-3f);
+
+		KArchetype &baked = entities.Get(KA_STATIC);
+
+		for (uint32_t i = 0; i < baked.Size(); ++i)
+		{
+			glm::vec4 sphere = baked.renders[i].mesh->GetBoundingSphere();
+			glm::vec3 center = glm::vec3(baked.transforms[i].matrix * glm::vec4(glm::vec3(sphere), 1.0f));
+			glm::ivec3 cell = glm::ivec3(glm::floor(center / cellSize));
+
+			cells[std::make_tuple(baked.renders[i].material, cell.x, cell.y, cell.z)].push_back(baked.owners[i]);
+		}
+
+		for (auto &cell : cells)
+		{
+			KStaticChunk chunk = {};
+			chunk.material = std::get<0>(cell.first);
+			chunk.objects = std::move(cell.second);
+
+			BakeStaticChunk(chunk, vx, ix);
+			if (chunk.vertexCount == 0 || chunk.indexCount == 0) continue;
+
+			for (auto object : chunk.objects)
+			{
+				staticChunkOf[object] = static_cast<uint32_t>(staticChunks.size());
+			}
+
+			staticChunks.push_back(std::move(chunk));
+		}
+	}
+
+	void KScene::BakeStaticChunk(KStaticChunk &chunk, std::vector<Vulkan::Vertex> &vx, std::vector<uint32_t> &ix)
+	{
+		chunk.vertexOffset = static_cast<uint32_t>(vx.size());
+		chunk.firstIndex = static_cast<uint32_t>(ix.size());
+
+		for (auto object : chunk.objects)
+		{
+			// Hidden while baked, the object stays in the chunk until it's shown again
+			if (entities.Render(object->GetHandle())->hidden) continue;
+
+			KMesh *mesh = object->GetMesh();
+			glm::mat4 matrix = object->GetModelMatrix();
+			glm::mat3 normalMatrix = glm::mat3(glm::transpose(glm::inverse(matrix)));
+			auto base = static_cast<uint32_t>(vx.size()) - chunk.vertexOffset;
+
+			// Normals are transformed the same way the vertex shaders do it, with the inverse transpose
+			for (auto vert : mesh->vertices)
+			{
+				vert.pos = glm::vec3(matrix * glm::vec4(vert.pos, 1.0f));
+				vert.normal = normalMatrix * vert.normal;
+				vx.push_back(vert);
+			}
+
+			for (auto index : mesh->indices)
+			{
+				ix.push_back(base + index);
+			}
+		}
+
+		chunk.vertexCount = static_cast<uint32_t>(vx.size()) - chunk.vertexOffset;
+		chunk.indexCount = static_cast<uint32_t>(ix.size()) - chunk.firstIndex;
+		chunk.stale = false;
+
+		if (chunk.vertexCount == 0) return;
+
+		// Center of the bounding box, like the meshes' own spheres
+		glm::vec3 low = vx[chunk.vertexOffset].pos;
+		glm::vec3 high = low;
+
+		for (size_t v = chunk.vertexOffset; v < vx.size(); ++v)
+		{
+			low = glm::min(low, vx[v].pos);
+			high = glm::max(high, vx[v].pos);
+		}
+
+		glm::vec3 center = (low + high) * 0.5f;
+		float radius = 0.0f;
+
+		for (size_t v = chunk.vertexOffset; v < vx.size(); ++v)
+		{
+			radius = std::max(radius, glm::length(vx[v].pos - center));
+		}
+
+		chunk.bounds = glm::vec4(center, radius);
+	}
+
+	void KScene::RebakeStaticChunks()
+	{
+		// Ranges retired this many frames ago aren't read by any frame in flight anymore
+		uint64_t framesInFlight = std::max(vulkan->settings->framesInFlight, 1u);
+
+		if (frameNumber >= framesInFlight)
+		{
+			vertexRanges.Release(frameNumber - framesInFlight);
+			indexRanges.Release(frameNumber - framesInFlight);
+		}
+
+		// Only the batches drawing a chunk hold its old ranges
+		auto InvalidateChunk = [this](uint32_t draw) {
+			if (draw >= drawSlots.size()) return;
+
+			uint32_t batch = drawSlots[draw] / drawsPerBatch;
+
+			if (prePassBatches > 0) vulkan->cmdPool->InvalidateBatch(batch);
+			vulkan->cmdPool->InvalidateBatch(prePassBatches + batch);
+		};
+
+		for (uint32_t c = 0; c < staticChunks.size();)
+		{
+			KStaticChunk &chunk = staticChunks[c];
+
+			if (!chunk.stale)
+			{
+				++c;
+				continue;
+			}
+
+			uint32_t draw = actualizedObjects + c;
+			std::vector<Vulkan::Vertex> vx;
+			std::vector<uint32_t> ix;
+			KStaticChunk baked = chunk;
+
+			BakeStaticChunk(baked, vx, ix);
+
+			if (baked.vertexCount == 0 || baked.indexCount == 0)
+			{
+				RetireGeometry(chunk.vertexOffset, chunk.vertexCount, chunk.firstIndex, chunk.indexCount);
+
+				// Every object left is hidden, the chunk stays around to be baked again once one is shown
+				if (!baked.objects.empty())
+				{
+					chunk = std::move(baked);
+					InvalidateChunk(draw);
+
+					++c;
+					continue;
+				}
+
+				// Nothing left to draw, the chunks after it take the table entries down a slot
+				objectData.Erase(draw);
+				staticChunks.erase(staticChunks.begin() + c);
+				actualizedDraws--;
+
+				for (auto &entry : staticChunkOf)
+				{
+					if (entry.second > c) entry.second--;
+				}
+
+				continue;
+			}
+
+			bool fits = vertexRanges.Allocate(baked.vertexCount, baked.vertexOffset);
+
+			if (fits && !indexRanges.Allocate(baked.indexCount, baked.firstIndex))
+			{
+				vertexRanges.Free(baked.vertexOffset, baked.vertexCount);
+				fits = false;
+			}
+
+			if (fits)
+			{
+				RetireGeometry(chunk.vertexOffset, chunk.vertexCount, chunk.firstIndex, chunk.indexCount);
+			}
+			else
+			{
+				// Once nothing is in flight the chunk's own geometry is free, and the smaller chunk fits there
+				vulkan->FinishDrawing();
+
+				vertexRanges.ReleaseAll();
+				indexRanges.ReleaseAll();
+				vertexRanges.Free(chunk.vertexOffset, chunk.vertexCount);
+				indexRanges.Free(chunk.firstIndex, chunk.indexCount);
+
+				vertexRanges.Allocate(baked.vertexCount, baked.vertexOffset);
+				indexRanges.Allocate(baked.indexCount, baked.firstIndex);
+			}
+
+			// Chunk indices are relative to its first vertex, they're the same wherever it ends up
+			vulkan->transfer->UploadBuffer(vertexBuffer, vx.data(), vx.size() * sizeof(Vulkan::Vertex),
+			                               baked.vertexOffset * sizeof(Vulkan::Vertex));
+			vulkan->transfer->UploadBuffer(indexBuffer, ix.data(), ix.size() * sizeof(uint32_t),
+			                               baked.firstIndex * sizeof(uint32_t));
+
+			if (positionBuffer != dummyVertexBuffer)
+			{
+				std::vector<glm::vec3> px;
+				px.reserve(vx.size());
+				for (auto &vert : vx) px.push_back(vert.pos);
+
+				vulkan->transfer->UploadBuffer(positionBuffer, px.data(), px.size() * sizeof(glm::vec3),
+				                               baked.vertexOffset * sizeof(glm::vec3));
+			}
+
+			chunk = std::move(baked);
+			InvalidateChunk(draw);
+
+			++c;
+		}
+	}
+
+	KScene::KDrawItem KScene::GetDrawItem(uint32_t draw)
+	{
+		if (draw < actualizedObjects)
+		{
+			KRenderComponent &render = entities.Get(KA_DRAWN).renders[draw];
+
+			// Hidden objects keep their table entry for their instances, but draw nothing themselves
+			return { render.material, render.mesh->GetBufferOffset(), render.mesh->GetFirstIndex(),
+			         render.hidden ? 0 : static_cast<uint32_t>(render.mesh->indices.size()) };
+		}
+
+		KStaticChunk &chunk = staticChunks[draw - actualizedObjects];
+
+		return { chunk.material, chunk.vertexOffset, chunk.firstIndex, chunk.indexCount };
+	}
+
+	glm::mat4 KScene::GetDrawMatrix(uint32_t draw)
+	{
+		return (draw < actualizedObjects) ? entities.Get(KA_DRAWN).transforms[draw].matrix : glm::mat4(1.0f);
+	}
+
+	glm::vec4 KScene::GetDrawBounds(uint32_t draw)
+	{
+		return (draw < actualizedObjects) ? entities.Get(KA_DRAWN).bounds[draw]
+		                                  : staticChunks[draw - actualizedObjects].bounds;
+	}
+
+	void KScene::PrepareShaderVariants()
+	{
+		// Round up so adding a light now and then doesn't mean building new pipelines every time
+		variantMaxLights = 1;
+		uint32_t clusterLights = lightClusters->GetMaxLightsPerCluster();
+		while (variantMaxLights < lights.size() && variantMaxLights < clusterLights) variantMaxLights <<= 1;
+
+		// Build a variant for every loaded material, objects may switch materials without re-actualizing
+		auto &variants = vulkan->graphicsSettings->shaderVariants;
+		variants.clear();
+
+		for (auto material : materials)
+		{
+			variants.push_back(GetShaderVariant(material));
+		}
+	}
+
+	Vulkan::KVulkanShaderVariant KScene::GetShaderVariant(KMaterial *material)
+	{
+		Vulkan::KVulkanShaderVariant variant = {};
+		variant.lightingModel = static_cast<uint32_t>(material->properties.material);
+		variant.maxLights = variantMaxLights;
+		variant.hasTexture = material->properties.hasTexture ? VK_TRUE : VK_FALSE;
+
+		return variant;
+	}
+
+	void KScene::PrepareDescriptorLayouts()
+	{
+		vulkan->graphicsSettings->descriptorPoolSizes.clear();
+		VkDescriptorPoolSize size = {};
+
+		// Uniform buffer
+		size.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		size.descriptorCount = uniformSlices;
+		vulkan->graphicsSettings->descriptorPoolSizes.push_back(size);
+
+		// Lights, light cluster grid, light indices and lights selected for instance buckets,
+		// then the object table, draw order and material table
+		size.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		size.descriptorCount = 7 * uniformSlices;
+		vulkan->graphicsSettings->descriptorPoolSizes.push_back(size);
+
+		// Image sampler for materials
+		size.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		size.descriptorCount = static_cast<uint32_t>(materials.size());
+		vulkan->graphicsSettings->descriptorPoolSizes.push_back(size);
+	}
+
+	void KScene::InitializeDescriptorSets()
+	{
+		// Material descriptor sets
+		for (auto &material : materials)
+		{
+			vulkan->descPool->AllocateDescriptor(&vulkan->fragmentDescriptorLayout,
+			                             &material->descriptorSet,
+			                             VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			                             &material->properties.descriptor, nullptr, 0, 1);
+		}
+
+		uniformDescriptorSets.resize(uniformSlices);
+		lightsDescriptorSets.resize(uniformSlices);
+		objectDescriptorSets.resize(uniformSlices);
+
+		for (uint32_t i = 0; i < uniformSlices; ++i)
+		{
+			// Vertex descriptor set
+			VkDescriptorBufferInfo bufferInfo = {};
+			bufferInfo.buffer = uniformBuffer->buffer;
+			bufferInfo.offset = i * uniformSliceSize;
+			bufferInfo.range = uniformSliceSize;
+
+			vulkan->descPool->AllocateDescriptor(&vulkan->vertexDescriptorLayout,
+			                             &uniformDescriptorSets[i],
+			                             VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			                             nullptr, &bufferInfo, 0, 1);
+
+			// Lights descriptor set, along with the light clusters indexing into it
+			std::vector<VkDescriptorType> lightsTypes = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			                                              VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			                                              VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			                                              VK_DESCRIPTOR_TYPE_STORAGE_BUFFER };
+
+			std::vector<VkDescriptorBufferInfo> lightsInfo = {
+				lightsBuffer->GetDescriptorInfo(i * lightsSliceSize, lightsSliceSize),
+				clusterGridBuffer->GetDescriptorInfo(i * clusterGridSliceSize, clusterGridSliceSize),
+				clusterLightsBuffer->GetDescriptorInfo(i * clusterLightsSliceSize, clusterLightsSliceSize),
+				bucketLightsBuffer->GetDescriptorInfo(i * bucketLightsSliceSize, bucketLightsSliceSize)
+			};
+
+			vulkan->descPool->AllocateBufferDescriptors(&vulkan->lightsDescriptorLayout, &lightsDescriptorSets[i],
+			                                            lightsTypes, lightsInfo);
+
+			// Object table descriptor set
+			std::vector<VkDescriptorType> objectTypes = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			                                              VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			                                              VK_DESCRIPTOR_TYPE_STORAGE_BUFFER };
+
+			std::vector<VkDescriptorBufferInfo> objectInfo = {
+				objectTableBuffer->GetDescriptorInfo(i * objectTableSliceSize, objectTableSliceSize),
+				drawOrderBuffer->GetDescriptorInfo(i * drawOrderSliceSize, drawOrderSliceSize),
+				materialTableBuffer->GetDescriptorInfo(i * materialTableSliceSize, materialTableSliceSize)
+			};
+
+			vulkan->descPool->AllocateBufferDescriptors(&vulkan->objectDescriptorLayout, &objectDescriptorSets[i],
+			                                            objectTypes, objectInfo);
+		}
+	}
+
+	uint32_t KScene::GetDrawBatchCount(uint32_t threadCount)
+	{
+		if (vertexBuffer == nullptr || uniformSlices == 0) return 0;
+
+		uint32_t count = actualizedDraws;
+
+		// One batch per thread, unless that would leave the batches too small to be worth it
+		drawsPerBatch = std::max((count + threadCount - 1) / std::max(threadCount, 1u), minDrawsPerBatch);
+		objectBatches = (count + drawsPerBatch - 1) / drawsPerBatch;
+
+		uint32_t batches = objectBatches + (instanceRanges.empty() ? 0 : 1);
+
+		// Pre-pass batches are executed first so all depth is in place before anything is shaded
+		bool prePass = vulkan->graphicsSettings->depthPrePass && vulkan->depthPipeline != nullptr;
+		prePassBatches = prePass ? batches : 0;
+
+		batchStats.assign(prePassBatches + batches, {});
+
+		return prePassBatches + batches;
+	}
+
+	void KScene::BatchRenderCallback(VkCommandBuffer buf, uint32_t imageIndex, uint32_t batch)
+	{
+		// The swap chain may have gained images since the last actualization, Update() catches up
+		uint32_t slice = imageIndex % uniformSlices;
+		auto count = static_cast<uint32_t>(drawOrder.size());
+
+		if (batch < prePassBatches)
+		{
+			uint32_t first = batch * drawsPerBatch;
+
+			if (batch < objectBatches) DrawObjectsDepth(buf, slice, first, std::min(first + drawsPerBatch, count));
+			else DrawInstancedObjectsDepth(buf, slice);
+
+			return;
+		}
+
+		KRenderQueueStats stats = {};
+		uint32_t drawBatch = batch - prePassBatches;
+
+		if (drawBatch < objectBatches)
+		{
+			uint32_t first = drawBatch * drawsPerBatch;
+
+			DrawObjects(buf, slice, first, std::min(first + drawsPerBatch, count), stats);
+		}
+		else
+		{
+			DrawInstancedObjects(buf, slice, stats);
+		}
+
+		// Every object used to be drawn on its own, with one descriptor set bind call and a push each, after
+		// binding the pipeline once. Calls are counted the same way here, not sets.
+		uint32_t binds = stats.pipelineBinds + stats.descriptorBinds + stats.pushConstants;
+		uint32_t unsorted = (stats.draws + stats.mergedDraws) * 2 + (stats.draws > 0 ? 1 : 0);
+		stats.bindsSaved = std::max(unsorted, binds) - binds;
+
+		// Sized before recording starts, each batch only touches its own entry
+		if (batch < batchStats.size()) batchStats[batch] = stats;
+	}
+
+	void KScene::DrawObjects(VkCommandBuffer buf, uint32_t slice, uint32_t first, uint32_t last,
+	                         KRenderQueueStats &stats)
+	{
+		VkPipelineLayout layout = vulkan->mainPipeline->pipelineLayout;
+
+		Vulkan::KVulkanPushConstants push = {};
+		push.numLights = lightCount;
+
+		VkDeviceSize offsets[1] = {0};
+		vkCmdBindVertexBuffers(buf, 0, 1, &vertexBuffer->buffer, offsets);
+		vkCmdBindIndexBuffer(buf, indexBuffer->buffer, 0, VK_INDEX_TYPE_UINT32);
+
+		// Per frame sets and push constants are the same for every draw, all variants share the layout
+		vkCmdBindDescriptorSets(buf, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 1, &uniformDescriptorSets[slice],
+		                        0, nullptr);
+		vkCmdBindDescriptorSets(buf, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 2, 1, &objectDescriptorSets[slice],
+		                        0, nullptr);
+		vkCmdBindDescriptorSets(buf, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 3, 1, &lightsDescriptorSets[slice],
+		                        0, nullptr);
+		vkCmdPushConstants(buf, layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(Vulkan::KVulkanPushConstants), &push);
+
+		stats.descriptorBinds += 3;
+		stats.pushConstants++;
+
+		VkPipeline boundPipeline = VK_NULL_HANDLE;
+		VkDescriptorSet boundMaterial = VK_NULL_HANDLE;
+
+		for (uint32_t n = first; n < last;)
+		{
+			uint32_t i = drawOrder[n];
+			KDrawItem item = GetDrawItem(i);
+			KMaterial *material = item.material;
+			uint32_t run = GetDrawRun(n, last, true);
+
+			if (item.indexCount == 0)
+			{
+				n += run;
+				continue;
+			}
+
+			VkPipeline pipeline = vulkan->mainPipeline->GetVariant(GetShaderVariant(material));
+
+			if (pipeline != boundPipeline)
+			{
+				vkCmdBindPipeline(buf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+				boundPipeline = pipeline;
+				stats.pipelineBinds++;
+			}
+
+			if (material->descriptorSet != boundMaterial)
+			{
+				vkCmdBindDescriptorSets(buf, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 1, 1, &material->descriptorSet,
+				                        0, nullptr);
+				boundMaterial = material->descriptorSet;
+				stats.descriptorBinds++;
+			}
+
+			// Instance indices start at the draw order position, which the shader maps back to the object
+			vkCmdDrawIndexed(buf, item.indexCount, run, item.firstIndex, item.vertexOffset, n);
+			stats.draws++;
+			stats.mergedDraws += run - 1;
+			n += run;
+		}
+	}
+
+	void KScene::DrawInstancedObjects(VkCommandBuffer buf, uint32_t slice, KRenderQueueStats &stats)
+	{
+		VkPipelineLayout layout = vulkan->instancePipeline->pipelineLayout;
+
+		Vulkan::KVulkanPushConstants push = {};
+		push.numLights = lightCount;
+
+		VkDeviceSize offsets[1] = {0};
+		VkDeviceSize instanceOffsets[1] = {slice * instanceSliceSize};
+		vkCmdBindVertexBuffers(buf, 0, 1, &vertexBuffer->buffer, offsets);
+		vkCmdBindVertexBuffers(buf, 1, 1, &instanceBuffer->buffer, instanceOffsets);
+		vkCmdBindIndexBuffer(buf, indexBuffer->buffer, 0, VK_INDEX_TYPE_UINT32);
+
+		// Instances carry the object table index of their parent
+		vkCmdBindDescriptorSets(buf, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 1, &uniformDescriptorSets[slice],
+		                        0, nullptr);
+		vkCmdBindDescriptorSets(buf, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 2, 1, &objectDescriptorSets[slice],
+		                        0, nullptr);
+		vkCmdBindDescriptorSets(buf, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 3, 1, &lightsDescriptorSets[slice],
+		                        0, nullptr);
+		vkCmdPushConstants(buf, layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(Vulkan::KVulkanPushConstants), &push);
+
+		stats.descriptorBinds += 3;
+		stats.pushConstants++;
+
+		VkPipeline boundPipeline = VK_NULL_HANDLE;
+		VkDescriptorSet boundMaterial = VK_NULL_HANDLE;
+
+		for (auto &range : instanceRanges)
+		{
+			if (range.count == 0) continue;
+
+			IObject *parent = range.parent;
+			KMaterial *material = parent->GetMaterial();
+			uint32_t offset = parent->GetMesh()->GetBufferOffset();
+
+			VkPipeline pipeline = vulkan->instancePipeline->GetVariant(GetShaderVariant(material));
+
+			if (pipeline != boundPipeline)
+			{
+				vkCmdBindPipeline(buf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+				boundPipeline = pipeline;
+				stats.pipelineBinds++;
+			}
+
+			if (material->descriptorSet != boundMaterial)
+			{
+				vkCmdBindDescriptorSets(buf, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 1, 1, &material->descriptorSet,
+				                        0, nullptr);
+				boundMaterial = material->descriptorSet;
+				stats.descriptorBinds++;
+			}
+
+			vkCmdDrawIndexed(buf, static_cast<uint32_t>(parent->GetMesh()->indices.size()), range.count,
+			                 parent->GetMesh()->GetFirstIndex(), offset, range.first);
+			stats.draws++;
+		}
+	}
+
+	void KScene::DrawObjectsDepth(VkCommandBuffer buf, uint32_t slice, uint32_t first, uint32_t last)
+	{
+		VkPipelineLayout layout = vulkan->depthPipeline->pipelineLayout;
+
+		VkDeviceSize offsets[1] = {0};
+		vkCmdBindVertexBuffers(buf, 0, 1, &positionBuffer->buffer, offsets);
+		vkCmdBindIndexBuffer(buf, indexBuffer->buffer, 0, VK_INDEX_TYPE_UINT32);
+		vkCmdBindPipeline(buf, VK_PIPELINE_BIND_POINT_GRAPHICS, vulkan->depthPipeline->graphicsPipeline);
+
+		// Only the view and the object tables are needed, materials and lights are left unbound
+		vkCmdBindDescriptorSets(buf, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 1, &uniformDescriptorSets[slice],
+		                        0, nullptr);
+		vkCmdBindDescriptorSets(buf, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 2, 1, &objectDescriptorSets[slice],
+		                        0, nullptr);
+
+		// Depth doesn't care about materials, runs of the same geometry are merged even across them
+		for (uint32_t n = first; n < last;)
+		{
+			KDrawItem item = GetDrawItem(drawOrder[n]);
+			uint32_t run = GetDrawRun(n, last, false);
+
+			if (item.indexCount > 0) vkCmdDrawIndexed(buf, item.indexCount, run, item.firstIndex, item.vertexOffset, n);
+			n += run;
+		}
+	}
+
+	uint32_t KScene::GetDrawRun(uint32_t n, uint32_t last, bool sameMaterial)
+	{
+		// Shaders find their object through the draw order table, so identical draws can be merged freely
+		if (!autoInstancing) return 1;
+
+		KDrawItem item = GetDrawItem(drawOrder[n]);
+		uint32_t run = 1;
+
+		// Sorting put objects sharing mesh data and material next to each other
+		while (n + run < last)
+		{
+			KDrawItem next = GetDrawItem(drawOrder[n + run]);
+
+			if (sameMaterial && next.material != item.material) break;
+			if (next.vertexOffset != item.vertexOffset || next.firstIndex != item.firstIndex ||
+			    next.indexCount != item.indexCount) break;
+
+			++run;
+		}
+
+		return run;
+	}
+
+	void KScene::DrawInstancedObjectsDepth(VkCommandBuffer buf, uint32_t slice)
+	{
+		if (vulkan->depthInstancePipeline == nullptr) return;
+
+		VkPipelineLayout layout = vulkan->depthInstancePipeline->pipelineLayout;
+
+		VkDeviceSize offsets[1] = {0};
+		VkDeviceSize instanceOffsets[1] = {slice * instanceSliceSize};
+		vkCmdBindVertexBuffers(buf, 0, 1, &positionBuffer->buffer, offsets);
+		vkCmdBindVertexBuffers(buf, 1, 1, &instanceBuffer->buffer, instanceOffsets);
+		vkCmdBindIndexBuffer(buf, indexBuffer->buffer, 0, VK_INDEX_TYPE_UINT32);
+		vkCmdBindPipeline(buf, VK_PIPELINE_BIND_POINT_GRAPHICS, vulkan->depthInstancePipeline->graphicsPipeline);
+
+		vkCmdBindDescriptorSets(buf, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 1, &uniformDescriptorSets[slice],
+		                        0, nullptr);
+		vkCmdBindDescriptorSets(buf, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 2, 1, &objectDescriptorSets[slice],
+		                        0, nullptr);
+
+		for (auto &range : instanceRanges)
+		{
+			if (range.count == 0) continue;
+
+			KMesh *mesh = range.parent->GetMesh();
+			vkCmdDrawIndexed(buf, static_cast<uint32_t>(mesh->indices.size()), range.count, mesh->GetFirstIndex(),
+			                 mesh->GetBufferOffset(), range.first);
+		}
+	}
+
+	void KScene::LightingRenderCallback(VkCommandBuffer buf, uint32_t imageIndex)
+	{
+		if (uniformSlices == 0 || vulkan->lightingPipeline == nullptr) return;
+
+		uint32_t slice = imageIndex % uniformSlices;
+
+		Vulkan::KVulkanPushConstants push = {};
+		push.numLights = lightCount;
+
+		std::array<VkDescriptorSet, 3> descriptorSets = {};
+		descriptorSets[0] = uniformDescriptorSets[slice];
+		descriptorSets[1] = vulkan->gBufferDescriptorSet;
+		descriptorSets[2] = lightsDescriptorSets[slice];
+
+		vkCmdBindPipeline(buf, VK_PIPELINE_BIND_POINT_GRAPHICS, vulkan->lightingPipeline->graphicsPipeline);
+		vkCmdBindDescriptorSets(buf, VK_PIPELINE_BIND_POINT_GRAPHICS, vulkan->lightingPipeline->pipelineLayout,
+		                        0, descriptorSets.size(), descriptorSets.data(), 0, nullptr);
+
+		vkCmdPushConstants(buf, vulkan->lightingPipeline->pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+		                   sizeof(Vulkan::KVulkanPushConstants), &push);
+
+		// A single triangle covering the screen, generated by the vertex shader
+		vkCmdDraw(buf, 3, 1, 0, 0);
+	}
+
+	void KScene::RenderCallback(VkCommandBuffer *buf, uint32_t imageIndex)
+	{
+		// KVulkan has made sure the GPU is done with this image's slice, so it's safe to write to
+		if (uniformSlices > 0) UpdateUniformSlice(imageIndex % uniformSlices);
+
+		// Geometry retired before this frame is reused once enough frames have been recorded after it
+		++frameNumber;
+
+		// Commands which cannot be recorded go here.
+		RecordComputeDispatches(*buf);
+
+		vkEndCommandBuffer(*buf);
+	}
+
+	void KScene::RecordComputeDispatches(VkCommandBuffer buf)
+	{
+		if (computeQueue.empty()) return;
+
+		VkPipelineStageFlags readStages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+		                                  VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+		// Earlier frames may still be reading what the dispatches are about to overwrite
+		vkCmdPipelineBarrier(buf, readStages, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0,
+		                     nullptr);
+
+		VkMemoryBarrier computeBarrier = {};
+		computeBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		computeBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		computeBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+		for (size_t i = 0; i < computeQueue.size(); ++i)
+		{
+			auto &dispatch = computeQueue[i];
+
+			// Each dispatch may consume the output of the one before it
+			if (i > 0)
+			{
+				vkCmdPipelineBarrier(buf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				                     0, 1, &computeBarrier, 0, nullptr, 0, nullptr);
+			}
+
+			dispatch.pipeline->Dispatch(buf, dispatch.descriptorSet, dispatch.groups[0], dispatch.groups[1],
+			                            dispatch.groups[2], dispatch.pushData.empty() ? nullptr : dispatch.pushData.data());
+		}
+
+		// The render pass is submitted right after this buffer, make the results visible to it
+		VkMemoryBarrier drawBarrier = {};
+		drawBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		drawBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		drawBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+		                            VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier(buf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, readStages, 0, 1, &drawBarrier, 0, nullptr,
+		                     0, nullptr);
+
+		computeQueue.clear();
+	}
+
+	Vulkan::KVulkanComputePipeline *KScene::CreateComputePipeline(const std::string &shader,
+	                                                              const std::vector<VkDescriptorType> &bindings,
+	                                                              uint32_t pushSize, uint32_t maxSets)
+	{
+		auto pipeline = new Vulkan::KVulkanComputePipeline(vulkan);
+
+		KError ret = pipeline->Initialize(shader, bindings, pushSize, maxSets);
+		if (ret != KE_OK)
+		{
+			delete(pipeline);
+			throw std::runtime_error(WhatWentWrong(ret));
+		}
+
+		computePipelines.push_back(pipeline);
+
+		return pipeline;
+	}
+
+	Vulkan::KVulkanBuffer *KScene::CreateStorageBuffer(VkDeviceSize size, const void *data, VkBufferUsageFlags usage)
+	{
+		usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+		auto buffer = new Vulkan::KVulkanBuffer(vulkan, size, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		if (data != nullptr) buffer->Upload(data, size);
+
+		storageBuffers.push_back(buffer);
+
+		return buffer;
+	}
+
+	void KScene::Dispatch(Vulkan::KVulkanComputePipeline *pipeline, VkDescriptorSet set, uint32_t groupsX,
+	                      uint32_t groupsY, uint32_t groupsZ, const void *pushData, uint32_t pushSize)
+	{
+		KComputeDispatch dispatch = {};
+		dispatch.pipeline = pipeline;
+		dispatch.descriptorSet = set;
+		dispatch.groups[0] = groupsX;
+		dispatch.groups[1] = groupsY;
+		dispatch.groups[2] = groupsZ;
+
+		if (pushData != nullptr && pushSize)
+		{
+			auto bytes = static_cast<const char *>(pushData);
+			dispatch.pushData.assign(bytes, bytes + pushSize);
+		}
+
+		computeQueue.push_back(dispatch);
+	}
+
+	void KScene::Update()
+	{
+		auto swapChainExtent = vulkan->swapChain->swapChainExtent;
+
+		// Slices are per swap chain image, re-actualize if the image count changed under us
+		if (uniformSlices > 0 && uniformSlices != static_cast<uint32_t>(vulkan->swapChain->swapChainImages.size()))
+		{
+			Actualize();
+		}
+		else if (uniformSlices > 0 && lights.size() > variantMaxLights &&
+		         variantMaxLights < lightClusters->GetMaxLightsPerCluster())
+		{
+			// The shader variants wouldn't loop over the new lights
+			Actualize();
+		}
+		else if (uniformSlices > 0 && lights.size() > lightCapacity)
+		{
+			GrowLightStorage();
+		}
+
+		Vulkan::UniformBufferObject &ubo = uniformData;
+		ubo.view = glm::lookAt(viewPosition, viewPosition + glm::vec3(viewRotation.x, viewRotation.y, viewRotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+		ubo.proj = glm::perspective(glm::radians(60.0f), swapChainExtent.width / (float) swapChainExtent.height, zNear, zFar);
+		ubo.proj[1][1] *= -1;
+		ubo.worldAmbient = glm::vec4(0.1f, 0.1f, 0.1f, 1.0f);
+		ubo.invView = glm::inverse(ubo.view);
+		ubo.invProj = glm::inverse(ubo.proj);
+
+		// Lights created before the scene was first actualized wait for their storage
+		uint32_t previousCount = lightCount;
+		lightCount = std::min(static_cast<uint32_t>(lights.size()), lightCapacity);
+		lightsData.Resize(lightCount);
+
+		// The light count is pushed in the recorded batches
+		if (lightCount != previousCount) vulkan->cmdPool->InvalidateAllBatches();
+
+		// Light properties are public, so spot changes by comparing against what was last uploaded
+		for (uint32_t i = 0; i < lightCount; ++i)
+		{
+			Vulkan::KLightData data = {};
+			data.pos = glm::vec4(lights[i]->GetPosition(), 1.0f);
+			data.color = glm::vec4(lights[i]->color, 1.0f);
+			data.specular = glm::vec4(1.0f);
+			data.attenuation = glm::vec4(lights[i]->constantAttenuation,
+			                             lights[i]->linearAttenuation,
+			                             lights[i]->quadraticAttenuation, 1.0f);
+
+			lightsData.Write(i, data);
+		}
+
+		// Material properties are public too, the table is rebuilt when any of them changed
+		UpdateMaterialTable();
+		if (uniformSlices > 0 && materialData.Size() > materialCapacity) GrowMaterialTable();
+
+		// Chunks which lost objects since the last update
+		if (uniformSlices > 0) RebakeStaticChunks();
+
+		UpdateMovedInstances();
+		SelectObjectLights();
+		SortDraws();
+	}
+
+	void KScene::SortDraws()
+	{
+		if (actualizedDraws == 0)
+		{
+			// The last draws were removed, the batches still hold them
+			if (!drawOrder.empty()) vulkan->cmdPool->InvalidateAllBatches();
+
+			drawOrder.clear();
+			drawSlots.clear();
+			return;
+		}
+
+		const glm::mat4 &view = uniformData.view;
+
+		variantIds.clear();
+		materialIds.clear();
+		meshIds.clear();
+		renderQueue->Clear(actualizedDraws);
+
+		for (uint32_t i = 0; i < actualizedDraws; ++i)
+		{
+			KDrawItem item = GetDrawItem(i);
+			KMaterial *material = item.material;
+
+			// Ids in order of first appearance, they only need to tell things apart
+			uint32_t variant = variantIds.emplace(GetShaderVariant(material).GetKey(), variantIds.size()).first->second;
+			uint32_t materialId = materialIds.emplace(material, materialIds.size()).first->second;
+			uint32_t meshId = meshIds.emplace(item.vertexOffset, meshIds.size()).first->second;
+
+			// The depth pre-pass already rejects hidden fragments, so only sort by depth without it
+			float depth = 0.0f;
+
+			if (!vulkan->graphicsSettings->depthPrePass)
+			{
+				glm::vec4 center = GetDrawMatrix(i) * glm::vec4(glm::vec3(GetDrawBounds(i)), 1.0f);
+				depth = -(view * center).z;
+			}
+
+			renderQueue->Push(KRenderQueue::MakeKey(variant, materialId, meshId, depth, zNear, zFar), i);
+		}
 
-	KLight *KScene::CreateLight()
-	{
-		if (lights.size() >= KE_MAX_DYNAMIC_LIGHTS)
+		renderQueue->Sort();
+		const std::vector<uint32_t> &order = renderQueue->GetOrder();
+
+		// Only batches whose range of the order changed need recording again, removals shift every range
+		if (!drawOrder.empty() && drawOrder.size() != order.size())
+		{
+			for (uint32_t batch = 0; batch < objectBatches; ++batch)
+			{
+				if (prePassBatches > 0) vulkan->cmdPool->InvalidateBatch(batch);
+				vulkan->cmdPool->InvalidateBatch(prePassBatches + batch);
+			}
+		}
+		else if (drawOrder.size() == order.size())
 		{
-			std::cerr << "There are no more available dynamic light sources. The maximum available is "
-			          << KE_MAX_DYNAMIC_LIGHTS << "! Returning last light in queue!" << std::endl;
+			for (uint32_t batch = 0; batch < objectBatches; ++batch)
+			{
+				uint32_t first = std::min(batch * drawsPerBatch, actualizedDraws);
+				uint32_t last = std::min(first + drawsPerBatch, actualizedDraws);
 
-			return lights[lights.size() -1];
+				if (std::equal(order.begin() + first, order.begin() + last, drawOrder.begin() + first)) continue;
+
+				if (prePassBatches > 0) vulkan->cmdPool->InvalidateBatch(batch);
+				vulkan->cmdPool->InvalidateBatch(prePassBatches + batch);
+			}
 		}
 
-		auto light = new KLight(this);
-		lights.push_back(light);
+		drawOrder = order;
+		drawSlots.resize(actualizedDraws);
+		drawOrderData.Resize(actualizedDraws);
 
-		return light;
+		// Only positions whose object changed are uploaded to the shaders' copy
+		for (uint32_t n = 0; n < actualizedDraws; ++n)
+		{
+			drawSlots[drawOrder[n]] = n;
+			drawOrderData.Write(n, drawOrder[n]);
+		}
 	}
 
-	void KScene::Actualize()
+	void KScene::UpdateObjectBounds()
 	{
-		std::vector<Vulkan::Vertex> vx;
-		std::vector<uint32_t> ix;
+		KArchetype &drawn = entities.Get(KA_DRAWN);
 
-		uint32_t offset = 0;
+		// Chunks are already in world space and keep their own bounds
+		for (uint32_t i = 0; i < actualizedObjects; ++i)
+		{
+			drawn.bounds[i] = drawn.renders[i].mesh->GetBoundingSphere();
+		}
+	}
 
-		// Load object vertex and index data
-		for (uint32_t i = 0; i < objects.size(); ++i)
+	void KScene::UpdateBucketBounds()
+	{
+		// Only actualized instances sit in the instance buffer
+		auto instances = static_cast<uint32_t>(std::min<size_t>(actualizedInstances,
+		                                                        bucketBounds.size() * KE_INSTANCE_BUCKET_SIZE));
+
+		for (uint32_t b = 0; b < bucketBounds.size(); ++b)
 		{
-			objects[i]->GetMesh()->SetBufferOffset(offset);
-			objects[i]->SetIndex(i);
+			if (!staleBuckets[b]) continue;
+
+			uint32_t first = b * KE_INSTANCE_BUCKET_SIZE;
+			uint32_t last = std::min(first + KE_INSTANCE_BUCKET_SIZE, instances);
+			staleBuckets[b] = 0;
+
+			glm::vec4 spheres[KE_INSTANCE_BUCKET_SIZE];
+			uint32_t count = 0;
+			IObject *parent = nullptr;
+			glm::mat4 matrix;
+			glm::vec4 mesh;
+			float scale = 1.0f;
+
+			// Instances are placed in their parent's model space, a bucket may hold instances of two parents.
+			// Slots of removed instances stay empty until the next actualization.
+			for (uint32_t i = first; i < last; ++i)
+			{
+				if (instancedObjects[i] == nullptr) continue;
+
+				if (instancedObjects[i]->GetParent() != parent)
+				{
+					parent = instancedObjects[i]->GetParent();
+					matrix = parent->GetModelMatrix();
+					mesh = parent->GetMesh()->GetBoundingSphere();
+					scale = std::max(glm::length(glm::vec3(matrix[0])),
+					                 std::max(glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))));
+				}
+
+				KInstancedObject *instance = instancedObjects[i];
+				float instanceScale = instance->GetScale();
+				glm::vec3 local = instance->GetPosition() + instance->GetRotation() * (glm::vec3(mesh) * instanceScale);
+				glm::vec3 center = glm::vec3(matrix * glm::vec4(local, 1.0f));
+
+				spheres[count++] = glm::vec4(center, mesh.w * std::abs(instanceScale) * scale);
+			}
 
-			for (auto vert : objects[i]->GetMesh()->vertices)
+			if (count == 0)
 			{
-				vx.push_back(vert);
+				bucketBounds[b] = glm::vec4(0.0f);
+				continue;
 			}
 
-			for (auto index : objects[i]->GetMesh()->indices)
+			// Center of the bounding box is close enough to the optimal center, as with meshes
+			glm::vec3 low = glm::vec3(spheres[0]);
+			glm::vec3 high = low;
+
+			for (uint32_t i = 1; i < count; ++i)
 			{
-				ix.push_back(index);
+				low = glm::min(low, glm::vec3(spheres[i]));
+				high = glm::max(high, glm::vec3(spheres[i]));
 			}
 
-			offset += objects[i]->GetMesh()->vertices.size();
-		}
+			glm::vec3 center = (low + high) * 0.5f;
+			float radius = 0.0f;
 
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				radius = std::max(radius, glm::length(glm::vec3(spheres[i]) - center) + spheres[i].w);
+			}
 
-		if (vertexBuffer != nullptr && vertexBuffer != dummyVertexBuffer) delete (vertexBuffer);
-		if (indexBuffer != nullptr && indexBuffer != dummyIndexBuffer) delete (indexBuffer);
-		vertexBuffer = CreateObjectBuffer(vx, KT_BUFFER_VERTEX);
-		indexBuffer = CreateObjectBuffer(ix, KT_BUFFER_INDEX);
+			bucketBounds[b] = glm::vec4(center, radius);
+		}
+	}
 
-		// Instanced object data
-		std::vector<Vulkan::InstanceData> inst;
+	void KScene::MarkInstanceBuckets(IObject *parent)
+	{
+		auto index = instanceRangeOf.find(parent);
+		if (index == instanceRangeOf.end()) return;
+
+		KInstanceRange &range = instanceRanges[index->second];
+		uint32_t last = range.first + range.count;
+		auto buckets = static_cast<uint32_t>(staleBuckets.size());
 
-		for (auto &object : instancedObjects)
+		for (uint32_t b = range.first / KE_INSTANCE_BUCKET_SIZE; b < buckets && b * KE_INSTANCE_BUCKET_SIZE < last; ++b)
 		{
-			inst.push_back(object->GetInstanceData());
+			staleBuckets[b] = 1;
 		}
+	}
 
-		if (instanceBuffer != nullptr && instanceBuffer != dummyInstanceBuffer) delete (instanceBuffer);
-		instanceBuffer = CreateObjectBuffer(inst, KT_BUFFER_INSTANCE);
+	void KScene::SelectObjectLights()
+	{
+		if (objectData.Empty() || actualizedDraws == 0) return;
 
+		KLightSelectionData &sel = lightSelection;
 
-		CreateDynamicUniformBuffers();
+		sel.x.resize(lightCount);
+		sel.y.resize(lightCount);
+		sel.z.resize(lightCount);
+		sel.range.resize(lightCount);
+		sel.brightness.resize(lightCount);
+		sel.constant.resize(lightCount);
+		sel.linear.resize(lightCount);
+		sel.quadratic.resize(lightCount);
 
-		PrepareDescriptorLayouts();
-		vulkan->RecreateDescriptorPool();
-		InitializeDescriptorSets();
+		if (perObjectLights)
+		{
+			for (uint32_t i = 0; i < lightCount; ++i)
+			{
+				glm::vec3 position = lights[i]->GetPosition();
+				glm::vec3 color = lights[i]->color;
+
+				sel.x[i] = position.x;
+				sel.y[i] = position.y;
+				sel.z[i] = position.z;
+				sel.range[i] = lights[i]->GetRange();
+				sel.brightness[i] = std::max(color.x, std::max(color.y, color.z));
+				sel.constant[i] = lights[i]->constantAttenuation;
+				sel.linear[i] = lights[i]->linearAttenuation;
+				sel.quadratic[i] = lights[i]->quadraticAttenuation;
+			}
+		}
 
-		if (!instancedObjects.empty()) vulkan->graphicsSettings->doCreateInstancingPipeline = true;
-		vulkan->RecreateSwapChain();
-		vulkan->RecreateCommandPool();
+		Vulkan::KLightSelection clustered = {};
+		clustered.count = -1;
 
-		uniformBuffer->Map();
-		lightsBuffer->Map();
-	}
+		// Objects are selected for from their model space bounds
+		auto SelectFor = [&](const glm::mat4 &matrix, const glm::vec4 &local, float *influence) {
+			if (!perObjectLights) return clustered;
 
-	void KScene::PrepareDescriptorLayouts()
-	{
-		vulkan->graphicsSettings->descriptorPoolSizes.clear();
-		VkDescriptorPoolSize size = {};
+			glm::vec3 center = glm::vec3(matrix * glm::vec4(glm::vec3(local), 1.0f));
+			float scale = std::max(glm::length(glm::vec3(matrix[0])),
+			                       std::max(glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))));
 
-		// Uniform buffer
-		size.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		size.descriptorCount = 1;
-		vulkan->graphicsSettings->descriptorPoolSizes.push_back(size);
+			return SelectLights(center, local.w * scale, influence);
+		};
 
-		// Lights buffer
-		size.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		size.descriptorCount = 1;
-		vulkan->graphicsSettings->descriptorPoolSizes.push_back(size);
+		// Drawn objects run as a system over their archetype's columns, a chunk of rows at a time. Chunks
+		// may run in parallel, so each gets scratch space of its own and only writes its light components.
+		KArchetype &drawn = entities.Get(KA_DRAWN);
+		uint32_t chunks = (actualizedObjects + KE_ENTITY_CHUNK_SIZE - 1) / KE_ENTITY_CHUNK_SIZE;
 
-		// Dynamic uniform buffers for the vertex shader
-		size.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-		size.descriptorCount = 1;
-		vulkan->graphicsSettings->descriptorPoolSizes.push_back(size);
+		sel.influence.resize(static_cast<size_t>(lightCount) * (chunks + 1));
 
-		// Image sampler for materials
-		size.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		size.descriptorCount = static_cast<uint32_t>(materials.size());
-		vulkan->graphicsSettings->descriptorPoolSizes.push_back(size);
-	}
+		drawn.ForEachChunk(0, actualizedObjects, [&](uint32_t first, uint32_t last) {
+			float *influence = sel.influence.data() + static_cast<size_t>(first / KE_ENTITY_CHUNK_SIZE) * lightCount;
 
-	void KScene::InitializeDescriptorSets()
-	{
-		// Material descriptor sets
-		for (auto &material : materials)
-		{
-			vulkan->descPool->AllocateDescriptor(&vulkan->fragmentDescriptorLayout,
-			                             &material->descriptorSet,
-			                             VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-			                             &material->properties.descriptor, nullptr, 0, 1);
-		}
+			for (uint32_t o = first; o < last; ++o)
+			{
+				Vulkan::KLightSelection selected = SelectFor(drawn.transforms[o].matrix, drawn.bounds[o], influence);
+
+				drawn.lights[o].lights = selected.lights;
+				drawn.lights[o].count = selected.count;
+			}
+		});
+
+		// Everything else runs here, using the scratch space after the chunks'
+		float *influence = sel.influence.data() + static_cast<size_t>(chunks) * lightCount;
 
-		// Vertex descriptor set
-		VkDescriptorBufferInfo bufferInfo = {};
-		bufferInfo.buffer = uniformBuffer->buffer;
-		bufferInfo.offset = 0;
-		bufferInfo.range = uniformBuffer->size;
+		for (uint32_t o = 0; o < actualizedDraws; ++o)
+		{
+			Vulkan::KObjectData model = objectData[o];
 
-		vulkan->descPool->AllocateDescriptor(&vulkan->vertexDescriptorLayout,
-		                             &uniformDescriptorSet,
-		                             VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-		                             nullptr, &bufferInfo, 0, 1);
+			if (o < actualizedObjects)
+			{
+				model.lights = drawn.lights[o].lights;
+				model.lightCount = drawn.lights[o].count;
+			}
+			else
+			{
+				Vulkan::KLightSelection selected = SelectFor(glm::mat4(1.0f), GetDrawBounds(o), influence);
 
-		// Lights descriptor set
-		VkDescriptorBufferInfo lightsInfo = {};
-		lightsInfo.buffer = lightsBuffer->buffer;
-		lightsInfo.offset = 0;
-		lightsInfo.range = lightsBuffer->size;
+				model.lights = selected.lights;
+				model.lightCount = selected.count;
+			}
 
-		vulkan->descPool->AllocateDescriptor(&vulkan->lightsDescriptorLayout,
-		                                     &lightsDescriptorSet,
-		                                     VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-		                                     nullptr, &lightsInfo, 0, 1);
+			// Most objects keep their lights from frame to frame, those aren't uploaded again
+			objectData.Write(o, model);
+		}
 
-		// Dynamic vertex uniform buffer descriptor set
-		VkDescriptorBufferInfo vxDynamicBufferInfo = {};
-		vxDynamicBufferInfo.buffer = vxDynamicBuffer->buffer;
-		vxDynamicBufferInfo.offset = 0;
-		vxDynamicBufferInfo.range = dynamicAlignment;
+		// Instances are lit by the bucket they are in
+		if (perObjectLights) UpdateBucketBounds();
 
-		vulkan->descPool->AllocateDescriptor(&vulkan->vxUniformBufferDescriptorLayout,
-		                             &vxDynamicUniformDescriptorSet,
-		                             VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
-		                             nullptr, &vxDynamicBufferInfo, 0, 1);
+		for (uint32_t b = 0; b < bucketBounds.size(); ++b)
+		{
+			bucketLights.Write(b, perObjectLights ? SelectLights(glm::vec3(bucketBounds[b]), bucketBounds[b].w, influence)
+			                                      : clustered);
+		}
 	}
 
-	void KScene::StaticRenderCallback(VkCommandBuffer buf)
+	Vulkan::KLightSelection KScene::SelectLights(glm::vec3 center, float radius, float *influence)
 	{
-		if (vertexBuffer != nullptr)
+		KLightSelectionData &sel = lightSelection;
+
+		const float *x = sel.x.data();
+		const float *y = sel.y.data();
+		const float *z = sel.z.data();
+		const float *range = sel.range.data();
+		const float *brightness = sel.brightness.data();
+		const float *constant = sel.constant.data();
+		const float *linear = sel.linear.data();
+		const float *quadratic = sel.quadratic.data();
+
+		// Light reaching the nearest point of the bounds, branch free so it vectorizes
+		for (uint32_t i = 0; i < lightCount; ++i)
+		{
+			float dx = x[i] - center.x;
+			float dy = y[i] - center.y;
+			float dz = z[i] - center.z;
+			float distance = std::max(std::sqrt(dx * dx + dy * dy + dz * dz) - radius, 0.0f);
+			float attenuation = constant[i] + linear[i] * distance + quadratic[i] * distance * distance;
+			float value = brightness[i] / std::max(attenuation, 1e-6f);
+
+			influence[i] = (distance <= range[i]) ? value : 0.0f;
+		}
+
+		// Keep the strongest few, insertion is plenty for a list this short
+		uint32_t chosen[KE_MAX_OBJECT_LIGHTS] = {};
+		float strength[KE_MAX_OBJECT_LIGHTS] = {};
+		uint32_t count = 0;
+
+		for (uint32_t i = 0; i < lightCount; ++i)
 		{
-			DrawObjects(buf);
+			if (influence[i] <= 0.0f) continue;
+			if (count == KE_MAX_OBJECT_LIGHTS && influence[i] <= strength[count - 1]) continue;
 
-			if (!instancedObjects.empty())
+			uint32_t slot = (count < KE_MAX_OBJECT_LIGHTS) ? count++ : count - 1;
+
+			while (slot > 0 && strength[slot - 1] < influence[i])
 			{
-				DrawInstancedObjects(buf);
+				chosen[slot] = chosen[slot - 1];
+				strength[slot] = strength[slot - 1];
+				--slot;
 			}
+
+			chosen[slot] = i;
+			strength[slot] = influence[i];
 		}
-	}
 
-	void KScene::DrawObjects(VkCommandBuffer buf)
-	{
-		Vulkan::KVulkanPushConstants push = {};
-		push.numLights = static_cast<uint32_t>(lights.size());
+		Vulkan::KLightSelection selected = {};
+		selected.count = -1;
 
-		VkDeviceSize offsets[1] = {0};
-		vkCmdBindVertexBuffers(buf, 0, 1, &vertexBuffer->buffer, offsets);
-		vkCmdBindIndexBuffer(buf, indexBuffer->buffer, 0, VK_INDEX_TYPE_UINT32);
-		vkCmdBindPipeline(buf, VK_PIPELINE_BIND_POINT_GRAPHICS, vulkan->mainPipeline->graphicsPipeline);
+		// A few lights can't stand in for everything reaching bounds larger than their reach
+		for (uint32_t n = 0; n < count; ++n)
+		{
+			if (radius > range[chosen[n]]) return selected;
+		}
 
-		uint32_t offset = 0;
+		selected.lights = glm::uvec4(chosen[0], chosen[1], chosen[2], chosen[3]);
+		selected.count = static_cast<int32_t>(count);
 
-		for (uint32_t i = 0; i < objects.size(); ++i)
-		{
-			UpdateDynamicObjectBuffer(objects[i], i);
-			offset = objects[i]->GetMesh()->GetBufferOffset();
+		return selected;
+	}
 
-			std::array<VkDescriptorSet, 4> descriptorSets = {};
-			descriptorSets[0] = uniformDescriptorSet;
-			descriptorSets[1] = objects[i]->GetMaterial()->descriptorSet;
-			descriptorSets[2] = vxDynamicUniformDescriptorSet;
-			descriptorSets[3] = lightsDescriptorSet;
+	void KScene::UpdateUniformSlice(uint32_t slice)
+	{
+		memcpy((char *) uniformBuffer->mappedMemory + slice * uniformSliceSize, &uniformData, sizeof(uniformData));
 
-			uint32_t dynamicOffset = i * static_cast<uint32_t>(dynamicAlignment);
+		// Only upload the lights which changed since this slice was last drawn with
+		lightsData.Upload(slice, (char *) lightsBuffer->mappedMemory + slice * lightsSliceSize);
+		bucketLights.Upload(slice, (char *) bucketLightsBuffer->mappedMemory + slice * bucketLightsSliceSize);
 
-			vkCmdBindDescriptorSets(buf, VK_PIPELINE_BIND_POINT_GRAPHICS,
-			                        vulkan->mainPipeline->pipelineLayout,
-			                        0, descriptorSets.size(), descriptorSets.data(), 1, &dynamicOffset);
+		// Bin with the matrices the slice is drawn with
+		auto extent = vulkan->swapChain->swapChainExtent;
 
-			push.usePhong = (objects[i]->GetMaterial()->properties.material == KM_PHONG) ? VK_TRUE : VK_FALSE;
+		lightClusters->Build(uniformData.view, uniformData.proj, zNear, zFar, extent.width, extent.height,
+		                     lights, lightCount,
+		                     (char *) clusterGridBuffer->mappedMemory + slice * clusterGridSliceSize,
+		                     (char *) clusterLightsBuffer->mappedMemory + slice * clusterLightsSliceSize);
 
-			vkCmdPushConstants(buf, vulkan->mainPipeline->pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0,
-			                   sizeof(Vulkan::KVulkanPushConstants), &push);
+		UpdateObjectTables(slice);
 
-			vkCmdDrawIndexed(buf, static_cast<uint32_t>(objects[i]->GetMesh()->indices.size()), 1, 0, offset, 0);
+		if (instanceBuffer != dummyInstanceBuffer)
+		{
+			instanceData.Upload(slice, (char *) instanceBuffer->mappedMemory + slice * instanceSliceSize);
 		}
 	}
 
-	void KScene::DrawInstancedObjects(VkCommandBuffer buf)
+	void KScene::ObjectChanged(IObject *obj, bool commandsChanged, bool depthChanged)
 	{
-		Vulkan::KVulkanPushConstants push = {};
-		push.numLights = static_cast<uint32_t>(lights.size());
-
-		VkDeviceSize offsets[1] = {0};
-		vkCmdBindVertexBuffers(buf, 0, 1, &vertexBuffer->buffer, offsets);
-		vkCmdBindVertexBuffers(buf, 1, 1, &instanceBuffer->buffer, offsets);
-		vkCmdBindIndexBuffer(buf, indexBuffer->buffer, 0, VK_INDEX_TYPE_UINT32);
-		vkCmdBindPipeline(buf, VK_PIPELINE_BIND_POINT_GRAPHICS, vulkan->instancePipeline->graphicsPipeline);
+		uint32_t archetype = 0, index = 0;
 
-		uint32_t offset = 0;
-		uint32_t instances = 0;
+		// Objects created since the last actualization get picked up by the next one, baked ones stay put
+		if (!entities.Resolve(obj->GetHandle(), archetype, index)) return;
 
-		for (uint32_t i = 0; i < instancedObjects.size();)
+		if (archetype == KA_STATIC)
 		{
-			IObject *parent = instancedObjects[i]->GetParent();
-			offset = parent->GetMesh()->GetBufferOffset();
-			instances = parent->GetInstanceCount();
+			// Showing or hiding a baked object bakes its chunk again
+			auto chunk = staticChunkOf.find(entities.Get(KA_STATIC).owners[index]);
+			if (depthChanged && chunk != staticChunkOf.end()) staticChunks[chunk->second].stale = true;
 
-			std::array<VkDescriptorSet, 4> descriptorSets = {};
-			descriptorSets[0] = uniformDescriptorSet;
-			descriptorSets[1] = parent->GetMaterial()->descriptorSet;
-			descriptorSets[2] = vxDynamicUniformDescriptorSet;
-			descriptorSets[3] = lightsDescriptorSet;
+			return;
+		}
 
-			uint32_t dynamicOffset = parent->GetIndex() * static_cast<uint32_t>(dynamicAlignment);
+		if (index >= actualizedObjects) return;
 
-			vkCmdBindDescriptorSets(buf, VK_PIPELINE_BIND_POINT_GRAPHICS,
-			                        vulkan->instancePipeline->pipelineLayout,
-			                        0, descriptorSets.size(), descriptorSets.data(), 1, &dynamicOffset);
+		UpdateObjectData(index);
 
-			push.usePhong = (parent->GetMaterial()->properties.material == KM_PHONG) ? VK_TRUE : VK_FALSE;
+		// Instances move along with their parent
+		if (obj->GetInstanceCount() > 0) MarkInstanceBuckets(obj);
 
-			vkCmdPushConstants(buf, vulkan->instancePipeline->pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0,
-			                   sizeof(Vulkan::KVulkanPushConstants), &push);
+		if (commandsChanged)
+		{
+			// Depth pre-pass batches don't depend on materials, only the regular ones need recording
+			uint32_t slot = (index < drawSlots.size()) ? drawSlots[index] : index;
+			vulkan->cmdPool->InvalidateBatch(prePassBatches + slot / drawsPerBatch);
 
-			vkCmdDrawIndexed(buf, static_cast<uint32_t>(parent->GetMesh()->indices.size()), instances, 0, offset, i);
-			i += instances;
+			if (depthChanged && prePassBatches > 0) vulkan->cmdPool->InvalidateBatch(slot / drawsPerBatch);
 
+			// Instances are drawn with their parent's material too
+			if (obj->GetInstanceCount() > 0) vulkan->cmdPool->InvalidateBatch(prePassBatches + objectBatches);
 		}
 	}
 
-	void KScene::RenderCallback(VkCommandBuffer *buf, uint32_t imageIndex)
+	void KScene::InstanceChanged(KInstancedObject *instance)
 	{
-		// Commands which cannot be recorded go here.
-		vkEndCommandBuffer(*buf);
+		uint32_t index = 0;
+
+		// Instances created since the last actualization get uploaded by the next one
+		if (!instanceHandles.Resolve(instance->GetHandle(), index) || index >= actualizedInstances) return;
+
+		auto found = instanceRangeOf.find(instance->GetParent());
+		if (found == instanceRangeOf.end()) return;
+
+		movedInstances.push_back(instance);
 	}
 
-	void KScene::Update()
+	KRenderQueueStats KScene::GetDrawStats()
 	{
-		auto swapChainExtent = vulkan->swapChain->swapChainExtent;
-
-		Vulkan::UniformBufferObject ubo = {};
-		ubo.view = glm::lookAt(viewPosition, viewPosition + glm::vec3(viewRotation.x, viewRotation.y, viewRotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
-		ubo.proj = glm::perspective(glm::radians(60.0f), swapChainExtent.width / (float) swapChainExtent.height, 0.1f, 1000.0f);
-		ubo.proj[1][1] *= -1;
-		ubo.worldAmbient = glm::vec4(0.1f, 0.1f, 0.1f, 1.0f);
+		KRenderQueueStats total = {};
 
-		Vulkan::LightUniformBufferObject lightUBO = {};
-		for (uint32_t i = 0; i < lights.size(); ++i)
+		for (auto &stats : batchStats)
 		{
-			lightUBO.lights[i].pos = glm::vec4(lights[i]->GetPosition(), 1.0f);
-			lightUBO.lights[i].color = glm::vec4(lights[i]->color, 1.0f);
-			lightUBO.lights[i].specular = glm::vec4(1.0f);
-			lightUBO.lights[i].attenuation = glm::vec4(lights[i]->constantAttenuation,
-			                                      lights[i]->linearAttenuation,
-			                                      lights[i]->quadraticAttenuation, 1.0f);
+			total += stats;
 		}
 
-		memcpy(uniformBuffer->mappedMemory, &ubo, sizeof(ubo));
-		memcpy(lightsBuffer->mappedMemory, &lightUBO, sizeof(lightUBO));
-
-		UpdateDynamicUniformBuffers();
+		return total;
 	}
 
 	void KScene::UpdateObject(KObject *obj)
 	{
 		// TODO: Actually update the buffer directly instead of rebuilding the whole thing.
+		obj->GetMesh()->UpdateBoundingSphere();
 		Actualize();
 	}
 
 	void KScene::CreateUniformBuffers()
 	{
+		delete(uniformBuffer);
+		delete(lightsBuffer);
+		delete(clusterGridBuffer);
+		delete(clusterLightsBuffer);
+		delete(bucketLightsBuffer);
+
+		uniformSlices = static_cast<uint32_t>(vulkan->swapChain->swapChainImages.size());
+
 		VkDeviceSize uniformSize = sizeof(Vulkan::UniformBufferObject);
-		VkDeviceSize lightsSize = sizeof(Vulkan::LightUniformBufferObject);
 		VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
 		VkMemoryPropertyFlags flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
 
 		size_t minUBOAlignment = vulkan->device->features.VkLimits.minUniformBufferOffsetAlignment;
 		if (uniformSize % minUBOAlignment) uniformSize = (uniformSize + minUBOAlignment - 1) & ~(minUBOAlignment - 1);
-		if (lightsSize % minUBOAlignment) lightsSize = (lightsSize + minUBOAlignment - 1) & ~(minUBOAlignment - 1);
 
-		uniformBuffer = new Vulkan::KVulkanBuffer(vulkan, uniformSize, usage, flags);
-		lightsBuffer = new Vulkan::KVulkanBuffer(vulkan, lightsSize, usage, flags);
+		uniformSliceSize = uniformSize;
+
+		uniformBuffer = new Vulkan::KVulkanBuffer(vulkan, uniformSize * uniformSlices, usage, flags);
+		uniformBuffer->Map();
+
+		// Light clusters are rewritten from the host every frame as well
+		if (lightClusters == nullptr) lightClusters = new KLightClusters();
+
+		VkDeviceSize gridSize = lightClusters->GetGridSize();
+		VkDeviceSize clusterLightsSize = lightClusters->GetIndexSize();
+
+		size_t minSSBOAlignment = vulkan->device->features.VkLimits.minStorageBufferOffsetAlignment;
+		if (gridSize % minSSBOAlignment) gridSize = (gridSize + minSSBOAlignment - 1) & ~(minSSBOAlignment - 1);
+		if (clusterLightsSize % minSSBOAlignment) clusterLightsSize = (clusterLightsSize + minSSBOAlignment - 1) & ~(minSSBOAlignment - 1);
+
+		clusterGridSliceSize = gridSize;
+		clusterLightsSliceSize = clusterLightsSize;
+
+		usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+		clusterGridBuffer = new Vulkan::KVulkanBuffer(vulkan, gridSize * uniformSlices, usage, flags);
+		clusterLightsBuffer = new Vulkan::KVulkanBuffer(vulkan, clusterLightsSize * uniformSlices, usage, flags);
+		clusterGridBuffer->Map();
+		clusterLightsBuffer->Map();
+
+		CreateLightsBuffer();
+		CreateBucketLightsBuffer();
+	}
+
+	void KScene::CreateBucketLightsBuffer()
+	{
+		auto buckets = static_cast<uint32_t>((instancedObjects.size() + KE_INSTANCE_BUCKET_SIZE - 1) /
+		                                     KE_INSTANCE_BUCKET_SIZE);
+
+		// Instances are lit by the light clusters until lights are first selected for them
+		Vulkan::KLightSelection clustered = {};
+		clustered.count = -1;
+
+		bucketBounds.assign(buckets, glm::vec4(0.0f));
+		staleBuckets.assign(buckets, 1);
+		bucketLights.Assign(buckets, clustered);
+
+		VkDeviceSize bucketLightsSize = sizeof(Vulkan::KLightSelection) * std::max(buckets, 1u);
+
+		size_t minSSBOAlignment = vulkan->device->features.VkLimits.minStorageBufferOffsetAlignment;
+		if (bucketLightsSize % minSSBOAlignment) bucketLightsSize = (bucketLightsSize + minSSBOAlignment - 1) & ~(minSSBOAlignment - 1);
+
+		bucketLightsSliceSize = bucketLightsSize;
+
+		VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+		VkMemoryPropertyFlags flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+		bucketLightsBuffer = new Vulkan::KVulkanBuffer(vulkan, bucketLightsSize * uniformSlices, usage, flags);
+		bucketLightsBuffer->Map();
+
+		bucketLights.Reset(uniformSlices);
+	}
+
+	void KScene::CreateLightsBuffer()
+	{
+		// Double the light storage when it runs out so growing stays rare
+		lightCapacity = std::max(lightCapacity, 16u);
+		while (lightCapacity < lights.size()) lightCapacity <<= 1;
+
+		VkDeviceSize lightsSize = sizeof(Vulkan::KLightData) * lightCapacity;
+
+		size_t minSSBOAlignment = vulkan->device->features.VkLimits.minStorageBufferOffsetAlignment;
+		if (lightsSize % minSSBOAlignment) lightsSize = (lightsSize + minSSBOAlignment - 1) & ~(minSSBOAlignment - 1);
+
+		lightsSliceSize = lightsSize;
+
+		VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+		VkMemoryPropertyFlags flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+		lightsBuffer = new Vulkan::KVulkanBuffer(vulkan, lightsSize * uniformSlices, usage, flags);
+		lightsBuffer->Map();
+
+		lightsData.Reset(uniformSlices);
+	}
+
+	void KScene::GrowLightStorage()
+	{
+		// Frames in flight may still be reading the old storage
+		vulkan->FinishDrawing();
+
+		delete(lightsBuffer);
+		CreateLightsBuffer();
+
+		for (uint32_t i = 0; i < uniformSlices; ++i)
+		{
+			vulkan->descPool->UpdateBufferDescriptor(lightsDescriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0,
+			                                         lightsBuffer->GetDescriptorInfo(i * lightsSliceSize,
+			                                                                         lightsSliceSize));
+		}
+
+		// Batches which bound the rewritten descriptor sets have to be recorded again
+		vulkan->cmdPool->InvalidateAllBatches();
 	}
 
 	template <typename T>
@@ -425,76 +2223,212 @@ namespace Kitty
 			if (type == KT_BUFFER_INSTANCE) bufferFlags |= VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
 			if (type == KT_BUFFER_INDEX) bufferFlags |= VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
 
-			auto stagingBuffer = new Vulkan::KVulkanBuffer(vulkan, bufferSize, srcBufferFlags, srcMemFlags);
-			stagingBuffer->Fill(data);
 			buffer = new Vulkan::KVulkanBuffer(vulkan, bufferSize, bufferFlags, memFlags);
-			buffer->Copy(stagingBuffer);
-			delete(stagingBuffer);
+			buffer->Upload(data.data(), bufferSize);
 		}
 
 		return buffer;
 	}
 
-	void KScene::CreateDynamicUniformBuffers()
+	void KScene::CreateObjectTables()
 	{
-		// Calculate required alignment based on minimum device offset alignment
-		size_t minUBOAlignment = vulkan->device->features.VkLimits.minUniformBufferOffsetAlignment;
+		delete(objectTableBuffer);
+		delete(drawOrderBuffer);
+
+		// Objects are lit by the light clusters until lights are first selected for them
+		Vulkan::KObjectData empty = {};
+		empty.matrix = glm::mat4(1.0f);
+		empty.normalMatrix = glm::mat4(1.0f);
+		empty.lightCount = -1;
+
+		auto count = std::max(actualizedDraws, 1u);
+		objectData.Assign(count, empty);
+		drawOrderData.Assign(count, 0);
+
+		VkDeviceSize objectTableSize = sizeof(Vulkan::KObjectData) * count;
+		VkDeviceSize drawOrderSize = sizeof(uint32_t) * count;
+
+		size_t minSSBOAlignment = vulkan->device->features.VkLimits.minStorageBufferOffsetAlignment;
+		if (objectTableSize % minSSBOAlignment) objectTableSize = (objectTableSize + minSSBOAlignment - 1) & ~(minSSBOAlignment - 1);
+		if (drawOrderSize % minSSBOAlignment) drawOrderSize = (drawOrderSize + minSSBOAlignment - 1) & ~(minSSBOAlignment - 1);
+
+		objectTableSliceSize = objectTableSize;
+		drawOrderSliceSize = drawOrderSize;
+
+		VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+		VkMemoryPropertyFlags flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+		objectTableBuffer = new Vulkan::KVulkanBuffer(vulkan, objectTableSize * uniformSlices, usage, flags);
+		drawOrderBuffer = new Vulkan::KVulkanBuffer(vulkan, drawOrderSize * uniformSlices, usage, flags);
+		objectTableBuffer->Map();
+		drawOrderBuffer->Map();
 
-		dynamicAlignment = sizeof(Vulkan::vxDynamicUBO);
+		objectData.Reset(uniformSlices);
+		drawOrderData.Reset(uniformSlices);
+	}
+
+	void KScene::CreateMaterialTable()
+	{
+		delete(materialTableBuffer);
+
+		// Double the table when it runs out, like the light storage
+		materialCapacity = std::max(materialCapacity, 16u);
+		while (materialCapacity < std::max(materials.size(), materialData.Size())) materialCapacity <<= 1;
+
+		VkDeviceSize materialTableSize = sizeof(glm::vec4) * materialCapacity;
+
+		size_t minSSBOAlignment = vulkan->device->features.VkLimits.minStorageBufferOffsetAlignment;
+		if (materialTableSize % minSSBOAlignment) materialTableSize = (materialTableSize + minSSBOAlignment - 1) & ~(minSSBOAlignment - 1);
+
+		materialTableSliceSize = materialTableSize;
+
+		VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+		VkMemoryPropertyFlags flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+		materialTableBuffer = new Vulkan::KVulkanBuffer(vulkan, materialTableSize * uniformSlices, usage, flags);
+		materialTableBuffer->Map();
+
+		materialData.Reset(uniformSlices);
+	}
 
-		if (minUBOAlignment > 0)
+	void KScene::GrowMaterialTable()
+	{
+		// Frames in flight may still be reading the old table
+		vulkan->FinishDrawing();
+
+		CreateMaterialTable();
+
+		for (uint32_t i = 0; i < uniformSlices; ++i)
 		{
-			dynamicAlignment = (dynamicAlignment + minUBOAlignment - 1) & ~(minUBOAlignment - 1);
+			vulkan->descPool->UpdateBufferDescriptor(objectDescriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2,
+			                                         materialTableBuffer->GetDescriptorInfo(i * materialTableSliceSize,
+			                                                                                materialTableSliceSize));
 		}
 
-		size_t vxUBOSize = dynamicAlignment * objects.size();
-
-		if (vxUBOSize == 0) vxUBOSize = 1 * dynamicAlignment;
+		// Batches which bound the rewritten descriptor sets have to be recorded again
+		vulkan->cmdPool->InvalidateAllBatches();
+	}
 
-		VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-		VkMemoryPropertyFlags props = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+	void KScene::UpdateObjectTables(uint32_t slice)
+	{
+		if (objectTableBuffer == nullptr) return;
 
-		vxUBO = (Vulkan::vxDynamicUBO*)AlignedAlloc(vxUBOSize, dynamicAlignment);
-		vxDynamicBuffer = new Vulkan::KVulkanBuffer(vulkan, vxUBOSize, usage, props);
-		vxDynamicBuffer->Map();
-		assert(vxUBO);
+		objectData.Upload(slice, (char *) objectTableBuffer->mappedMemory + slice * objectTableSliceSize);
+		drawOrderData.Upload(slice, (char *) drawOrderBuffer->mappedMemory + slice * drawOrderSliceSize);
+		materialData.Upload(slice, (char *) materialTableBuffer->mappedMemory + slice * materialTableSliceSize);
 	}
 
-	void KScene::UpdateDynamicUniformBuffers()
+	void KScene::UpdateMaterialTable()
 	{
-		if (vxUBO != nullptr)
+		if (objectData.Empty()) return;
+
+		bool changed = materialParams.size() != materials.size();
+		materialParams.resize(materials.size());
+
+		for (size_t m = 0; m < materials.size(); ++m)
+		{
+			KMaterialProperties &mat = materials[m]->properties;
+			glm::vec4 params = glm::vec4(mat.specularStrength, mat.shininess, mat.ambientStrength,
+			                             mat.lightReception);
+
+			if (materialParams[m].first != materials[m] || materialParams[m].second != params)
+			{
+				materialParams[m] = std::make_pair(materials[m], params);
+				changed = true;
+			}
+		}
+
+		if (!changed) return;
+
+		materialSlots.clear();
+
+		// Materials with the same parameters share an entry, only the table index ends up per object
+		std::map<std::tuple<float, float, float, float>, uint32_t> entries;
+
+		for (auto &material : materialParams)
+		{
+			const glm::vec4 &params = material.second;
+			auto entry = entries.emplace(std::make_tuple(params.x, params.y, params.z, params.w),
+			                             static_cast<uint32_t>(entries.size()));
+
+			if (entry.second)
+			{
+				if (entry.first->second >= materialData.Size()) materialData.Resize(entry.first->second + 1);
+				materialData.Write(entry.first->second, params);
+			}
+
+			materialSlots[material.first] = entry.first->second;
+		}
+
+		materialData.Resize(std::max<size_t>(entries.size(), 1));
+
+		// Entries may have moved around, point the objects at their new ones
+		for (uint32_t i = 0; i < actualizedDraws; ++i)
 		{
-			memcpy(vxDynamicBuffer->mappedMemory, vxUBO, vxDynamicBuffer->size);
+			KMaterial *material = (i < actualizedObjects) ? entities.Get(KA_DRAWN).renders[i].material
+			                                              : staticChunks[i - actualizedObjects].material;
+			auto slot = materialSlots.find(material);
 
-			VkMappedMemoryRange vxMemoryRange {};
-			vxMemoryRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-			vxMemoryRange.memory = vxDynamicBuffer->bufferMemory;
-			vxMemoryRange.size = vxDynamicBuffer->size;
-			vkFlushMappedMemoryRanges(vulkan->device->device, 1, &vxMemoryRange);
+			Vulkan::KObjectData model = objectData[i];
+			model.material = (slot != materialSlots.end()) ? slot->second : 0;
+
+			objectData.Write(i, model);
 		}
 	}
 
-	void KScene::UpdateDynamicObjectBuffer(IObject *obj, uint32_t index)
+	void KScene::UpdateObjectData(uint32_t index)
+	{
+		KArchetype &drawn = entities.Get(KA_DRAWN);
+		auto slot = materialSlots.find(drawn.renders[index].material);
+
+		Vulkan::KObjectData model = objectData[index];
+		model.matrix = drawn.transforms[index].matrix;
+		model.normalMatrix = glm::transpose(glm::inverse(model.matrix));
+		model.material = (slot != materialSlots.end()) ? slot->second : 0;
+
+		objectData.Write(index, model);
+	}
+
+	void KScene::UpdateChunkData(uint32_t chunk)
 	{
-		KMaterialProperties mat = obj->GetMaterial()->properties;
+		auto slot = materialSlots.find(staticChunks[chunk].material);
 
-		auto model = (Vulkan::vxDynamicUBO *) (((uint64_t)vxUBO + (index * dynamicAlignment)));
-		model->matrix = obj->GetModelMatrix();
-		model->material = glm::vec4(mat.specularStrength,
-		                            mat.shininess,
-		                            mat.ambientStrength,
-		                            mat.lightReception);
+		// Vertices were transformed when the chunk was baked
+		Vulkan::KObjectData model = objectData[actualizedObjects + chunk];
+		model.matrix = glm::mat4(1.0f);
+		model.normalMatrix = glm::mat4(1.0f);
+		model.material = (slot != materialSlots.end()) ? slot->second : 0;
+
+		objectData.Write(actualizedObjects + chunk, model);
 	}
 
 	void KScene::DeleteEverything()
 	{
-		for (auto object : objects)
+		vulkan->FinishDrawing();
+
+		// Prefabs only refer to their parts by handle, nothing else to clean up
+		for (auto prefab : prefabs)
+		{
+			delete(prefab);
+		}
+
+		prefabs.clear();
+
+		for (uint32_t archetype = 0; archetype < KA_COUNT; ++archetype)
 		{
-			objLoader->RemoveFromCache(object->GetMesh());
-			delete(object);
+			for (auto object : entities.Get(archetype).owners)
+			{
+				objLoader->RemoveFromCache(object->GetMesh());
+				delete(object);
+			}
 		}
 
-		objects.clear();
+		entities.Clear();
+		staticChunks.clear();
+		staticChunkOf.clear();
+		meshUsers.clear();
+		actualizedObjects = 0;
+		actualizedDraws = 0;
 
 		for (auto material : materials)
 		{
@@ -502,8 +2436,9 @@ namespace Kitty
 		}
 
 		materials.clear();
+		materialHandles.Clear();
 
-		instancedObjects.clear();
+		FreeInstances();
 	}
 
 	KScene::~KScene()
@@ -525,14 +2460,30 @@ namespace Kitty
 			delete(light);
 		}
 
-		if (vxUBO) AlignedFree(vxUBO);
+		for (auto pipeline : computePipelines)
+		{
+			delete(pipeline);
+		}
+
+		for (auto buffer : storageBuffers)
+		{
+			delete(buffer);
+		}
 
-		delete(vxDynamicBuffer);
+		delete(objectTableBuffer);
+		delete(drawOrderBuffer);
+		delete(materialTableBuffer);
 		delete(uniformBuffer);
 		delete(lightsBuffer);
+		delete(clusterGridBuffer);
+		delete(clusterLightsBuffer);
+		delete(bucketLightsBuffer);
+		delete(lightClusters);
+		delete(renderQueue);
 
 		if (indexBuffer != dummyIndexBuffer) delete(indexBuffer);
 		if (vertexBuffer != dummyVertexBuffer) delete(vertexBuffer);
+		if (positionBuffer != dummyVertexBuffer) delete(positionBuffer);
 		if (instanceBuffer != dummyInstanceBuffer) delete(instanceBuffer);
 
 		delete(dummyIndexBuffer);
@@ -541,26 +2492,4 @@ namespace Kitty
 
 		context = nullptr;
 	}
-
-	void* KScene::AlignedAlloc(size_t size, size_t alignment)
-	{
-		void *data = nullptr;
-#if defined(_MSC_VER) || defined(__MINGW32__)
-		data = _aligned_malloc(size, alignment);
-#else
-		int res = posix_memalign(&data, alignment, size);
-		if (res != 0)
-			data = nullptr;
-#endif
-		return data;
-	}
-
-	void KScene::AlignedFree(void* data)
-	{
-#if	defined(_MSC_VER) || defined(__MINGW32__)
-		_aligned_free(data);
-#else
-		free(data);
-#endif
-	}
 }
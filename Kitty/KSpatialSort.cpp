@@ -0,0 +1,93 @@
+/**
+ * Kitty Engine
+ * KSpatialSort.cpp
+ *
+ * Spatial ordering for point data. Positions are mapped onto a 3D
+ * Morton curve, which interleaves the bits of their coordinates so
+ * points close to each other in the world get codes close to each
+ * other, and the codes are radix sorted in parallel through a job
+ * runner.
+ *
+ * \author Krista Koivisto
+ * \copyright Read included LICENSE file.
+ */
+
+#include <algorithm>
+#include <thread>
+#include "include/KSpatialSort.h"
+
+namespace Kitty
+{
+	// Spread the low 10 bits of a value out so there are two zero bits between each of them
+	static uint32_t SpreadBits(uint32_t value)
+	{
+		value &= 0x3FF;
+		value = (value | (value << 16)) & 0x030000FF;
+		value = (value | (value << 8)) & 0x0300F00F;
+		value = (value | (value << 4)) & 0x030C30C3;
+		value = (value | (value << 2)) & 0x09249249;
+
+		return value;
+	}
+
+	KSpatialSort::KSpatialSort(uint32_t threads)
+	{
+		threadCount = (threads != 0) ? threads : std::max(std::thread::hardware_concurrency(), 1u);
+		sorter.SetJobRunner(nullptr, threadCount);
+	}
+
+	void KSpatialSort::SetJobRunner(KJobRunner jobRunner)
+	{
+		runner = jobRunner;
+		sorter.SetJobRunner(std::move(jobRunner), threadCount);
+	}
+
+	uint32_t KSpatialSort::MortonCode(glm::vec3 position, glm::vec3 low, glm::vec3 high)
+	{
+		glm::vec3 extent = glm::max(high - low, glm::vec3(1e-6f));
+		glm::vec3 scaled = glm::clamp((position - low) / extent, glm::vec3(0.0f), glm::vec3(1.0f)) * 1023.0f;
+
+		return (SpreadBits(static_cast<uint32_t>(scaled.x)) << 2) |
+		       (SpreadBits(static_cast<uint32_t>(scaled.y)) << 1) |
+		       SpreadBits(static_cast<uint32_t>(scaled.z));
+	}
+
+	const std::vector<uint32_t> &KSpatialSort::Sort(const glm::vec3 *positions, uint32_t count)
+	{
+		sorter.Resize(count);
+
+		if (count == 0) return sorter.GetPayloads();
+
+		low = positions[0];
+		high = low;
+
+		for (uint32_t i = 1; i < count; ++i)
+		{
+			low = glm::min(low, positions[i]);
+			high = glm::max(high, positions[i]);
+		}
+
+		std::vector<uint32_t> &keys = sorter.GetKeys();
+		std::vector<uint32_t> &order = sorter.GetPayloads();
+		uint32_t blocks = sorter.GetBlockCount(count);
+		uint32_t blockSize = (count + blocks - 1) / blocks;
+
+		auto MakeCodes = [&](uint32_t block) {
+			uint32_t first = std::min(block * blockSize, count);
+			uint32_t last = std::min(first + blockSize, count);
+
+			for (uint32_t i = first; i < last; ++i)
+			{
+				keys[i] = MortonCode(positions[i], low, high);
+				order[i] = i;
+			}
+		};
+
+		if (blocks < 2) MakeCodes(0);
+		else runner(blocks, MakeCodes);
+
+		sorter.Sort();
+
+		return sorter.GetPayloads();
+	}
+}
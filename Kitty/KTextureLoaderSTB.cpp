@@ -34,6 +34,9 @@ namespace Kitty
 			auto vulkanTexture = new Vulkan::KVulkanTexture(vulkan, &context->settings);
 			tex->SetTextureImage(vulkanTexture, prop);
 
+			// The dummy texel is plain white, shaders can skip sampling it altogether
+			tex->properties.hasTexture = false;
+
 			return tex;
 		}
 
@@ -0,0 +1,16 @@
+// Packed per instance data, shared by the instancing shaders so they transform alike
+
+layout(location = 4) in vec3 instancePos;
+layout(location = 5) in vec4 instanceRot; // Quaternion, unpacked from snorm16
+layout(location = 6) in float instanceScale;
+layout(location = 7) in uint instanceParent;
+
+vec3 instanceRotate(vec3 v) {
+    // Quantization leaves the quaternion slightly off unit length
+    vec4 q = normalize(instanceRot);
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+vec3 instanceTransform(vec3 position) {
+    return instanceRotate(position * instanceScale) + instancePos;
+}
@@ -0,0 +1,24 @@
+// Scene object tables, set 2. Regular draws find their object through the draw order by
+// instance index, instanced draws through the parent index passed with each instance.
+
+struct objectData
+{
+    mat4 matrix;
+    mat4 normalMatrix;
+    uvec4 lights;
+    int lightCount;
+    uint material;
+};
+
+layout(std430, set = 2, binding = 0) readonly buffer ObjectTable {
+    objectData objects[];
+};
+
+layout(std430, set = 2, binding = 1) readonly buffer DrawOrder {
+    uint drawOrder[];
+};
+
+// x = Specular strength, y = Shininess, z = Ambient, w = Light reception
+layout(std430, set = 2, binding = 2) readonly buffer MaterialTable {
+    vec4 materials[];
+};
@@ -1,31 +1,60 @@
+vec3 PhongLight(uint i, vec3 N, vec3 V)
+{
+    vec4 lightOffset = lightStore.lights[i].position - fragWorldPos;
+    vec3 L = normalize(lightOffset).xyz;
+    vec3 R = reflect(L, N);
+
+    float distance = length(lightOffset);
+    float attenuation = 1.0 / (lightStore.lights[i].attenuation.x
+                             + lightStore.lights[i].attenuation.y * distance
+                             + lightStore.lights[i].attenuation.z * distance * distance);
+
+    vec3 diffuse = attenuation * max(dot(N, L), 0.0) * fragColor * lightStore.lights[i].color.xyz;
+
+    vec3 specular = attenuation
+                    * pow(max(dot(R, V), 0.0), fragMaterial.y)
+                    * lightStore.lights[i].color.xyz
+                    * vec3(fragMaterial.x);
+
+    return diffuse + specular;
+}
+
 vec4 Phong()
 {
     vec3 ambient = fragColor * fragMaterial.z;
     vec3 totalLighting = worldAmbient.xyz + ambient;
-    float attenuation;
 
     vec3 N = normalize(fragNormal);
     vec3 V = normalize(fragViewVec);
 
-    for (int i = 0; i < settings.numLights; i++)
+    // Objects lit by their nearest lights only need a handful
+    if (fragLightCount >= 0)
     {
-        vec4 lightOffset = ubo.lights[i].position - fragWorldPos;
-        vec3 L = normalize(lightOffset).xyz;
-        vec3 R = reflect(L, N);
+        for (int n = 0; n < 4; n++)
+        {
+            if (n >= fragLightCount) break;
+
+            totalLighting += PhongLight(fragLights[n], N, V);
+        }
 
-        float distance = length(lightOffset);
-        attenuation = 1.0 / (ubo.lights[i].attenuation.x
-                           + ubo.lights[i].attenuation.y * distance
-                           + ubo.lights[i].attenuation.z * distance * distance);
+        return vec4(totalLighting, 1.0);
+    }
 
-        vec3 diffuse = attenuation * max(dot(N, L), 0.0) * fragColor * ubo.lights[i].color.xyz;
+    // Find the cluster this fragment falls in, depth slices are exponential
+    float depth = max(-fragViewVec.z, 1e-4);
+    uvec3 cell = uvec3(uvec2(gl_FragCoord.xy / grid.params.xy), uint(max(log(depth) * grid.params.z + grid.params.w, 0.0)));
+    cell = min(cell, grid.size.xyz - 1);
 
-        vec3 specular = attenuation
-                        * pow(max(dot(R, V), 0.0), fragMaterial.y)
-                        * ubo.lights[i].color.xyz
-                        * vec3(fragMaterial.x);
+    uint cluster = cell.x + grid.size.x * (cell.y + grid.size.y * cell.z);
+    uint clusterCount = grid.counts[cluster];
+    uint first = cluster * grid.size.w;
+
+    // Constant loop bound so the compiler can unroll it, only the cluster's lights are visited
+    for (uint n = 0; n < MAX_LIGHTS; n++)
+    {
+        if (n >= clusterCount) break;
 
-        totalLighting += vec3(diffuse + specular);
+        totalLighting += PhongLight(clusterLights.indices[first + n], N, V);
     }
 
     return vec4(totalLighting, 1.0);// * (light.color * fragMaterial.w);
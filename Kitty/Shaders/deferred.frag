@@ -0,0 +1,86 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : enable
+
+#include "Bits/structs.frag"
+
+layout(location = 0) out vec4 outColor;
+
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+    mat4 view;
+    mat4 proj;
+    vec4 worldAmbient;
+    mat4 invView;
+    mat4 invProj;
+} ubo;
+
+// Written by gbuffer.frag in the previous subpass
+layout(input_attachment_index = 0, set = 1, binding = 0) uniform subpassInput inDepth;
+layout(input_attachment_index = 1, set = 1, binding = 1) uniform subpassInput inAlbedo;
+layout(input_attachment_index = 2, set = 1, binding = 2) uniform subpassInput inNormal;
+layout(input_attachment_index = 3, set = 1, binding = 3) uniform subpassInput inMaterial;
+
+layout(constant_id = 1) const uint MAX_LIGHTS = 64;
+
+layout(push_constant) uniform PushConstants {
+    uint numLights;
+} settings;
+
+layout (std430, set = 2, binding = 0) readonly buffer LightsSSBO {
+    lightSource lights[];
+} lightStore;
+
+layout (std430, set = 2, binding = 1) readonly buffer ClusterGrid {
+    uvec4 size;
+    vec4 params;
+    uint counts[];
+} grid;
+
+layout (std430, set = 2, binding = 2) readonly buffer ClusterLights {
+    uint indices[];
+} clusterLights;
+
+// What the forward shaders get from the vertex shader, filled from the G-buffer instead
+vec3 fragColor;
+vec3 fragNormal;
+vec3 fragViewVec;
+vec4 fragWorldPos;
+vec4 fragMaterial;
+vec4 worldAmbient;
+uvec4 fragLights;
+int fragLightCount;
+
+#include "Bits/phong.frag"
+
+void main() {
+    float depth = subpassLoad(inDepth).r;
+
+    // Nothing was drawn here, keep the clear color
+    if (depth >= 1.0) discard;
+
+    vec4 albedo = subpassLoad(inAlbedo);
+    vec4 normal = subpassLoad(inNormal);
+
+    if (normal.w < 0.5)
+    {
+        outColor = albedo;
+        return;
+    }
+
+    // The cluster grid knows the render area size, tile size times tile count
+    vec2 ndc = gl_FragCoord.xy / vec2(grid.params.xy * vec2(grid.size.xy)) * 2.0 - 1.0;
+    vec4 viewPos = ubo.invProj * vec4(ndc, depth, 1.0);
+    viewPos /= viewPos.w;
+
+    // Vertex colors are already part of the albedo, light with white and multiply afterwards
+    fragColor = vec3(1.0);
+    fragNormal = normal.xyz;
+    fragViewVec = viewPos.xyz;
+    fragWorldPos = ubo.invView * viewPos;
+    fragMaterial = subpassLoad(inMaterial);
+    worldAmbient = ubo.worldAmbient;
+    fragLights = uvec4(0);
+    fragLightCount = -1; // Per object light selection isn't kept, the clusters light everything
+
+    outColor = vec4(albedo.rgb, 1.0) * Phong();
+}
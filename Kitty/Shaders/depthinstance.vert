@@ -0,0 +1,24 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : enable
+
+// Depth pre-pass, transforms positions exactly like instance.vert so the equal depth test holds
+
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+    mat4 view;
+    mat4 proj;
+    vec4 worldAmbient;
+} ubo;
+
+#include "Bits/objects.vert"
+
+layout(location = 0) in vec3 inPosition;
+#include "Bits/instance.vert"
+
+invariant gl_Position;
+
+void main() {
+    objectData model = objects[instanceParent];
+    vec4 worldPos = model.matrix * vec4(instanceTransform(inPosition), 1.0);
+    gl_Position = ubo.proj * ubo.view * worldPos;
+}
@@ -0,0 +1,38 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : enable
+
+// Fills the G-buffer for deferred shading, see deferred.frag for the lighting
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) in vec3 fragNormal;
+layout(location = 3) in vec3 fragViewVec;
+layout(location = 4) in vec4 fragWorldPos;
+layout(location = 5) in vec4 fragMaterial; // x = Specular strength, y = Shininess, z = Ambient, w = Light reception
+layout(location = 6) in vec4 worldAmbient;
+layout(location = 7) flat in uvec4 fragLights;
+layout(location = 8) flat in int fragLightCount;
+
+layout(location = 0) out vec4 outAlbedo;
+layout(location = 1) out vec4 outNormal; // xyz = World space normal, w = Lighting model
+layout(location = 2) out vec4 outMaterial;
+
+layout(set = 1, binding = 0) uniform sampler2D texSampler;
+
+// Same specialization constants as uber.frag, so the same pipeline variants apply
+layout(constant_id = 0) const uint LIGHTING_MODEL = 1; // 0 = Simple, 1 = Phong
+layout(constant_id = 2) const bool HAS_TEXTURE = true;
+
+void main() {
+    vec4 albedo = vec4(fragColor, 1.0);
+
+    if (HAS_TEXTURE)
+    {
+        albedo *= texture(texSampler, fragTexCoord);
+    }
+
+    outAlbedo = albedo;
+    outNormal = vec4(normalize(fragNormal), float(LIGHTING_MODEL));
+    outMaterial = fragMaterial;
+}
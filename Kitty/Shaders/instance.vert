@@ -10,18 +10,25 @@ layout(set = 0, binding = 0) uniform UniformBufferObject {
     vec4 worldAmbient;
 } ubo;
 
-layout (set = 2, binding = 0) uniform DynamicUBO {
-	mat4 matrix;
-	vec4 material;
-} model;
+#include "Bits/objects.vert"
+
+// Consecutive instances share a light selection, matches KE_INSTANCE_BUCKET_SIZE
+const uint INSTANCE_BUCKET_SIZE = 64;
+
+struct LightSelection {
+	uvec4 lights;
+	int count; // -1 when the bucket is lit by the light clusters
+};
+
+layout (std430, set = 3, binding = 3) readonly buffer BucketLights {
+	LightSelection buckets[];
+} bucketLights;
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
 layout(location = 3) in vec3 inNormal;
-layout(location = 4) in vec3 instancePos;
-layout(location = 5) in vec3 instanceRot;
-layout(location = 6) in float instanceScale;
+#include "Bits/instance.vert"
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
@@ -30,17 +37,28 @@ layout(location = 3) out vec3 fragViewVec;
 layout(location = 4) out vec4 fragWorldPos;
 layout(location = 5) out vec4 fragMaterial;
 layout(location = 6) out vec4 worldAmbient;
+layout(location = 7) flat out uvec4 fragLights;
+layout(location = 8) flat out int fragLightCount;
+
+// Must match the depth pre-pass exactly for its equal depth test
+invariant gl_Position;
 
 void main() {
-    vec4 worldPos = model.matrix * vec4((inPosition * instanceScale) + instancePos, 1.0);
+    objectData model = objects[instanceParent];
+    vec4 worldPos = model.matrix * vec4(instanceTransform(inPosition), 1.0);
     gl_Position = ubo.proj * ubo.view * worldPos;
 
     fragColor = inColor;
     fragTexCoord = inTexCoord;
-    fragNormal = mat3(model.matrix) * inNormal;
+    fragNormal = mat3(model.normalMatrix) * instanceRotate(inNormal);
     fragViewVec = (ubo.view * worldPos).xyz;
     fragWorldPos = worldPos;
-    fragMaterial = model.material;
+    fragMaterial = materials[model.material];
     worldAmbient = ubo.worldAmbient;
+
+    // The instance index counts from the start of the instance buffer, not from the draw
+    LightSelection selection = bucketLights.buckets[uint(gl_InstanceIndex) / INSTANCE_BUCKET_SIZE];
+    fragLights = selection.lights;
+    fragLightCount = selection.count;
 }
 
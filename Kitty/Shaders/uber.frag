@@ -11,26 +11,49 @@ layout(location = 3) in vec3 fragViewVec;
 layout(location = 4) in vec4 fragWorldPos;
 layout(location = 5) in vec4 fragMaterial; // x = Specular strength, y = Shininess, z = Ambient, w = Light reception
 layout(location = 6) in vec4 worldAmbient;
+layout(location = 7) flat in uvec4 fragLights; // Lights selected for the object
+layout(location = 8) flat in int fragLightCount; // -1 when the object is lit by the light clusters
 
 layout(location = 0) out vec4 outColor;
 
 layout(set = 1, binding = 0) uniform sampler2D texSampler;
 
+// Baked into each pipeline variant, so the branches below are resolved when the pipeline is built
+layout(constant_id = 0) const uint LIGHTING_MODEL = 1; // 0 = Simple, 1 = Phong
+layout(constant_id = 1) const uint MAX_LIGHTS = 64;
+layout(constant_id = 2) const bool HAS_TEXTURE = true;
+
 layout(push_constant) uniform PushConstants {
-    bool usePhong;
     uint numLights;
 } settings;
 
-layout (set = 3, binding = 0) uniform LightsUBO {
-	lightSource lights[128];
-} ubo;
+// Sized to the scene's light count at runtime
+layout (std430, set = 3, binding = 0) readonly buffer LightsSSBO {
+    lightSource lights[];
+} lightStore;
+
+// Lights binned into view space clusters, see KLightClusters
+layout (std430, set = 3, binding = 1) readonly buffer ClusterGrid {
+    uvec4 size;   // x, y, z = Clusters along each axis, w = Max lights per cluster
+    vec4 params;  // x, y = Tile size in pixels, z = Depth slice scale, w = Depth slice bias
+    uint counts[];
+} grid;
+
+layout (std430, set = 3, binding = 2) readonly buffer ClusterLights {
+    uint indices[];
+} clusterLights;
 
 #include "Bits/phong.frag"
 
 void main() {
-    vec4 finalColor = texture(texSampler, fragTexCoord);
+    vec4 finalColor = vec4(1.0);
+
+    if (HAS_TEXTURE)
+    {
+        finalColor = texture(texSampler, fragTexCoord);
+    }
 
-    if (settings.usePhong == true)
+    if (LIGHTING_MODEL == 1)
     {
         finalColor *= Phong();
     }
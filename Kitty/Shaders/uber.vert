@@ -8,10 +8,7 @@ layout(set = 0, binding = 0) uniform UniformBufferObject {
     vec4 worldAmbient;
 } ubo;
 
-layout (set = 2, binding = 0) uniform DynamicUBO {
-	mat4 matrix;
-	vec4 material;
-} model;
+#include "Bits/objects.vert"
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
@@ -25,17 +22,25 @@ layout(location = 3) out vec3 fragViewVec;
 layout(location = 4) out vec4 fragWorldPos;
 layout(location = 5) out vec4 fragMaterial;
 layout(location = 6) out vec4 worldAmbient;
+layout(location = 7) flat out uvec4 fragLights;
+layout(location = 8) flat out int fragLightCount;
+
+// Must match the depth pre-pass exactly for its equal depth test
+invariant gl_Position;
 
 void main() {
+    objectData model = objects[drawOrder[gl_InstanceIndex]];
     vec4 worldPos = model.matrix * vec4(inPosition, 1.0);
     gl_Position = ubo.proj * ubo.view * worldPos;
 
     fragColor = inColor;
     fragTexCoord = inTexCoord;
-    fragNormal = mat3(model.matrix) * inNormal;
+    fragNormal = mat3(model.normalMatrix) * inNormal;
     fragViewVec = (ubo.view * worldPos).xyz;
     fragWorldPos = worldPos;
-    fragMaterial = model.material;
+    fragMaterial = materials[model.material];
     worldAmbient = ubo.worldAmbient;
+    fragLights = model.lights;
+    fragLightCount = model.lightCount;
 }
 
@@ -32,27 +32,42 @@ namespace Kitty
 			ret = InitializeDevice();
 			if (ret != KE_OK) throw std::runtime_error(WhatWentWrong(ret));
 
+			ret = InitializeTransfer();
+			if (ret != KE_OK) throw std::runtime_error(WhatWentWrong(ret));
+
+			ret = InitializeRecorder();
+			if (ret != KE_OK) throw std::runtime_error(WhatWentWrong(ret));
+
+			ret = InitializePipelineCache();
+			if (ret != KE_OK) throw std::runtime_error(WhatWentWrong(ret));
+
 			ret = InitializeDescriptorLayouts();
 			if (ret != KE_OK) throw std::runtime_error(WhatWentWrong(ret));
 
 			ret = InitializeGraphics();
 			if (ret != KE_OK) throw std::runtime_error(WhatWentWrong(ret));
 
-			ret = InitializeSemaphores();
+			ret = InitializeFrames();
 			if (ret != KE_OK) throw std::runtime_error(WhatWentWrong(ret));
 		}
 
 		void KVulkan::DrawFrame()
 		{
 			uint32_t imageIndex;
-			VkCommandBuffer commandBuffer;
 			VkQueue graphicsQueue = device->graphicsQueue;
 			VkQueue presentQueue = device->presentQueue;
 			std::vector<VkCommandBuffer> cmdBuffers;
+			KVulkanFrame &frame = frames[currentFrame];
+
+			// Wait until the GPU is done with the last frame which used these resources
+			vkWaitForFences(device->device, 1, &frame.inFlightFence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+
+			// Make sure anything uploaded since the last frame is on its way before drawing
+			transfer->Flush();
 
 			VkResult result = vkAcquireNextImageKHR(device->device, swapChain->swapChain,
 			                                        std::numeric_limits<uint64_t>::max(),
-			                                        imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+			                                        frame.imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
 
 			if (result == VK_ERROR_OUT_OF_DATE_KHR)
 			{
@@ -71,8 +86,20 @@ namespace Kitty
 				throw std::runtime_error(WhatWentWrong(KE_VULKAN_DRAW_FAIL));
 			}
 
-			VkSemaphore waitSemaphores[] = {imageAvailableSemaphore};
-			VkSemaphore signalSemaphores[] = {renderFinishedSemaphore};
+			// The image may still be in use by an earlier frame if images are acquired out of order
+			if (imagesInFlight[imageIndex] != VK_NULL_HANDLE)
+			{
+				vkWaitForFences(device->device, 1, &imagesInFlight[imageIndex], VK_TRUE,
+				                std::numeric_limits<uint64_t>::max());
+			}
+
+			imagesInFlight[imageIndex] = frame.inFlightFence;
+
+			// Now that the image's command buffers are idle, re-record whatever changed since
+			cmdPool->UpdateGraphicsBuffer(imageIndex);
+
+			VkSemaphore waitSemaphores[] = {frame.imageAvailableSemaphore};
+			VkSemaphore signalSemaphores[] = {frame.renderFinishedSemaphore};
 			VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
 
 			VkSubmitInfo si = {};
@@ -86,16 +113,26 @@ namespace Kitty
 
 			if (settings->commands.sceneRenderCallback != nullptr)
 			{
-				commandBuffer = cmdPool->InitiateCommand();
-				settings->commands.sceneRenderCallback(&commandBuffer, imageIndex);
-				cmdBuffers.push_back(commandBuffer);
+				// Everything recorded from this pool last time around has finished executing, so the
+				// whole pool is recycled in one go and its command buffer is reused
+				vkResetCommandPool(device->device, frame.commandPool, 0);
+
+				VkCommandBufferBeginInfo beginInfo = {};
+				beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+				beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+				vkBeginCommandBuffer(frame.renderCommand, &beginInfo);
+
+				settings->commands.sceneRenderCallback(&frame.renderCommand, imageIndex);
+				cmdBuffers.push_back(frame.renderCommand);
 			}
 
 			cmdBuffers.push_back(cmdPool->commandBuffers[imageIndex]);
 			si.commandBufferCount = static_cast<uint32_t >(cmdBuffers.size());
 			si.pCommandBuffers = cmdBuffers.data();
 
-			if (vkQueueSubmit(graphicsQueue, 1, &si, VK_NULL_HANDLE) != VK_SUCCESS)
+			vkResetFences(device->device, 1, &frame.inFlightFence);
+
+			if (vkQueueSubmit(graphicsQueue, 1, &si, frame.inFlightFence) != VK_SUCCESS)
 			{
 				throw std::runtime_error(WhatWentWrong(KE_VULKAN_DRAW_FAIL));
 			}
@@ -110,15 +147,24 @@ namespace Kitty
 			presentInfo.pSwapchains = swapChains;
 			presentInfo.pImageIndices = &imageIndex;
 
-			if (vkQueuePresentKHR(presentQueue, &presentInfo) != VK_SUCCESS)
+			result = vkQueuePresentKHR(presentQueue, &presentInfo);
+			currentFrame = (currentFrame + 1) % static_cast<uint32_t>(frames.size());
+
+			if (result == VK_ERROR_OUT_OF_DATE_KHR)
 			{
-				throw std::runtime_error(WhatWentWrong(KE_VULKAN_DRAW_FAIL));
+				if (outdatedSwapChainCallback != nullptr)
+				{
+					outdatedSwapChainCallback();
+				}
+				else
+				{
+					throw std::runtime_error(WhatWentWrong(KE_VULKAN_SC_OUT_OF_DATE));
+				}
 			}
-
-			vkQueueWaitIdle(presentQueue);
-			if (settings->commands.sceneRenderCallback != nullptr)
+			else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
 			{
-				vkFreeCommandBuffers(device->device, cmdPool->commandPool, 1, &commandBuffer);
+				// Suboptimal still presents fine, the window resize handling will catch up with it
+				throw std::runtime_error(WhatWentWrong(KE_VULKAN_DRAW_FAIL));
 			}
 		}
 
@@ -129,8 +175,81 @@ namespace Kitty
 
 		void KVulkan::RecreateSwapChain()
 		{
-			DestroySwapChain();
-			InitializeGraphics();
+			KError ret;
+
+			FinishDrawing();
+
+			// Handing the old swap chain over lets the presentation engine reuse its resources
+			KVulkanSwapChain *oldSwapChain = swapChain;
+			VkFormat oldFormat = oldSwapChain->swapChainImageFormat;
+
+			swapChain = new KVulkanSwapChain(this);
+			ret = swapChain->Initialize(&settings->desiredSurfaceFormat,
+			                            &settings->desiredPresentMode,
+			                            &settings->swapChainCreateInfo,
+			                            oldSwapChain->swapChain);
+			delete(oldSwapChain);
+			if (ret != KE_OK) throw std::runtime_error(WhatWentWrong(ret));
+
+			// Viewport and scissor are dynamic, so the render pass and pipelines only care about the format
+			if (swapChain->swapChainImageFormat != oldFormat)
+			{
+				DestroyPipelines();
+				delete(mainRenderPass);
+
+				ret = InitializeRenderPass();
+				if (ret != KE_OK) throw std::runtime_error(WhatWentWrong(ret));
+
+				ret = InitializeGraphicsPipelines();
+				if (ret != KE_OK) throw std::runtime_error(WhatWentWrong(ret));
+			}
+
+			delete(frameBuffer);
+			DestroyGBuffer();
+			delete(depthImageView);
+			delete(depthImage);
+
+			ret = InitializeDepthBuffer();
+			if (ret != KE_OK) throw std::runtime_error(WhatWentWrong(ret));
+
+			ret = InitializeGBuffer();
+			if (ret != KE_OK) throw std::runtime_error(WhatWentWrong(ret));
+
+			ret = InitializeFramebuffer();
+			if (ret != KE_OK) throw std::runtime_error(WhatWentWrong(ret));
+
+			imagesInFlight.assign(swapChain->swapChainImages.size(), VK_NULL_HANDLE);
+
+			// The command buffers reference the old framebuffers, record them again
+			ret = cmdPool->InitializeGraphicsBuffer(&settings->commands);
+			if (ret != KE_OK) throw std::runtime_error(WhatWentWrong(ret));
+
+			ret = transferCmdPool->InitializeTransferBuffer(&settings->commands);
+			if (ret != KE_OK) throw std::runtime_error(WhatWentWrong(ret));
+		}
+
+		void KVulkan::RecreatePipelines()
+		{
+			FinishDrawing();
+			DestroyPipelines();
+
+			KError ret = InitializeGraphicsPipelines();
+			if (ret != KE_OK) throw std::runtime_error(WhatWentWrong(ret));
+		}
+
+		void KVulkan::SetDynamicState(VkCommandBuffer buf)
+		{
+			VkExtent2D extent = swapChain->swapChainExtent;
+
+			VkViewport viewport = graphicsSettings->viewport;
+			if (!viewport.width) viewport.width = (float) extent.width;
+			if (!viewport.height) viewport.height = (float) extent.height;
+
+			VkRect2D scissor = graphicsSettings->scissor;
+			if (scissor.extent.width == 0 && scissor.extent.height == 0) scissor.extent = extent;
+
+			vkCmdSetViewport(buf, 0, 1, &viewport);
+			vkCmdSetScissor(buf, 0, 1, &scissor);
 		}
 
 		void KVulkan::RecreateDescriptorPool()
@@ -154,6 +273,19 @@ namespace Kitty
 			if (ret != KE_OK) throw std::runtime_error(WhatWentWrong(ret));
 		}
 
+		void KVulkan::SetRecordingThreads(uint32_t threadCount)
+		{
+			FinishDrawing();
+
+			delete (recorder);
+			settings->recordingThreads = threadCount;
+
+			KError ret = InitializeRecorder();
+			if (ret != KE_OK) throw std::runtime_error(WhatWentWrong(ret));
+
+			RecreateCommandPool();
+		}
+
 		KError KVulkan::Initialize()
 		{
 			KError ret;
@@ -192,14 +324,21 @@ namespace Kitty
 			ret = InitializeDepthBuffer();
 			if (ret != KE_OK) return ret;
 
+			ret = InitializeGBuffer();
+			if (ret != KE_OK) return ret;
+
 			ret = InitializeFramebuffer();
 			if (ret != KE_OK) return ret;
 
+			imagesInFlight.assign(swapChain->swapChainImages.size(), VK_NULL_HANDLE);
+
 			ret = cmdPool->InitializeGraphicsBuffer(&settings->commands);
 			if (ret != KE_OK) return ret;
 
 			ret = transferCmdPool->InitializeTransferBuffer(&settings->commands);
 			if (ret != KE_OK) return ret;
+
+			return KE_OK;
 		}
 
 		KError KVulkan::InitializeInstance(VkApplicationInfo *applicationInfo)
@@ -247,6 +386,113 @@ namespace Kitty
 			return device->Initialize(&settings->requestedFeatures, &settings->devCreateInfo, &settings->deviceExtensions);
 		}
 
+		KError KVulkan::InitializeTransfer()
+		{
+			transfer = new KVulkanTransfer(this, settings->transferStagingSize);
+
+			return KE_OK;
+		}
+
+		KError KVulkan::InitializeRecorder()
+		{
+			recorder = new KVulkanCommandRecorder(this, settings->recordingThreads);
+
+			return KE_OK;
+		}
+
+		KError KVulkan::InitializePipelineCache()
+		{
+			std::vector<char> data;
+			std::string filename = GetPipelineCacheFilename();
+
+			if (!filename.empty())
+			{
+				KHelper helper;
+				data = helper.ReadBinaryFile(filename);
+			}
+
+			// Make sure the cache was written by this device before handing it to the driver
+			if (data.size() >= 16 + VK_UUID_SIZE)
+			{
+				uint32_t header[4] = {};
+				memcpy(header, data.data(), sizeof(header));
+
+				if (header[0] < 16 + VK_UUID_SIZE || header[1] != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+				    header[2] != device->features.vendorId || header[3] != device->features.id ||
+				    memcmp(data.data() + 16, device->features.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+				{
+					data.clear();
+				}
+			}
+			else
+			{
+				data.clear();
+			}
+
+			VkPipelineCacheCreateInfo cacheInfo = {};
+			cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+			cacheInfo.initialDataSize = data.size();
+			cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+			if (vkCreatePipelineCache(device->device, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS)
+			{
+				// The driver didn't like the old data after all, start over with an empty cache
+				cacheInfo.initialDataSize = 0;
+				cacheInfo.pInitialData = nullptr;
+
+				if (vkCreatePipelineCache(device->device, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS)
+				{
+					return KE_VULKAN_PIPELINE_CACHE_FAIL;
+				}
+			}
+
+			return KE_OK;
+		}
+
+		std::string KVulkan::GetPipelineCacheFilename()
+		{
+			if (settings->pipelineCacheDirectory.empty()) return "";
+
+			static const char hex[] = "0123456789abcdef";
+			std::string uuid;
+
+			for (auto byte : device->features.pipelineCacheUUID)
+			{
+				uuid += hex[byte >> 4];
+				uuid += hex[byte & 0xf];
+			}
+
+			return settings->pipelineCacheDirectory + "/kitty_pipelines_" + uuid + "_" +
+			       std::to_string(device->features.driverVersion) + ".bin";
+		}
+
+		void KVulkan::SavePipelineCache()
+		{
+			std::string filename = GetPipelineCacheFilename();
+			if (filename.empty() || pipelineCache == VK_NULL_HANDLE) return;
+
+			size_t size = 0;
+			if (vkGetPipelineCacheData(device->device, pipelineCache, &size, nullptr) != VK_SUCCESS || size == 0)
+			{
+				return;
+			}
+
+			std::vector<char> data(size);
+			if (vkGetPipelineCacheData(device->device, pipelineCache, &size, data.data()) != VK_SUCCESS)
+			{
+				return;
+			}
+
+			data.resize(size);
+
+			// Not being able to save the cache only makes the next start slower, so just let the user know
+			KHelper helper;
+			if (!helper.WriteBinaryFile(filename, data))
+			{
+				std::cerr << "Failed to write pipeline cache to " << filename << "!" << std::endl;
+			}
+		}
+
 		KError KVulkan::InitializeSwapChain()
 		{
 			swapChain = new KVulkanSwapChain(this);
@@ -270,16 +516,44 @@ namespace Kitty
 				return KE_VULKAN_DESC_SET_LAYOUT_FAIL;
 			}
 
-			if (!descPool->InitializeBinding(&graphicsSettings->vxUniformLayoutBinding, &vxUniformBufferDescriptorLayout))
+			std::vector<VkDescriptorSetLayoutBinding> objectBindings = { graphicsSettings->objectTableLayoutBinding,
+			                                                             graphicsSettings->drawOrderLayoutBinding,
+			                                                             graphicsSettings->materialTableLayoutBinding };
+
+			if (!descPool->InitializeBindings(objectBindings, &objectDescriptorLayout))
 			{
 				return KE_VULKAN_DESC_SET_LAYOUT_FAIL;
 			}
 
-			if (!descPool->InitializeBinding(&graphicsSettings->lightsLayoutBinding, &lightsDescriptorLayout))
+			std::vector<VkDescriptorSetLayoutBinding> lightsBindings = { graphicsSettings->lightsLayoutBinding,
+			                                                             graphicsSettings->clusterGridLayoutBinding,
+			                                                             graphicsSettings->clusterLightsLayoutBinding,
+			                                                             graphicsSettings->bucketLightsLayoutBinding };
+
+			if (!descPool->InitializeBindings(lightsBindings, &lightsDescriptorLayout))
 			{
 				return KE_VULKAN_DESC_SET_LAYOUT_FAIL;
 			}
 
+			if (graphicsSettings->deferredShading)
+			{
+				// Depth followed by the G-buffer attachments, as laid out by the render pass
+				std::vector<VkDescriptorSetLayoutBinding> gBufferBindings(graphicsSettings->gBufferFormats.size() + 1);
+
+				for (uint32_t i = 0; i < gBufferBindings.size(); ++i)
+				{
+					gBufferBindings[i].binding = i;
+					gBufferBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+					gBufferBindings[i].descriptorCount = 1;
+					gBufferBindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+				}
+
+				if (!descPool->InitializeBindings(gBufferBindings, &gBufferDescriptorLayout))
+				{
+					return KE_VULKAN_DESC_SET_LAYOUT_FAIL;
+				}
+			}
+
 			return KE_OK;
 		}
 
@@ -287,7 +561,7 @@ namespace Kitty
 		{
 			std::vector<VkDescriptorSetLayout> setLayouts = { vertexDescriptorLayout,
 			                                                  fragmentDescriptorLayout,
-			                                                  vxUniformBufferDescriptorLayout,
+			                                                  objectDescriptorLayout,
 			                                                  lightsDescriptorLayout };
 
 			// General pipeline
@@ -302,16 +576,42 @@ namespace Kitty
 			graphicsSettings->vertexInputInfo.pVertexAttributeDescriptions = attribDesc.data();
 			graphicsSettings->vertexInputInfo.vertexAttributeDescriptionCount = attribDesc.size();
 
+			auto mainSettings = *graphicsSettings;
+			std::vector<VkPipelineColorBlendAttachmentState> gBufferBlend(graphicsSettings->gBufferFormats.size(),
+			                                                              graphicsSettings->colorBlendAttachment);
+
+			// Objects only fill the G-buffer when shading deferred, the lighting pipeline does the rest
+			if (graphicsSettings->deferredShading)
+			{
+				mainSettings.fragmentShaders = mainSettings.gBufferFragmentShaders;
+				mainSettings.colorBlending.attachmentCount = static_cast<uint32_t>(gBufferBlend.size());
+				mainSettings.colorBlending.pAttachments = gBufferBlend.data();
+			}
+
+			// The pre-pass shares the main layout, so the same descriptor sets bind to both
+			auto depthSettings = mainSettings;
+			std::vector<VkPipelineColorBlendAttachmentState> depthBlend(mainSettings.colorBlending.attachmentCount,
+			                                                            mainSettings.colorBlendAttachment);
+
+			for (auto &blend : depthBlend) blend.colorWriteMask = 0;
+
+			if (graphicsSettings->depthPrePass)
+			{
+				// Depth is already in place, only shade the fragments which ended up visible
+				mainSettings.depthStencil.depthCompareOp = VK_COMPARE_OP_EQUAL;
+				mainSettings.depthStencil.depthWriteEnable = VK_FALSE;
+			}
+
 			mainPipeline = new KVulkanGraphicsPipeline(this);
-			KError ret = mainPipeline->Initialize(graphicsSettings);
+			KError ret = mainPipeline->Initialize(&mainSettings);
 			if (ret != KE_OK) return ret;
 
 			// Instance pipeline
 			if (graphicsSettings->doCreateInstancingPipeline)
 			{
-				auto instanceSettings = *graphicsSettings;
+				auto instanceSettings = mainSettings;
 				std::array<VkVertexInputBindingDescription, 2> inBindDesc = Vertex::getInstanceBindingDescription();
-				std::array<VkVertexInputAttributeDescription, 7> inAttribDesc = Vertex::getInstanceAttributeDescriptions();
+				std::array<VkVertexInputAttributeDescription, 8> inAttribDesc = Vertex::getInstanceAttributeDescriptions();
 				instanceSettings.vertexInputInfo.pVertexBindingDescriptions = inBindDesc.data();
 				instanceSettings.vertexInputInfo.vertexBindingDescriptionCount = inBindDesc.size();
 				instanceSettings.vertexInputInfo.pVertexAttributeDescriptions = inAttribDesc.data();
@@ -320,6 +620,78 @@ namespace Kitty
 
 				instancePipeline = new KVulkanGraphicsPipeline(this);
 				ret = instancePipeline->Initialize(&instanceSettings);
+				if (ret != KE_OK) return ret;
+			}
+
+			// Depth pre-pass pipelines, positions only and no fragment shader
+			if (graphicsSettings->depthPrePass)
+			{
+				VkVertexInputBindingDescription posBindDesc = Vertex::getPositionBindingDescription();
+				VkVertexInputAttributeDescription posAttribDesc = Vertex::getPositionAttributeDescription();
+
+				depthSettings.vertexShaders = depthSettings.depthVertexShaders;
+				depthSettings.fragmentShaders.clear();
+				depthSettings.shaderVariants.clear();
+				depthSettings.colorBlending.pAttachments = depthBlend.data();
+				depthSettings.vertexInputInfo.pVertexBindingDescriptions = &posBindDesc;
+				depthSettings.vertexInputInfo.vertexBindingDescriptionCount = 1;
+				depthSettings.vertexInputInfo.pVertexAttributeDescriptions = &posAttribDesc;
+				depthSettings.vertexInputInfo.vertexAttributeDescriptionCount = 1;
+
+				depthPipeline = new KVulkanGraphicsPipeline(this);
+				ret = depthPipeline->Initialize(&depthSettings);
+				if (ret != KE_OK) return ret;
+
+				if (graphicsSettings->doCreateInstancingPipeline)
+				{
+					// Instance data stays as is, only the per vertex stream is swapped out
+					auto inBindDesc = Vertex::getInstanceBindingDescription();
+					auto inAttribDesc = Vertex::getInstanceAttributeDescriptions();
+					inBindDesc[0] = posBindDesc;
+					std::array<VkVertexInputAttributeDescription, 5> depthAttribDesc = {
+							posAttribDesc, inAttribDesc[4], inAttribDesc[5], inAttribDesc[6], inAttribDesc[7]
+					};
+
+					auto depthInstanceSettings = depthSettings;
+					depthInstanceSettings.vertexShaders = depthInstanceSettings.depthInstanceVertexShaders;
+					depthInstanceSettings.vertexInputInfo.pVertexBindingDescriptions = inBindDesc.data();
+					depthInstanceSettings.vertexInputInfo.vertexBindingDescriptionCount = inBindDesc.size();
+					depthInstanceSettings.vertexInputInfo.pVertexAttributeDescriptions = depthAttribDesc.data();
+					depthInstanceSettings.vertexInputInfo.vertexAttributeDescriptionCount = depthAttribDesc.size();
+
+					depthInstancePipeline = new KVulkanGraphicsPipeline(this);
+					ret = depthInstancePipeline->Initialize(&depthInstanceSettings);
+					if (ret != KE_OK) return ret;
+				}
+			}
+
+			// Deferred lighting pipeline, a full screen triangle in the second subpass
+			if (graphicsSettings->deferredShading)
+			{
+				std::vector<VkDescriptorSetLayout> lightingLayouts = { vertexDescriptorLayout,
+				                                                       gBufferDescriptorLayout,
+				                                                       lightsDescriptorLayout };
+
+				auto lightingSettings = *graphicsSettings;
+				lightingSettings.vertexShaders = lightingSettings.lightingVertexShaders;
+				lightingSettings.fragmentShaders = lightingSettings.lightingFragmentShaders;
+				lightingSettings.shaderVariants.clear();
+				lightingSettings.pipelineLayoutInfo.pSetLayouts = lightingLayouts.data();
+				lightingSettings.pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(lightingLayouts.size());
+				lightingSettings.pipelineInfo.subpass = 1;
+
+				// Vertices are generated in the vertex shader
+				lightingSettings.vertexInputInfo.pVertexBindingDescriptions = nullptr;
+				lightingSettings.vertexInputInfo.vertexBindingDescriptionCount = 0;
+				lightingSettings.vertexInputInfo.pVertexAttributeDescriptions = nullptr;
+				lightingSettings.vertexInputInfo.vertexAttributeDescriptionCount = 0;
+
+				lightingSettings.rasterizer.cullMode = VK_CULL_MODE_NONE;
+				lightingSettings.depthStencil.depthTestEnable = VK_FALSE;
+				lightingSettings.depthStencil.depthWriteEnable = VK_FALSE;
+
+				lightingPipeline = new KVulkanGraphicsPipeline(this);
+				ret = lightingPipeline->Initialize(&lightingSettings);
 			}
 
 			return ret;
@@ -340,23 +712,63 @@ namespace Kitty
 
 		KError KVulkan::InitializeCommandPools()
 		{
-			settings->commands.poolInfo.queueFamilyIndex = device->features.graphicsFamily;
-			cmdPool = new KVulkanCommandPool(this, &settings->commands);
+			// Graphics command buffers get re-recorded individually when parts of the scene change
+			KVulkanCommandSettings graphicsCommands = settings->commands;
+			graphicsCommands.poolInfo.queueFamilyIndex = device->features.graphicsFamily;
+			graphicsCommands.poolInfo.flags |= VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+			cmdPool = new KVulkanCommandPool(this, &graphicsCommands);
 			settings->commands.poolInfo.queueFamilyIndex = device->features.transferFamily;
 			transferCmdPool = new KVulkanCommandPool(this, &settings->commands);
 
 			return KE_OK;
 		}
 
-		KError KVulkan::InitializeSemaphores()
+		KError KVulkan::InitializeFrames()
 		{
 			VkSemaphoreCreateInfo semaphoreInfo = {};
 			semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-			if (vkCreateSemaphore(device->device, &semaphoreInfo, nullptr, &imageAvailableSemaphore) != VK_SUCCESS ||
-			    vkCreateSemaphore(device->device, &semaphoreInfo, nullptr, &renderFinishedSemaphore) != VK_SUCCESS)
+			// Fences start signaled, there is nothing to wait for before the first frame
+			VkFenceCreateInfo fenceInfo = {};
+			fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+			fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+			VkCommandPoolCreateInfo poolInfo = {};
+			poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+			poolInfo.queueFamilyIndex = device->features.graphicsFamily;
+
+			frames.resize(std::max(settings->framesInFlight, 1u));
+			currentFrame = 0;
+
+			for (auto &frame : frames)
 			{
-				return KE_VULKAN_SEMAPHORE_FAIL;
+				if (vkCreateSemaphore(device->device, &semaphoreInfo, nullptr, &frame.imageAvailableSemaphore) != VK_SUCCESS ||
+				    vkCreateSemaphore(device->device, &semaphoreInfo, nullptr, &frame.renderFinishedSemaphore) != VK_SUCCESS)
+				{
+					return KE_VULKAN_SEMAPHORE_FAIL;
+				}
+
+				if (vkCreateFence(device->device, &fenceInfo, nullptr, &frame.inFlightFence) != VK_SUCCESS)
+				{
+					return KE_VULKAN_FENCE_FAIL;
+				}
+
+				if (vkCreateCommandPool(device->device, &poolInfo, nullptr, &frame.commandPool) != VK_SUCCESS)
+				{
+					return KE_VULKAN_CMDPOOL_FAIL;
+				}
+
+				VkCommandBufferAllocateInfo allocInfo = {};
+				allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+				allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+				allocInfo.commandPool = frame.commandPool;
+				allocInfo.commandBufferCount = 1;
+
+				if (vkAllocateCommandBuffers(device->device, &allocInfo, &frame.renderCommand) != VK_SUCCESS)
+				{
+					return KE_VULKAN_CMDBUFFERS_FAIL;
+				}
 			}
 
 			return KE_OK;
@@ -365,10 +777,14 @@ namespace Kitty
 		KError KVulkan::InitializeDepthBuffer()
 		{
 			auto depthFormat = device->features.depthFormat;
+
+			// The deferred lighting pass reads depth back as an input attachment
+			VkImageUsageFlags usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+			if (graphicsSettings->deferredShading) usage |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+
 			depthImage = new KVulkanImage(this, swapChain->swapChainExtent.width,
 			                                    swapChain->swapChainExtent.height,
-			                                    depthFormat, VK_IMAGE_TILING_OPTIMAL,
-			                                    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+			                                    depthFormat, VK_IMAGE_TILING_OPTIMAL, usage,
 			                                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
 			depthImageView = new Vulkan::KVulkanImageView(this);
@@ -376,8 +792,61 @@ namespace Kitty
 			createInfo.format = depthFormat;
 			createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
 			depthImageView->Initialize(createInfo, depthImage->image);
-			depthImage->TransitionImageLayout(depthFormat, VK_IMAGE_LAYOUT_UNDEFINED,
-			                                  VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+
+			// No separate layout transition needed, the render pass moves the depth image out of
+			// its undefined layout at the start of every frame
+
+			return KE_OK;
+		}
+
+		KError KVulkan::InitializeGBuffer()
+		{
+			if (!graphicsSettings->deferredShading) return KE_OK;
+
+			VkExtent2D extent = swapChain->swapChainExtent;
+			std::vector<VkDescriptorImageInfo> imageInfos;
+
+			VkDescriptorImageInfo depthInfo = {};
+			depthInfo.imageView = depthImageView->imageView;
+			depthInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+			imageInfos.push_back(depthInfo);
+
+			// Transient, the G-buffer only lives within the render pass so tilers can keep it on chip and
+			// never back it with memory at all. Devices without lazily allocated memory get regular memory.
+			VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT |
+			                          VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+			VkMemoryPropertyFlags memory = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+
+			for (auto format : graphicsSettings->gBufferFormats)
+			{
+				auto image = new KVulkanImage(this, extent.width, extent.height, format, VK_IMAGE_TILING_OPTIMAL,
+				                              usage, memory);
+				gBufferImages.push_back(image);
+
+				auto view = new KVulkanImageView(this);
+				auto createInfo = defaults.imageViewCreateInfo;
+				createInfo.format = format;
+				createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				gBufferImageViews.push_back(view);
+
+				KError ret = view->Initialize(createInfo, image->image);
+				if (ret != KE_OK) return ret;
+
+				VkDescriptorImageInfo imageInfo = {};
+				imageInfo.imageView = view->imageView;
+				imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+				imageInfos.push_back(imageInfo);
+			}
+
+			// Views change with the swap chain, so the set lives in a pool of its own
+			VkDescriptorPoolSize poolSize = {};
+			poolSize.type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+			poolSize.descriptorCount = static_cast<uint32_t>(imageInfos.size());
+			gBufferDescPool = new KVulkanDescriptorPool(this, { poolSize }, 1);
+
+			std::vector<VkDescriptorType> types(imageInfos.size(), VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT);
+			gBufferDescPool->AllocateImageDescriptors(&gBufferDescriptorLayout, &gBufferDescriptorSet, types,
+			                                          imageInfos);
 
 			return KE_OK;
 		}
@@ -480,12 +949,14 @@ namespace Kitty
 
 			vkDestroyDescriptorSetLayout(device->device, vertexDescriptorLayout, nullptr);
 			vkDestroyDescriptorSetLayout(device->device, fragmentDescriptorLayout, nullptr);
-			vkDestroyDescriptorSetLayout(device->device, vxUniformBufferDescriptorLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device->device, objectDescriptorLayout, nullptr);
 			vkDestroyDescriptorSetLayout(device->device, lightsDescriptorLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device->device, gBufferDescriptorLayout, nullptr);
 			vertexDescriptorLayout = {};
 			fragmentDescriptorLayout = {};
-			vxUniformBufferDescriptorLayout = {};
+			objectDescriptorLayout = {};
 			lightsDescriptorLayout = {};
+			gBufferDescriptorLayout = {};
 		}
 
 		void KVulkan::DestroyCommandPools()
@@ -498,21 +969,69 @@ namespace Kitty
 		{
 			DestroyCommandPools();
 			delete(frameBuffer);
+			DestroyGBuffer();
 			delete(depthImage);
 			delete(depthImageView);
 			delete(mainRenderPass);
+			DestroyPipelines();
+			delete(swapChain);
+		}
+
+		void KVulkan::DestroyGBuffer()
+		{
+			// Destroying the pool frees the set allocated from it
+			delete(gBufferDescPool);
+			gBufferDescPool = nullptr;
+			gBufferDescriptorSet = VK_NULL_HANDLE;
+
+			for (auto view : gBufferImageViews) delete(view);
+			for (auto image : gBufferImages) delete(image);
+
+			gBufferImageViews.clear();
+			gBufferImages.clear();
+		}
+
+		void KVulkan::DestroyPipelines()
+		{
 			delete(mainPipeline);
 			delete(instancePipeline);
-			delete(swapChain);
+			delete(lightingPipeline);
+			delete(depthPipeline);
+			delete(depthInstancePipeline);
+			mainPipeline = nullptr;
+			instancePipeline = nullptr;
+			lightingPipeline = nullptr;
+			depthPipeline = nullptr;
+			depthInstancePipeline = nullptr;
+		}
+
+		void KVulkan::DestroyFrames()
+		{
+			for (auto &frame : frames)
+			{
+				// Destroying the pool frees its command buffer too
+				vkDestroyCommandPool(device->device, frame.commandPool, nullptr);
+				vkDestroyFence(device->device, frame.inFlightFence, nullptr);
+				vkDestroySemaphore(device->device, frame.renderFinishedSemaphore, nullptr);
+				vkDestroySemaphore(device->device, frame.imageAvailableSemaphore, nullptr);
+			}
+
+			frames.clear();
 		}
 
 		KVulkan::~KVulkan()
 		{
-			vkDestroySemaphore(device->device, renderFinishedSemaphore, nullptr);
-			vkDestroySemaphore(device->device, imageAvailableSemaphore, nullptr);
+			FinishDrawing();
+			DestroyFrames();
 
 			DestroyDescriptorPool();
 			DestroySwapChain();
+
+			SavePipelineCache();
+			vkDestroyPipelineCache(device->device, pipelineCache, nullptr);
+
+			delete (recorder);
+			delete (transfer);
 			delete (device);
 
 			vkDestroySurfaceKHR(instance, surface, nullptr);
@@ -71,9 +71,12 @@ namespace Kitty
 				throw std::runtime_error(WhatWentWrong(KE_VULKAN_BUFFER_TOO_SMALL));
 			}
 
-			VkCommandBuffer commandBuffer = context->transferCmdPool->InitiateCommand();
-			vkCmdCopyBuffer(commandBuffer, srcBuffer->buffer, buffer, 1, &copyRegion);
-			context->transferCmdPool->FinalizeCommand(commandBuffer, context->device->transferQueue);
+			context->transfer->Wait(context->transfer->CopyBuffer(srcBuffer, this, copyRegion));
+		}
+
+		uint64_t KVulkanBuffer::Upload(const void *data, VkDeviceSize dataSize, VkDeviceSize offset)
+		{
+			return context->transfer->UploadBuffer(this, data, dataSize, offset);
 		}
 
 		uint32_t KVulkanBuffer::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
@@ -24,58 +24,187 @@ namespace Kitty
 				return KE_VULKAN_CMDBUFFERS_FAIL;
 			}
 
+			commandSettings = settings;
+
+			// Everything is being recorded from scratch, the old secondary buffers can be reused
+			context->recorder->Reset();
+			secondaryBuffers.assign(commandBuffers.size(), {});
+			dirtyBatches.assign(commandBuffers.size(), {});
+			stalePrimaries.assign(commandBuffers.size(), false);
+
 			for (size_t i = 0; i < commandBuffers.size(); i++)
 			{
-				auto cmdBufferBegin = defaults.ObtainValues(&settings->graphicsCmdBufferInfo,
-				                                            &defaults.graphicsCmdBufferInfo);
+				auto imageIndex = static_cast<uint32_t>(i);
+
+				if (settings->sceneBatchRenderCallback != nullptr && settings->sceneBatchCount != nullptr &&
+				    settings->graphicsCmdPoolOverride == nullptr)
+				{
+					// Batches are recorded into secondary buffers in parallel
+					uint32_t batches = settings->sceneBatchCount(context->recorder->GetThreadCount());
+
+					secondaryBuffers[i] = context->recorder->Record(batches, context->mainRenderPass->renderPass,
+					                                                context->frameBuffer->swapChainFramebuffers[i],
+					                                                [&](VkCommandBuffer buf, uint32_t batch) {
+						settings->sceneBatchRenderCallback(buf, imageIndex, batch);
+					});
+				}
+
+				RecordGraphicsBuffer(imageIndex);
+			}
+
+			return KE_OK;
+		}
+
+		void KVulkanCommandPool::RecordGraphicsBuffer(uint32_t imageIndex)
+		{
+			KVulkanCommandSettings *settings = commandSettings;
+			VkCommandBuffer buf = commandBuffers[imageIndex];
+
+			auto cmdBufferBegin = defaults.ObtainValues(&settings->graphicsCmdBufferInfo,
+			                                            &defaults.graphicsCmdBufferInfo);
+
+			renderPassBeginInfo = defaults.ObtainValues(&settings->renderPassInfo, &defaults.renderPassInfo);
+
+			// Allow users to override the entire command pool
+			if (settings->graphicsCmdPoolOverride != nullptr)
+			{
+				settings->graphicsCmdPoolOverride(buf,
+				                                  context->mainPipeline->graphicsPipeline,
+				                                  context->mainRenderPass->renderPass,
+				                                  context->frameBuffer->swapChainFramebuffers[imageIndex],
+				                                  context->swapChain->swapChainExtent);
+				return;
+			}
+
+			vkBeginCommandBuffer(buf, &cmdBufferBegin);
+
+			if (!renderPassBeginInfo.renderPass)
+			{
+				renderPassBeginInfo.renderPass = context->mainRenderPass->renderPass;
+			}
+
+			if (!renderPassBeginInfo.framebuffer)
+			{
+				renderPassBeginInfo.framebuffer = context->frameBuffer->swapChainFramebuffers[imageIndex];
+			}
+
+			if (!renderPassBeginInfo.renderArea.extent.height && !renderPassBeginInfo.renderArea.extent.width)
+			{
+				renderPassBeginInfo.renderArea.extent = context->swapChain->swapChainExtent;
+			}
 
-				renderPassBeginInfo = defaults.ObtainValues(&settings->renderPassInfo, &defaults.renderPassInfo);
+			bool deferred = context->graphicsSettings->deferredShading;
+			std::vector<VkClearValue> clearValues;
+
+			// The G-buffer attachments are cleared to zero unless told otherwise
+			auto attachmentCount = static_cast<uint32_t>(2 + context->graphicsSettings->gBufferFormats.size());
+			if (deferred && renderPassBeginInfo.clearValueCount < attachmentCount)
+			{
+				clearValues.assign(renderPassBeginInfo.pClearValues,
+				                   renderPassBeginInfo.pClearValues + renderPassBeginInfo.clearValueCount);
+				clearValues.resize(attachmentCount, VkClearValue{});
 
-				// Allow users to override the entire command pool
-				if (settings->graphicsCmdPoolOverride != nullptr)
+				renderPassBeginInfo.clearValueCount = attachmentCount;
+				renderPassBeginInfo.pClearValues = clearValues.data();
+			}
+
+			if (settings->sceneBatchRenderCallback != nullptr && settings->sceneBatchCount != nullptr)
+			{
+				auto &secondary = secondaryBuffers[imageIndex];
+
+				vkCmdBeginRenderPass(buf, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+				if (!secondary.empty())
 				{
-					settings->graphicsCmdPoolOverride(commandBuffers[i],
-					                             context->mainPipeline->graphicsPipeline,
-					                             context->mainRenderPass->renderPass,
-					                             context->frameBuffer->swapChainFramebuffers[i],
-					                             context->swapChain->swapChainExtent);
+					vkCmdExecuteCommands(buf, static_cast<uint32_t>(secondary.size()), secondary.data());
 				}
-				else
+			}
+			else
+			{
+				vkCmdBeginRenderPass(buf, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+				context->SetDynamicState(buf);
+
+				if (settings->sceneStaticRenderCallback != nullptr)
 				{
-					vkBeginCommandBuffer(commandBuffers[i], &cmdBufferBegin);
+					settings->sceneStaticRenderCallback(buf, imageIndex);
+				}
+			}
 
-					if (!renderPassBeginInfo.renderPass)
-					{
-						renderPassBeginInfo.renderPass = context->mainRenderPass->renderPass;
-					}
+			// Everything above only filled the G-buffer, light it in a single draw
+			if (deferred)
+			{
+				vkCmdNextSubpass(buf, VK_SUBPASS_CONTENTS_INLINE);
+				context->SetDynamicState(buf);
 
-					if (!renderPassBeginInfo.framebuffer)
-					{
-						renderPassBeginInfo.framebuffer = context->frameBuffer->swapChainFramebuffers[i];
-					}
+				if (settings->sceneLightingRenderCallback != nullptr)
+				{
+					settings->sceneLightingRenderCallback(buf, imageIndex);
+				}
+			}
 
-					if (!renderPassBeginInfo.renderArea.extent.height && !renderPassBeginInfo.renderArea.extent.width)
-					{
-						renderPassBeginInfo.renderArea.extent = context->swapChain->swapChainExtent;
-					}
+			vkCmdEndRenderPass(buf);
 
-					vkCmdBeginRenderPass(commandBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+			if (vkEndCommandBuffer(buf) != VK_SUCCESS)
+			{
+				throw std::runtime_error(WhatWentWrong(KE_VULKAN_CMDBUFFERS_FAIL));
+			}
+		}
 
-					if (settings->sceneStaticRenderCallback != nullptr)
-					{
-						settings->sceneStaticRenderCallback(commandBuffers[i]);
-					}
+		void KVulkanCommandPool::InvalidateBatch(uint32_t batch)
+		{
+			for (size_t i = 0; i < dirtyBatches.size(); i++)
+			{
+				// Batches which don't exist yet get recorded when the pool is next initialized
+				if (batch >= secondaryBuffers[i].size()) continue;
 
-					vkCmdEndRenderPass(commandBuffers[i]);
+				auto &dirty = dirtyBatches[i];
+				if (std::find(dirty.begin(), dirty.end(), batch) == dirty.end()) dirty.push_back(batch);
+			}
+		}
+
+		void KVulkanCommandPool::InvalidateAllBatches()
+		{
+			for (size_t i = 0; i < dirtyBatches.size(); i++)
+			{
+				auto &dirty = dirtyBatches[i];
+				dirty.resize(secondaryBuffers[i].size());
 
-					if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS)
-					{
-						throw std::runtime_error(WhatWentWrong(KE_VULKAN_CMDBUFFERS_FAIL));
-					}
+				for (size_t batch = 0; batch < dirty.size(); batch++)
+				{
+					dirty[batch] = static_cast<uint32_t>(batch);
 				}
+
+				stalePrimaries[i] = true;
 			}
+		}
 
-			return KE_OK;
+		void KVulkanCommandPool::UpdateGraphicsBuffer(uint32_t imageIndex)
+		{
+			if (imageIndex >= dirtyBatches.size()) return;
+			if (dirtyBatches[imageIndex].empty() && !stalePrimaries[imageIndex]) return;
+
+			auto &dirty = dirtyBatches[imageIndex];
+			auto &secondary = secondaryBuffers[imageIndex];
+			KVulkanCommandSettings *settings = commandSettings;
+
+			auto fresh = context->recorder->Record(static_cast<uint32_t>(dirty.size()),
+			                                       context->mainRenderPass->renderPass,
+			                                       context->frameBuffer->swapChainFramebuffers[imageIndex],
+			                                       [&](VkCommandBuffer buf, uint32_t i) {
+				settings->sceneBatchRenderCallback(buf, imageIndex, dirty[i]);
+			});
+
+			for (size_t i = 0; i < dirty.size(); i++)
+			{
+				context->recorder->Release(secondary[dirty[i]]);
+				secondary[dirty[i]] = fresh[i];
+			}
+
+			dirty.clear();
+			stalePrimaries[imageIndex] = false;
+
+			// The primary buffer was invalidated along with the secondary buffers it executes
+			RecordGraphicsBuffer(imageIndex);
 		}
 
 		KError KVulkanCommandPool::InitializeTransferBuffer(KVulkanCommandSettings *settings)
@@ -90,6 +219,13 @@ namespace Kitty
 
 		bool KVulkanCommandPool::CreateCommandBuffers(VkCommandBufferAllocateInfo *allocInfo)
 		{
+			// The swap chain may have been recreated with a different number of images
+			if (!commandBuffers.empty())
+			{
+				vkFreeCommandBuffers(context->device->device, commandPool, static_cast<uint32_t >(commandBuffers.size()),
+				                     commandBuffers.data());
+			}
+
 			commandBuffers.resize(context->frameBuffer->swapChainFramebuffers.size());
 
 			auto allocationInfo = defaults.ObtainValues(allocInfo, &defaults.bufferAllocationInfo);
@@ -130,16 +266,31 @@ namespace Kitty
 			submitInfo.commandBufferCount = 1;
 			submitInfo.pCommandBuffers = &commandBuffer;
 
-			vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
-			vkQueueWaitIdle(queue);
+			VkFenceCreateInfo fenceInfo = {};
+			fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+			VkFence fence = VK_NULL_HANDLE;
+			if (vkCreateFence(context->device->device, &fenceInfo, nullptr, &fence) != VK_SUCCESS)
+			{
+				throw std::runtime_error(WhatWentWrong(KE_VULKAN_FENCE_FAIL));
+			}
+
+			// Only wait for this command buffer, not everything else which happens to be on the queue
+			vkQueueSubmit(queue, 1, &submitInfo, fence);
+			vkWaitForFences(context->device->device, 1, &fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+			vkDestroyFence(context->device->device, fence, nullptr);
 
 			vkFreeCommandBuffers(context->device->device, commandPool, 1, &commandBuffer);
 		}
 
 		KVulkanCommandPool::~KVulkanCommandPool()
 		{
-			vkFreeCommandBuffers(context->device->device, commandPool, static_cast<uint32_t >(commandBuffers.size()),
-			                     commandBuffers.data());
+			if (!commandBuffers.empty())
+			{
+				vkFreeCommandBuffers(context->device->device, commandPool, static_cast<uint32_t >(commandBuffers.size()),
+				                     commandBuffers.data());
+			}
+
 			vkDestroyCommandPool(context->device->device, commandPool, nullptr);
 		}
 
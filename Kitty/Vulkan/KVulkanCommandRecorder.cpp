@@ -0,0 +1,269 @@
+/**
+ * Kitty engine Vulkan implementation
+ * KVulkanCommandRecorder.cpp
+ *
+ * Multithreaded command recorder for the Kitty graphics engine. Work
+ * is split into batches which are recorded into secondary command
+ * buffers by a set of worker threads, each with its own command pool.
+ * This functions as an abstraction layer between Vulkan and the Kitty
+ * engine, direct access from the end user interface should never
+ * happen.
+ *
+ * \author Krista Koivisto
+ * \copyright Read included LICENSE file.
+ */
+
+#include "../include/Vulkan/KVulkanCommandRecorder.h"
+
+namespace Kitty
+{
+	namespace Vulkan
+	{
+		KVulkanCommandRecorder::KVulkanCommandRecorder(KVulkan *mainContext, uint32_t threadCount)
+		{
+			context = mainContext;
+			device = context->device->device;
+			nextBatch = 0;
+
+			if (threadCount == 0) threadCount = std::thread::hardware_concurrency();
+			if (threadCount == 0) threadCount = 1;
+
+			VkCommandPoolCreateInfo poolInfo = {};
+			poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+			poolInfo.queueFamilyIndex = context->device->features.graphicsFamily;
+
+			for (uint32_t i = 0; i < threadCount; ++i)
+			{
+				auto worker = new KRecordWorker();
+
+				if (vkCreateCommandPool(device, &poolInfo, nullptr, &worker->commandPool) != VK_SUCCESS)
+				{
+					delete(worker);
+					throw std::runtime_error(WhatWentWrong(KE_VULKAN_CMDPOOL_FAIL));
+				}
+
+				workers.push_back(worker);
+			}
+
+			for (auto worker : workers)
+			{
+				worker->thread = std::thread(&KVulkanCommandRecorder::WorkerLoop, this, worker);
+			}
+		}
+
+		std::vector<VkCommandBuffer> KVulkanCommandRecorder::Record(uint32_t count, VkRenderPass renderPass,
+		                                                            VkFramebuffer framebuffer,
+		                                                            std::function<void(VkCommandBuffer buf,
+		                                                                               uint32_t batch)> callback)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			std::vector<VkCommandBuffer> results(count, VK_NULL_HANDLE);
+
+			if (count > 0)
+			{
+				std::unique_lock<std::mutex> lock(jobMutex);
+
+				jobInheritance = {};
+				jobInheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+				jobInheritance.renderPass = renderPass;
+				jobInheritance.subpass = 0;
+				jobInheritance.framebuffer = framebuffer;
+
+				jobCallback = std::move(callback);
+				jobResults = &results;
+
+				Dispatch(lock, count);
+			}
+
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+			lastRecordTime = elapsed.count();
+
+			return results;
+		}
+
+		void KVulkanCommandRecorder::Run(uint32_t count, std::function<void(uint32_t job)> callback)
+		{
+			if (count == 0) return;
+
+			// A single job isn't worth waking anyone up for
+			if (count == 1)
+			{
+				callback(0);
+				return;
+			}
+
+			std::unique_lock<std::mutex> lock(jobMutex);
+
+			jobTask = std::move(callback);
+			Dispatch(lock, count);
+		}
+
+		void KVulkanCommandRecorder::Dispatch(std::unique_lock<std::mutex> &lock, uint32_t count)
+		{
+			jobError = nullptr;
+			batchCount = count;
+			nextBatch = 0;
+			workersBusy = static_cast<uint32_t>(workers.size());
+			++jobGeneration;
+
+			jobReady.notify_all();
+			jobDone.wait(lock, [this] { return workersBusy == 0; });
+
+			jobCallback = nullptr;
+			jobTask = nullptr;
+			jobResults = nullptr;
+
+			if (jobError != nullptr) std::rethrow_exception(jobError);
+		}
+
+		void KVulkanCommandRecorder::Reset()
+		{
+			// Workers are idle between jobs, so their pools are safe to touch from here
+			std::lock_guard<std::mutex> lock(jobMutex);
+
+			for (auto worker : workers)
+			{
+				vkResetCommandPool(device, worker->commandPool, 0);
+				worker->freeBuffers = worker->commandBuffers;
+			}
+		}
+
+		void KVulkanCommandRecorder::Release(VkCommandBuffer buf)
+		{
+			std::lock_guard<std::mutex> lock(jobMutex);
+
+			auto owner = owners.find(buf);
+			if (owner == owners.end()) return;
+
+			// Buffers are begun again before reuse, which resets them implicitly
+			owner->second->freeBuffers.push_back(buf);
+		}
+
+		void KVulkanCommandRecorder::WorkerLoop(KRecordWorker *worker)
+		{
+			uint64_t seenGeneration = 0;
+
+			while (true)
+			{
+				{
+					std::unique_lock<std::mutex> lock(jobMutex);
+					jobReady.wait(lock, [&] { return stopping || jobGeneration != seenGeneration; });
+
+					if (stopping) return;
+					seenGeneration = jobGeneration;
+				}
+
+				if (jobTask != nullptr) RunJobs();
+				else RecordBatches(worker);
+
+				std::lock_guard<std::mutex> lock(jobMutex);
+				if (--workersBusy == 0) jobDone.notify_one();
+			}
+		}
+
+		void KVulkanCommandRecorder::RecordBatches(KRecordWorker *worker)
+		{
+			VkCommandBufferBeginInfo beginInfo = {};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+			beginInfo.pInheritanceInfo = &jobInheritance;
+
+			try
+			{
+				for (uint32_t batch = nextBatch++; batch < batchCount; batch = nextBatch++)
+				{
+					VkCommandBuffer buf = GetCommandBuffer(worker);
+					vkBeginCommandBuffer(buf, &beginInfo);
+
+					// Dynamic state isn't inherited from the primary buffer
+					context->SetDynamicState(buf);
+					jobCallback(buf, batch);
+
+					if (vkEndCommandBuffer(buf) != VK_SUCCESS)
+					{
+						throw std::runtime_error(WhatWentWrong(KE_VULKAN_CMDBUFFERS_FAIL));
+					}
+
+					(*jobResults)[batch] = buf;
+				}
+			}
+			catch (...)
+			{
+				// Stop handing out batches and let the calling thread deal with the error
+				nextBatch = batchCount;
+
+				std::lock_guard<std::mutex> lock(jobMutex);
+				if (jobError == nullptr) jobError = std::current_exception();
+			}
+		}
+
+		void KVulkanCommandRecorder::RunJobs()
+		{
+			try
+			{
+				for (uint32_t job = nextBatch++; job < batchCount; job = nextBatch++)
+				{
+					jobTask(job);
+				}
+			}
+			catch (...)
+			{
+				nextBatch = batchCount;
+
+				std::lock_guard<std::mutex> lock(jobMutex);
+				if (jobError == nullptr) jobError = std::current_exception();
+			}
+		}
+
+		VkCommandBuffer KVulkanCommandRecorder::GetCommandBuffer(KRecordWorker *worker)
+		{
+			if (worker->freeBuffers.empty())
+			{
+				VkCommandBufferAllocateInfo allocInfo = {};
+				allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+				allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+				allocInfo.commandPool = worker->commandPool;
+				allocInfo.commandBufferCount = 1;
+
+				VkCommandBuffer buf = VK_NULL_HANDLE;
+				if (vkAllocateCommandBuffers(device, &allocInfo, &buf) != VK_SUCCESS)
+				{
+					throw std::runtime_error(WhatWentWrong(KE_VULKAN_CMDBUFFERS_FAIL));
+				}
+
+				worker->commandBuffers.push_back(buf);
+				worker->freeBuffers.push_back(buf);
+
+				std::lock_guard<std::mutex> lock(jobMutex);
+				owners[buf] = worker;
+			}
+
+			VkCommandBuffer buf = worker->freeBuffers.back();
+			worker->freeBuffers.pop_back();
+
+			return buf;
+		}
+
+		KVulkanCommandRecorder::~KVulkanCommandRecorder()
+		{
+			{
+				std::lock_guard<std::mutex> lock(jobMutex);
+				stopping = true;
+			}
+
+			jobReady.notify_all();
+
+			for (auto worker : workers)
+			{
+				worker->thread.join();
+
+				// Destroying the pool frees its command buffers as well
+				vkDestroyCommandPool(device, worker->commandPool, nullptr);
+				delete(worker);
+			}
+
+			workers.clear();
+		}
+	}
+}
@@ -0,0 +1,149 @@
+/**
+ * Kitty engine Vulkan implementation
+ * KVulkanComputePipeline.cpp
+ *
+ * Vulkan compute pipeline implementation for the Kitty graphics
+ * engine. Each pipeline runs a single compute shader whose set 0
+ * bindings are described on creation, and owns a small descriptor
+ * pool for the sets it is dispatched with. This functions as an
+ * abstraction layer between Vulkan and the Kitty engine, direct
+ * access from the end user interface should never happen.
+ *
+ * \author Krista Koivisto
+ * \copyright Read included LICENSE file.
+ */
+
+#include "../include/Vulkan/KVulkanComputePipeline.h"
+
+namespace Kitty
+{
+	namespace Vulkan
+	{
+		KError KVulkanComputePipeline::Initialize(const std::string &shader,
+		                                          const std::vector<VkDescriptorType> &bindings,
+		                                          uint32_t pushSize, uint32_t maxSets)
+		{
+			VkDevice device = context->device->device;
+
+			bindingTypes = bindings;
+			pushConstantSize = pushSize;
+
+			// Pool sized to fit maxSets sets of this pipeline's bindings
+			std::vector<VkDescriptorPoolSize> poolSizes;
+			std::vector<VkDescriptorSetLayoutBinding> layoutBindings;
+
+			for (uint32_t i = 0; i < bindings.size(); ++i)
+			{
+				VkDescriptorSetLayoutBinding binding = {};
+				binding.binding = i;
+				binding.descriptorType = bindings[i];
+				binding.descriptorCount = 1;
+				binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+				layoutBindings.push_back(binding);
+
+				VkDescriptorPoolSize size = {};
+				size.type = bindings[i];
+				size.descriptorCount = maxSets;
+				poolSizes.push_back(size);
+			}
+
+			descPool = new KVulkanDescriptorPool(context, poolSizes, maxSets);
+
+			if (!descPool->InitializeBindings(layoutBindings, &descriptorLayout))
+			{
+				return KE_VULKAN_DESC_SET_LAYOUT_FAIL;
+			}
+
+			VkPushConstantRange pushConstantRange = {};
+			pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			pushConstantRange.offset = 0;
+			pushConstantRange.size = pushConstantSize;
+
+			VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+			pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+			pipelineLayoutInfo.setLayoutCount = 1;
+			pipelineLayoutInfo.pSetLayouts = &descriptorLayout;
+
+			if (pushConstantSize)
+			{
+				pipelineLayoutInfo.pushConstantRangeCount = 1;
+				pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+			}
+
+			if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+			{
+				return KE_VULKAN_CPIPELINE_FAIL;
+			}
+
+			KHelper helper;
+			auto code = helper.ReadBinaryFile(shader);
+			if (code.empty()) return KE_VULKAN_SHADER_FAIL;
+
+			VkShaderModuleCreateInfo moduleInfo = {};
+			moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+			moduleInfo.codeSize = code.size();
+			moduleInfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
+
+			VkShaderModule module = VK_NULL_HANDLE;
+			if (vkCreateShaderModule(device, &moduleInfo, nullptr, &module) != VK_SUCCESS)
+			{
+				return KE_VULKAN_SHADER_FAIL;
+			}
+
+			VkComputePipelineCreateInfo pipelineInfo = {};
+			pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+			pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+			pipelineInfo.stage.module = module;
+			pipelineInfo.stage.pName = "main";
+			pipelineInfo.layout = pipelineLayout;
+
+			VkResult result = vkCreateComputePipelines(device, context->pipelineCache, 1, &pipelineInfo, nullptr,
+			                                           &computePipeline);
+
+			// No longer needed
+			vkDestroyShaderModule(device, module, nullptr);
+
+			return (result == VK_SUCCESS) ? KE_OK : KE_VULKAN_CPIPELINE_FAIL;
+		}
+
+		VkDescriptorSet KVulkanComputePipeline::CreateDescriptorSet(const std::vector<VkDescriptorBufferInfo> &buffers)
+		{
+			if (buffers.size() != bindingTypes.size())
+			{
+				throw std::runtime_error(WhatWentWrong(KE_VULKAN_DESC_SET_FAIL));
+			}
+
+			VkDescriptorSet set = VK_NULL_HANDLE;
+			descPool->AllocateBufferDescriptors(&descriptorLayout, &set, bindingTypes, buffers);
+
+			return set;
+		}
+
+		void KVulkanComputePipeline::Dispatch(VkCommandBuffer buf, VkDescriptorSet set, uint32_t groupsX,
+		                                      uint32_t groupsY, uint32_t groupsZ, const void *pushData)
+		{
+			vkCmdBindPipeline(buf, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+			vkCmdBindDescriptorSets(buf, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &set, 0, nullptr);
+
+			if (pushData != nullptr && pushConstantSize)
+			{
+				vkCmdPushConstants(buf, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, pushConstantSize, pushData);
+			}
+
+			vkCmdDispatch(buf, groupsX, groupsY, groupsZ);
+		}
+
+		KVulkanComputePipeline::~KVulkanComputePipeline()
+		{
+			VkDevice device = context->device->device;
+
+			vkDestroyPipeline(device, computePipeline, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device, descriptorLayout, nullptr);
+
+			// Destroying the pool frees the sets allocated from it
+			delete(descPool);
+		}
+	}
+}
@@ -17,15 +17,17 @@ namespace Kitty
 {
 	namespace Vulkan
 	{
-		KVulkanDescriptorPool::KVulkanDescriptorPool(KVulkan *mainContext, std::vector<VkDescriptorPoolSize> poolSizes)
+		KVulkanDescriptorPool::KVulkanDescriptorPool(KVulkan *mainContext, std::vector<VkDescriptorPoolSize> poolSizes,
+		                                             uint32_t maxSets)
 		{
 			context = mainContext;
 
-			uint32_t maxSets = 0;
-
-			for (auto size : poolSizes)
+			if (maxSets == 0)
 			{
-				maxSets += size.descriptorCount;
+				for (auto size : poolSizes)
+				{
+					maxSets += size.descriptorCount;
+				}
 			}
 
 			VkDescriptorPoolCreateInfo poolInfo = {};
@@ -43,11 +45,18 @@ namespace Kitty
 		bool KVulkanDescriptorPool::InitializeBinding(VkDescriptorSetLayoutBinding *binding,
 		                                                VkDescriptorSetLayout *layout)
 		{
-			// Descriptor set and pipeline layouts
 			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings;
+			setLayoutBindings.push_back(*binding);
+
+			return InitializeBindings(setLayoutBindings, layout);
+		}
+
+		bool KVulkanDescriptorPool::InitializeBindings(const std::vector<VkDescriptorSetLayoutBinding> &setLayoutBindings,
+		                                                 VkDescriptorSetLayout *layout)
+		{
+			// Descriptor set and pipeline layouts
 			VkDescriptorSetLayoutCreateInfo descriptorLayout = {};
 
-			setLayoutBindings.push_back(*binding);
 			descriptorLayout.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
 			descriptorLayout.pBindings = setLayoutBindings.data();
 			descriptorLayout.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
@@ -95,6 +104,90 @@ namespace Kitty
 			                       writeDescriptorSets.data(), 0, nullptr);
 		}
 
+		void KVulkanDescriptorPool::AllocateBufferDescriptors(VkDescriptorSetLayout *layout,
+		                                                      VkDescriptorSet *descriptorSet,
+		                                                      const std::vector<VkDescriptorType> &types,
+		                                                      const std::vector<VkDescriptorBufferInfo> &bufferInfos)
+		{
+			VkDescriptorSetLayout descLayout[] = {*layout};
+			VkDescriptorSetAllocateInfo allocInfo = {};
+			allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+			allocInfo.descriptorPool = descriptorPool;
+			allocInfo.descriptorSetCount = 1;
+			allocInfo.pSetLayouts = descLayout;
+
+			if (vkAllocateDescriptorSets(context->device->device, &allocInfo, descriptorSet) != VK_SUCCESS)
+			{
+				throw std::runtime_error(WhatWentWrong(KE_VULKAN_DESC_SET_FAIL));
+			}
+
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+
+			for (uint32_t i = 0; i < types.size() && i < bufferInfos.size(); ++i)
+			{
+				VkWriteDescriptorSet descriptorWrite = {};
+				descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				descriptorWrite.dstSet = *descriptorSet;
+				descriptorWrite.dstBinding = i;
+				descriptorWrite.descriptorType = types[i];
+				descriptorWrite.descriptorCount = 1;
+				descriptorWrite.pBufferInfo = &bufferInfos[i];
+				writeDescriptorSets.push_back(descriptorWrite);
+			}
+
+			vkUpdateDescriptorSets(context->device->device, static_cast<uint32_t>(writeDescriptorSets.size()),
+			                       writeDescriptorSets.data(), 0, nullptr);
+		}
+
+		void KVulkanDescriptorPool::UpdateBufferDescriptor(VkDescriptorSet descriptorSet, VkDescriptorType type,
+		                                                   uint32_t binding, const VkDescriptorBufferInfo &bufferInfo)
+		{
+			VkWriteDescriptorSet descriptorWrite = {};
+			descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrite.dstSet = descriptorSet;
+			descriptorWrite.dstBinding = binding;
+			descriptorWrite.descriptorType = type;
+			descriptorWrite.descriptorCount = 1;
+			descriptorWrite.pBufferInfo = &bufferInfo;
+
+			vkUpdateDescriptorSets(context->device->device, 1, &descriptorWrite, 0, nullptr);
+		}
+
+		void KVulkanDescriptorPool::AllocateImageDescriptors(VkDescriptorSetLayout *layout,
+		                                                     VkDescriptorSet *descriptorSet,
+		                                                     const std::vector<VkDescriptorType> &types,
+		                                                     const std::vector<VkDescriptorImageInfo> &imageInfos)
+		{
+			VkDescriptorSetLayout descLayout[] = {*layout};
+			VkDescriptorSetAllocateInfo allocInfo = {};
+			allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+			allocInfo.descriptorPool = descriptorPool;
+			allocInfo.descriptorSetCount = 1;
+			allocInfo.pSetLayouts = descLayout;
+
+			if (vkAllocateDescriptorSets(context->device->device, &allocInfo, descriptorSet) != VK_SUCCESS)
+			{
+				throw std::runtime_error(WhatWentWrong(KE_VULKAN_DESC_SET_FAIL));
+			}
+
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+
+			for (uint32_t i = 0; i < types.size() && i < imageInfos.size(); ++i)
+			{
+				VkWriteDescriptorSet descriptorWrite = {};
+				descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				descriptorWrite.dstSet = *descriptorSet;
+				descriptorWrite.dstBinding = i;
+				descriptorWrite.descriptorType = types[i];
+				descriptorWrite.descriptorCount = 1;
+				descriptorWrite.pImageInfo = &imageInfos[i];
+				writeDescriptorSets.push_back(descriptorWrite);
+			}
+
+			vkUpdateDescriptorSets(context->device->device, static_cast<uint32_t>(writeDescriptorSets.size()),
+			                       writeDescriptorSets.data(), 0, nullptr);
+		}
+
 		KVulkanDescriptorPool::~KVulkanDescriptorPool()
 		{
 			vkDestroyDescriptorPool(context->device->device, descriptorPool, nullptr);
@@ -130,6 +130,9 @@ namespace Kitty
 			vkGetPhysicalDeviceMemoryProperties(physicalDevice, &deviceMemory);
 
 			devFeatures.id = deviceProperties.deviceID;
+			devFeatures.vendorId = deviceProperties.vendorID;
+			devFeatures.driverVersion = deviceProperties.driverVersion;
+			memcpy(devFeatures.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE);
 			devFeatures.name = deviceProperties.deviceName;
 			devFeatures.apiVersion = deviceProperties.apiVersion;
 			devFeatures.isDiscrete = (deviceProperties.deviceType & VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
@@ -174,7 +177,9 @@ namespace Kitty
 					VkBool32 presentSupport = 0;
 					vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, context->surface, &presentSupport);
 
-					if (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+					// Compute is dispatched on the graphics queue, so prefer a family which can do both
+					if (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT &&
+					    (devFeatures.graphicsFamily == UINT32_MAX || queueFamilies[i].queueFlags & VK_QUEUE_COMPUTE_BIT))
 					{
 						devFeatures.graphicsFamily = i;
 					}
@@ -26,11 +26,17 @@ namespace Kitty
 
 			for (size_t i = 0; i < swapChainImageViews.size(); i++)
 			{
-				std::array<VkImageView, 2> attachments = {
+				std::vector<VkImageView> attachments = {
 						swapChainImageViews[i]->imageView,
 						context->depthImageView->imageView
 				};
 
+				// Empty unless shading deferred
+				for (auto gBufferView : context->gBufferImageViews)
+				{
+					attachments.push_back(gBufferView->imageView);
+				}
+
 				auto framebufferInfo = defaults.ObtainValues(createInfo, &defaults.framebufferInfo);
 				if (!framebufferInfo.renderPass) framebufferInfo.renderPass = context->mainRenderPass->renderPass;
 				if (!framebufferInfo.width) framebufferInfo.width = swapChainExtent.width;
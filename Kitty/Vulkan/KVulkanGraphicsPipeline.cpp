@@ -154,20 +154,92 @@ namespace Kitty
 			pipelineInfo.pColorBlendState = &colorBlending;
 			pipelineInfo.pDepthStencilState = &depthStencil;
 			pipelineInfo.layout = pipelineLayout;
+			pipelineInfo.flags |= VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT;
 
-			if (info.dynamicState.dynamicStateCount)
+			// Viewport and scissor are dynamic by default so resizing the window doesn't need new pipelines
+			std::array<VkDynamicState, 2> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+			auto dynamicState = info.dynamicState;
+
+			if (dynamicState.dynamicStateCount && !dynamicState.pDynamicStates)
+			{
+				dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+				dynamicState.pDynamicStates = dynamicStates.data();
+			}
+
+			if (dynamicState.dynamicStateCount)
+			{
+				pipelineInfo.pDynamicState = &dynamicState;
+			}
+
+			if (vkCreateGraphicsPipelines(device, context->pipelineCache, 1, &pipelineInfo, nullptr, &graphicsPipeline) !=
+			    VK_SUCCESS)
+			{
+				return false;
+			}
+
+			for (const auto &variant : info.shaderVariants)
 			{
-				pipelineInfo.pDynamicState = &info.dynamicState;
+				if (variants.find(variant.GetKey()) != variants.end()) continue;
+
+				VkPipeline pipeline = VK_NULL_HANDLE;
+				if (!CreateVariant(pipelineInfo, variant, &pipeline)) return false;
+
+				variants[variant.GetKey()] = pipeline;
 			}
 
-			return !(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) !=
-			         VK_SUCCESS);
+			return true;
+		}
+
+		bool KVulkanGraphicsPipeline::CreateVariant(VkGraphicsPipelineCreateInfo pipelineInfo,
+		                                            const KVulkanShaderVariant &variant, VkPipeline *pipeline)
+		{
+			std::array<VkSpecializationMapEntry, 3> entries = {};
+			entries[0].constantID = 0;
+			entries[0].offset = offsetof(KVulkanShaderVariant, lightingModel);
+			entries[0].size = sizeof(variant.lightingModel);
+			entries[1].constantID = 1;
+			entries[1].offset = offsetof(KVulkanShaderVariant, maxLights);
+			entries[1].size = sizeof(variant.maxLights);
+			entries[2].constantID = 2;
+			entries[2].offset = offsetof(KVulkanShaderVariant, hasTexture);
+			entries[2].size = sizeof(variant.hasTexture);
+
+			VkSpecializationInfo specialization = {};
+			specialization.mapEntryCount = static_cast<uint32_t>(entries.size());
+			specialization.pMapEntries = entries.data();
+			specialization.dataSize = sizeof(KVulkanShaderVariant);
+			specialization.pData = &variant;
+
+			std::vector<VkPipelineShaderStageCreateInfo> stages = shaderStages;
+
+			for (auto &stage : stages)
+			{
+				if (stage.stage == VK_SHADER_STAGE_FRAGMENT_BIT) stage.pSpecializationInfo = &specialization;
+			}
+
+			// Variants only differ by their fragment shaders, derive them from the default pipeline
+			pipelineInfo.pStages = stages.data();
+			pipelineInfo.stageCount = static_cast<uint32_t>(stages.size());
+			pipelineInfo.flags = VK_PIPELINE_CREATE_DERIVATIVE_BIT;
+			pipelineInfo.basePipelineHandle = graphicsPipeline;
+			pipelineInfo.basePipelineIndex = -1;
+
+			return vkCreateGraphicsPipelines(context->device->device, context->pipelineCache, 1, &pipelineInfo,
+			                                 nullptr, pipeline) == VK_SUCCESS;
+		}
+
+		VkPipeline KVulkanGraphicsPipeline::GetVariant(const KVulkanShaderVariant &variant)
+		{
+			auto it = variants.find(variant.GetKey());
+
+			return (it != variants.end()) ? it->second : graphicsPipeline;
 		}
 
 		KVulkanGraphicsPipeline::~KVulkanGraphicsPipeline()
 		{
 			VkDevice device = context->device->device;
 
+			for (auto &variant : variants) vkDestroyPipeline(device, variant.second, nullptr);
 			vkDestroyPipeline(device, graphicsPipeline, nullptr);
 			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		}
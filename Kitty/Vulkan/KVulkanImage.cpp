@@ -23,7 +23,7 @@ namespace Kitty
 			context = mainContext;
 			KError ret = Initialize(width, height, format, tiling, usage, properties);
 
-			if (!ret)
+			if (ret != KE_OK)
 			{
 				throw std::runtime_error(WhatWentWrong(ret));
 			}
@@ -33,6 +33,8 @@ namespace Kitty
 		                                VkImageUsageFlags usage, VkMemoryPropertyFlags properties)
 		{
 			VkDevice device = context->device->device;
+			this->format = format;
+
 			VkImageCreateInfo imageInfo = {};
 			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 			imageInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -56,14 +58,31 @@ namespace Kitty
 			VkMemoryRequirements memRequirements = {};
 			vkGetImageMemoryRequirements(device, image, &memRequirements);
 
-			auto temp = new KVulkanBuffer(context, 1, usage, properties);
+			VkPhysicalDeviceMemoryProperties memProperties = {};
+			vkGetPhysicalDeviceMemoryProperties(context->device->pDevice, &memProperties);
+
+			auto FindType = [&](VkMemoryPropertyFlags wanted) {
+				for (uint32_t i = 0; i < memProperties.memoryTypeCount; ++i)
+				{
+					if ((memRequirements.memoryTypeBits & (1 << i)) &&
+					    (memProperties.memoryTypes[i].propertyFlags & wanted) == wanted)
+					{
+						return static_cast<int32_t>(i);
+					}
+				}
+
+				return -1;
+			};
+
+			// Lazily allocated memory is only there on some (mostly tiled) devices, do without it elsewhere
+			int32_t memoryType = FindType(properties);
+			if (memoryType < 0) memoryType = FindType(properties & ~VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+			if (memoryType < 0) return KE_TEXTURE_ALLOC_FAIL;
 
 			VkMemoryAllocateInfo allocInfo = {};
 			allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
 			allocInfo.allocationSize = memRequirements.size;
-			allocInfo.memoryTypeIndex = temp->FindMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-			delete(temp);
+			allocInfo.memoryTypeIndex = static_cast<uint32_t>(memoryType);
 
 			if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS)
 			{
@@ -78,57 +97,71 @@ namespace Kitty
 		void KVulkanImage::TransitionImageLayout(VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout)
 		{
 			VkCommandBuffer commandBuffer = context->cmdPool->InitiateCommand();
+			TransitionImageLayout(commandBuffer, format, oldLayout, newLayout);
+			context->cmdPool->FinalizeCommand(commandBuffer, context->device->graphicsQueue);
+		}
 
+		void KVulkanImage::TransitionImageLayout(VkCommandBuffer commandBuffer, VkFormat format,
+		                                         VkImageLayout oldLayout, VkImageLayout newLayout)
+		{
 			VkImageMemoryBarrier barrier = {};
-			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			barrier.oldLayout = oldLayout;
-			barrier.newLayout = newLayout;
+			VkPipelineStageFlags sourceStage = {};
+			VkPipelineStageFlags destinationStage = {};
+
+			GetTransitionBarrier(format, oldLayout, newLayout, &barrier, &sourceStage, &destinationStage);
+			vkCmdPipelineBarrier(commandBuffer, sourceStage, destinationStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		}
+
+		void KVulkanImage::GetTransitionBarrier(VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout,
+		                                        VkImageMemoryBarrier *barrier, VkPipelineStageFlags *srcStage,
+		                                        VkPipelineStageFlags *dstStage)
+		{
+			*barrier = {};
+			barrier->sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier->oldLayout = oldLayout;
+			barrier->newLayout = newLayout;
 
-			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier->srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier->dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 
-			barrier.image = image;
-			barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			barrier.subresourceRange.baseMipLevel = 0;
-			barrier.subresourceRange.levelCount = 1;
-			barrier.subresourceRange.baseArrayLayer = 0;
-			barrier.subresourceRange.layerCount = 1;
+			barrier->image = image;
+			barrier->subresourceRange.baseMipLevel = 0;
+			barrier->subresourceRange.levelCount = 1;
+			barrier->subresourceRange.baseArrayLayer = 0;
+			barrier->subresourceRange.layerCount = 1;
 
 			// Is this a depth buffer?
 			if (newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL)
 			{
-				barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+				barrier->subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
 
 				// Check if depth buffering can have a stencil bit set
 				if (format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT)
 				{
-					barrier.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+					barrier->subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
 				}
 			}
 			else
 			{
-				barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				barrier->subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 			}
 
-			VkPipelineStageFlags sourceStage = {};
-			VkPipelineStageFlags destinationStage = {};
-
 			if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED)
 			{
 				switch (newLayout)
 				{
 					case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
-						barrier.srcAccessMask = 0;
-						barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-						sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-						destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+						barrier->srcAccessMask = 0;
+						barrier->dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+						*srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+						*dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
 						break;
 
 					case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
-						barrier.srcAccessMask = 0;
-						barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-						sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-						destinationStage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+						barrier->srcAccessMask = 0;
+						barrier->dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+						*srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+						*dstStage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
 						break;
 
 					default:
@@ -137,14 +170,15 @@ namespace Kitty
 			}
 			else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
 			{
-				barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-				barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-				sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-				destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+				barrier->srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier->dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+				*srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+				*dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			}
+			else
+			{
+				throw std::runtime_error(WhatWentWrong(KE_UNSUPPORTED_LAYOUT));
 			}
-
-			vkCmdPipelineBarrier(commandBuffer, sourceStage, destinationStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-			context->cmdPool->FinalizeCommand(commandBuffer, context->device->graphicsQueue);
 		}
 
 		KVulkanImage::~KVulkanImage()
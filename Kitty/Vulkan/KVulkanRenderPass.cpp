@@ -35,6 +35,12 @@ namespace Kitty
 
 			auto dependency = defaults.ObtainValues(&info.dependency, &defaults.dependency);
 
+			if (!info.renderPassCreateInfo.pAttachments && context->graphicsSettings->deferredShading)
+			{
+				CreateDeferredRenderPass(colorAttach, depthAttachment, colorAttachRef, depthAttachmentRef, dependency);
+				return;
+			}
+
 			auto subpassDesc = defaults.ObtainValues(&info.subpass, &defaults.subpass);
 			if (!subpassDesc.pColorAttachments)
 			{
@@ -61,6 +67,96 @@ namespace Kitty
 			}
 		}
 
+		void KVulkanRenderPass::CreateDeferredRenderPass(VkAttachmentDescription colorAttach,
+		                                                 VkAttachmentDescription depthAttachment,
+		                                                 VkAttachmentReference colorAttachRef,
+		                                                 VkAttachmentReference depthAttachmentRef,
+		                                                 VkSubpassDependency dependency)
+		{
+			auto &gBufferFormats = context->graphicsSettings->gBufferFormats;
+
+			std::vector<VkAttachmentDescription> attachments = {colorAttach, depthAttachment};
+			std::vector<VkAttachmentReference> gBufferRefs;
+			std::vector<VkAttachmentReference> inputRefs;
+
+			// Depth is read back for reconstructing positions
+			inputRefs.push_back({depthAttachmentRef.attachment, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL});
+
+			for (auto format : gBufferFormats)
+			{
+				// Never leaves the render pass, so nothing needs to be stored
+				VkAttachmentDescription gBufferAttachment = {};
+				gBufferAttachment.format = format;
+				gBufferAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+				gBufferAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+				gBufferAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				gBufferAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+				gBufferAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				gBufferAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+				gBufferAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+				auto index = static_cast<uint32_t>(attachments.size());
+				attachments.push_back(gBufferAttachment);
+				gBufferRefs.push_back({index, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+				inputRefs.push_back({index, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL});
+			}
+
+			std::array<VkSubpassDescription, 2> subpasses = {};
+
+			// Objects fill the G-buffer
+			subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+			subpasses[0].colorAttachmentCount = static_cast<uint32_t>(gBufferRefs.size());
+			subpasses[0].pColorAttachments = gBufferRefs.data();
+			subpasses[0].pDepthStencilAttachment = &depthAttachmentRef;
+
+			// Lighting reads it back one pixel at a time and writes the swap chain image
+			subpasses[1].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+			subpasses[1].inputAttachmentCount = static_cast<uint32_t>(inputRefs.size());
+			subpasses[1].pInputAttachments = inputRefs.data();
+			subpasses[1].colorAttachmentCount = 1;
+			subpasses[1].pColorAttachments = &colorAttachRef;
+
+			std::array<VkSubpassDependency, 3> dependencies = {dependency, dependency, {}};
+
+			// With several frames in flight the previous frame may still be writing the shared depth buffer
+			// and the G-buffer, or reading them back in its lighting subpass, when this frame starts clearing them
+			dependencies[0].srcStageMask |= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+			                                VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+			                                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			dependencies[0].srcAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+			                                 VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+			// The swap chain image is first written by the lighting subpass
+			dependencies[1].dstSubpass = 1;
+			dependencies[1].srcStageMask |= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+			                                VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+			dependencies[1].srcAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+			                                 VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+			dependencies[2].srcSubpass = 0;
+			dependencies[2].dstSubpass = 1;
+			dependencies[2].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+			                               VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+			dependencies[2].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+			                                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+			dependencies[2].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			dependencies[2].dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+			dependencies[2].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+			auto renderPassInfo = defaults.renderPassCreateInfo;
+			renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+			renderPassInfo.pAttachments = attachments.data();
+			renderPassInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+			renderPassInfo.pSubpasses = subpasses.data();
+			renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+			renderPassInfo.pDependencies = dependencies.data();
+
+			if (vkCreateRenderPass(context->device->device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS)
+			{
+				throw std::runtime_error(WhatWentWrong(KE_VULKAN_RENDERPASS_FAIL));
+			}
+		}
+
 		KVulkanRenderPass::~KVulkanRenderPass()
 		{
 			vkDestroyRenderPass(context->device->device, renderPass, nullptr);
@@ -19,7 +19,8 @@ namespace Kitty
 	{
 		KError KVulkanSwapChain::Initialize(VkSurfaceFormatKHR *desiredFormat,
 		                                    VkPresentModeKHR *desiredPresentMode,
-		                                    VkSwapchainCreateInfoKHR *swapChainCreateInfo)
+		                                    VkSwapchainCreateInfoKHR *swapChainCreateInfo,
+		                                    VkSwapchainKHR oldSwapChain)
 		{
 			supportDetails = QuerySwapChainSupport(context->device->pDevice);
 
@@ -62,7 +63,7 @@ namespace Kitty
 			if (!createInfo.imageExtent.height && !createInfo.imageExtent.width) createInfo.imageExtent = extent;
 			if (!createInfo.preTransform) createInfo.preTransform = supportDetails.capabilities.currentTransform;
 			if (!createInfo.presentMode) createInfo.presentMode = presentMode;
-			createInfo.oldSwapchain = VK_NULL_HANDLE;
+			createInfo.oldSwapchain = oldSwapChain;
 
 			std::vector<uint32_t> indices = context->device->GetQueueFamilyIndices();
 			createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
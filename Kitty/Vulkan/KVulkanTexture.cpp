@@ -30,7 +30,6 @@ namespace Kitty
 
 		KError KVulkanTexture::SetImage2D_8R8G8B8A(unsigned char *buffer, uint32_t texWidth, uint32_t texHeight)
 		{
-			VkDevice device = context->device->device;
 			VkDeviceSize imageSize = static_cast<uint64_t>(texWidth) * static_cast<uint64_t>(texHeight) * 4;
 
 			if (!buffer)
@@ -38,17 +37,10 @@ namespace Kitty
 				throw std::runtime_error(WhatWentWrong(KE_TEXTURE_LOAD_FAIL));
 			}
 
-			auto usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-			auto props = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-			auto staging = new Vulkan::KVulkanBuffer(context, imageSize, usage, props);
-
-			void* data;
-			vkMapMemory(device, staging->bufferMemory, 0, imageSize, 0, &data);
-			memcpy(data, buffer, static_cast<size_t>(imageSize));
-			vkUnmapMemory(device, staging->bufferMemory);
-
 			if (image != nullptr)
 			{
+				// The old image may still be receiving its data
+				context->transfer->Wait(uploadTicket);
 				delete(image);
 				image = nullptr;
 			}
@@ -57,20 +49,9 @@ namespace Kitty
 			                         VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
 			                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-			image->TransitionImageLayout(VK_FORMAT_R8G8B8A8_UNORM,
-			                      VK_IMAGE_LAYOUT_UNDEFINED,
-			                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-
-			CopyFromBuffer2D(staging->buffer, image->image,
-			                 static_cast<uint32_t>(texWidth),
-			                 static_cast<uint32_t>(texHeight));
-
-			// Prepare image for shader access
-			image->TransitionImageLayout(VK_FORMAT_R8G8B8A8_UNORM,
-			                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			                      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-			delete(staging);
+			// Staging, copying and layout transitions all end up in the transfer manager's current batch
+			uploadTicket = context->transfer->UploadImage2D(image, buffer, imageSize, texWidth, texHeight,
+			                                                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 			CreateImageView();
 
@@ -79,28 +60,6 @@ namespace Kitty
 			return KE_OK;
 		}
 
-		void KVulkanTexture::CopyFromBuffer2D(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
-		{
-			VkCommandBuffer commandBuffer = context->cmdPool->InitiateCommand();
-
-			VkBufferImageCopy region = {};
-			region.bufferOffset = 0;
-			region.bufferRowLength = 0;
-			region.bufferImageHeight = 0;
-
-			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			region.imageSubresource.mipLevel = 0;
-			region.imageSubresource.baseArrayLayer = 0;
-			region.imageSubresource.layerCount = 1;
-
-			region.imageOffset = {0, 0, 0};
-			region.imageExtent = {width, height, 1};
-
-			vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-			context->cmdPool->FinalizeCommand(commandBuffer, context->device->graphicsQueue);
-		}
-
 		void KVulkanTexture::CreateImageView()
 		{
 			if (textureImageView != nullptr)
@@ -152,6 +111,7 @@ namespace Kitty
 		KVulkanTexture::~KVulkanTexture()
 		{
 			VkDevice device = context->device->device;
+			context->transfer->Wait(uploadTicket);
 			vkDestroyImageView(device, textureImageView, nullptr);
 			vkDestroySampler(device, textureSampler, nullptr);
 			delete(image);
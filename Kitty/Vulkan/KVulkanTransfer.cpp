@@ -0,0 +1,481 @@
+/**
+ * Kitty engine Vulkan implementation
+ * KVulkanTransfer.cpp
+ *
+ * Vulkan transfer manager for the Kitty graphics engine. Uploads are
+ * staged through a persistent ring buffer and recorded into batches
+ * which are submitted to the transfer queue together. This functions
+ * as an abstraction layer between Vulkan and the Kitty engine, direct
+ * access from the end user interface should never happen.
+ *
+ * \author Krista Koivisto
+ * \copyright Read included LICENSE file.
+ */
+
+#include "../include/Vulkan/KVulkanTransfer.h"
+
+namespace Kitty
+{
+	namespace Vulkan
+	{
+		KVulkanTransfer::KVulkanTransfer(KVulkan *mainContext, VkDeviceSize stagingSize)
+		{
+			context = mainContext;
+			device = context->device->device;
+			transferFamily = context->device->features.transferFamily;
+			graphicsFamily = context->device->features.graphicsFamily;
+
+			VkDeviceSize copyAlignment = context->device->features.VkLimits.optimalBufferCopyOffsetAlignment;
+			if (copyAlignment > ringAlignment) ringAlignment = copyAlignment;
+			if (stagingSize < ringAlignment) stagingSize = ringAlignment;
+			stagingSize = (stagingSize + ringAlignment - 1) & ~(ringAlignment - 1);
+
+			stagingRing = new KVulkanBuffer(context, stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			stagingRing->Map();
+
+			// Batches are short lived and their command buffers are reused, let the pools know
+			KVulkanCommandSettings poolSettings = context->settings->commands;
+			poolSettings.poolInfo.flags |= VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+			                               VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+			poolSettings.poolInfo.queueFamilyIndex = transferFamily;
+			transferPool = new KVulkanCommandPool(context, &poolSettings);
+
+			if (NeedsOwnershipTransfer())
+			{
+				poolSettings.poolInfo.queueFamilyIndex = graphicsFamily;
+				acquirePool = new KVulkanCommandPool(context, &poolSettings);
+			}
+		}
+
+		uint64_t KVulkanTransfer::UploadBuffer(KVulkanBuffer *dst, const void *data, VkDeviceSize size,
+		                                       VkDeviceSize dstOffset)
+		{
+			if (size == 0) return completedTicket;
+			if (dstOffset + size > dst->size) throw std::runtime_error(WhatWentWrong(KE_VULKAN_BUFFER_TOO_SMALL));
+
+			VkBuffer srcBuffer = VK_NULL_HANDLE;
+			VkBufferCopy region = {};
+			region.srcOffset = Stage(data, size, &srcBuffer);
+			region.dstOffset = dstOffset;
+			region.size = size;
+
+			KTransferBatch *batch = GetRecordingBatch();
+			vkCmdCopyBuffer(batch->transferCmd, srcBuffer, dst->buffer, 1, &region);
+			batch->hasBufferWrites = true;
+
+			return batch->ticket;
+		}
+
+		uint64_t KVulkanTransfer::UploadImage2D(KVulkanImage *dst, const void *data, VkDeviceSize size,
+		                                        uint32_t width, uint32_t height, VkImageLayout finalLayout)
+		{
+			VkBuffer srcBuffer = VK_NULL_HANDLE;
+			VkDeviceSize srcOffset = Stage(data, size, &srcBuffer);
+			KTransferBatch *batch = GetRecordingBatch();
+
+			VkImageMemoryBarrier barrier = {};
+			VkPipelineStageFlags srcStage = {};
+			VkPipelineStageFlags dstStage = {};
+
+			dst->GetTransitionBarrier(dst->format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			                          &barrier, &srcStage, &dstStage);
+			batch->copyBarriers.push_back(barrier);
+
+			KImageCopy copy = {};
+			copy.srcBuffer = srcBuffer;
+			copy.dstImage = dst->image;
+			copy.region.bufferOffset = srcOffset;
+			copy.region.bufferRowLength = 0;
+			copy.region.bufferImageHeight = 0;
+			copy.region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			copy.region.imageSubresource.mipLevel = 0;
+			copy.region.imageSubresource.baseArrayLayer = 0;
+			copy.region.imageSubresource.layerCount = 1;
+			copy.region.imageOffset = {0, 0, 0};
+			copy.region.imageExtent = {width, height, 1};
+			batch->imageCopies.push_back(copy);
+
+			// The transition to the final layout is recorded for the whole batch at once when flushing
+			dst->GetTransitionBarrier(dst->format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, finalLayout,
+			                          &barrier, &srcStage, &dstStage);
+
+			if (NeedsOwnershipTransfer())
+			{
+				barrier.srcQueueFamilyIndex = transferFamily;
+				barrier.dstQueueFamilyIndex = graphicsFamily;
+			}
+
+			batch->imageBarriers.push_back(barrier);
+
+			return batch->ticket;
+		}
+
+		uint64_t KVulkanTransfer::CopyBuffer(KVulkanBuffer *src, KVulkanBuffer *dst, VkBufferCopy region)
+		{
+			if (!region.size) region.size = src->size;
+			if (region.dstOffset + region.size > dst->size)
+			{
+				throw std::runtime_error(WhatWentWrong(KE_VULKAN_BUFFER_TOO_SMALL));
+			}
+
+			KTransferBatch *batch = GetRecordingBatch();
+			vkCmdCopyBuffer(batch->transferCmd, src->buffer, dst->buffer, 1, &region);
+			batch->hasBufferWrites = true;
+
+			return batch->ticket;
+		}
+
+		void KVulkanTransfer::RecordImageCopies(KTransferBatch *batch)
+		{
+			if (batch->imageCopies.empty()) return;
+
+			vkCmdPipelineBarrier(batch->transferCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			                     0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(batch->copyBarriers.size()),
+			                     batch->copyBarriers.data());
+
+			for (auto &copy : batch->imageCopies)
+			{
+				vkCmdCopyBufferToImage(batch->transferCmd, copy.srcBuffer, copy.dstImage,
+				                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy.region);
+			}
+		}
+
+		uint64_t KVulkanTransfer::Flush()
+		{
+			Collect();
+
+			if (recording == nullptr) return nextTicket - 1;
+
+			KTransferBatch *batch = recording;
+			recording = nullptr;
+
+			RecordImageCopies(batch);
+
+			VkPipelineStageFlags graphicsStages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+			                                      VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+			                                      VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+			VkMemoryBarrier memoryBarrier = {};
+			memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+			                              VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+			uint32_t memoryBarrierCount = batch->hasBufferWrites ? 1 : 0;
+
+			auto imageBarrierCount = static_cast<uint32_t>(batch->imageBarriers.size());
+
+			if (!NeedsOwnershipTransfer())
+			{
+				// Same queue family, a single barrier makes everything visible to the graphics stages
+				vkCmdPipelineBarrier(batch->transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, graphicsStages, 0,
+				                     memoryBarrierCount, &memoryBarrier, 0, nullptr,
+				                     imageBarrierCount, batch->imageBarriers.data());
+			}
+			else if (imageBarrierCount > 0)
+			{
+				// Release images to the graphics queue family (buffers are shared concurrently)
+				std::vector<VkImageMemoryBarrier> release = batch->imageBarriers;
+				for (auto &barrier : release) barrier.dstAccessMask = 0;
+
+				vkCmdPipelineBarrier(batch->transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+				                     VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr,
+				                     imageBarrierCount, release.data());
+			}
+
+			if (vkEndCommandBuffer(batch->transferCmd) != VK_SUCCESS)
+			{
+				throw std::runtime_error(WhatWentWrong(KE_VULKAN_TRANSFER_FAIL));
+			}
+
+			VkSubmitInfo submitInfo = {};
+			submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &batch->transferCmd;
+
+			if (!NeedsOwnershipTransfer())
+			{
+				if (vkQueueSubmit(context->device->transferQueue, 1, &submitInfo, batch->fence) != VK_SUCCESS)
+				{
+					throw std::runtime_error(WhatWentWrong(KE_VULKAN_TRANSFER_FAIL));
+				}
+			}
+			else
+			{
+				submitInfo.signalSemaphoreCount = 1;
+				submitInfo.pSignalSemaphores = &batch->semaphore;
+
+				if (vkQueueSubmit(context->device->transferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+				{
+					throw std::runtime_error(WhatWentWrong(KE_VULKAN_TRANSFER_FAIL));
+				}
+
+				// Acquire on the graphics queue, this also orders later graphics work after the transfer
+				VkCommandBufferBeginInfo beginInfo = {};
+				beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+				beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+				vkBeginCommandBuffer(batch->acquireCmd, &beginInfo);
+
+				for (auto &barrier : batch->imageBarriers) barrier.srcAccessMask = 0;
+				memoryBarrier.srcAccessMask = 0;
+
+				vkCmdPipelineBarrier(batch->acquireCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, graphicsStages, 0,
+				                     memoryBarrierCount, &memoryBarrier, 0, nullptr,
+				                     imageBarrierCount, batch->imageBarriers.data());
+
+				if (vkEndCommandBuffer(batch->acquireCmd) != VK_SUCCESS)
+				{
+					throw std::runtime_error(WhatWentWrong(KE_VULKAN_TRANSFER_FAIL));
+				}
+
+				VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+				VkSubmitInfo acquireInfo = {};
+				acquireInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+				acquireInfo.waitSemaphoreCount = 1;
+				acquireInfo.pWaitSemaphores = &batch->semaphore;
+				acquireInfo.pWaitDstStageMask = &waitStage;
+				acquireInfo.commandBufferCount = 1;
+				acquireInfo.pCommandBuffers = &batch->acquireCmd;
+
+				// The acquire can only finish after the transfer has, so its fence covers both
+				if (vkQueueSubmit(context->device->graphicsQueue, 1, &acquireInfo, batch->fence) != VK_SUCCESS)
+				{
+					throw std::runtime_error(WhatWentWrong(KE_VULKAN_TRANSFER_FAIL));
+				}
+			}
+
+			batch->ringEnd = ringHead;
+			inFlight.push_back(batch);
+
+			return batch->ticket;
+		}
+
+		bool KVulkanTransfer::IsComplete(uint64_t ticket)
+		{
+			Collect();
+			return completedTicket >= ticket;
+		}
+
+		void KVulkanTransfer::Wait(uint64_t ticket)
+		{
+			if (recording != nullptr && ticket >= recording->ticket) Flush();
+
+			while (completedTicket < ticket && !inFlight.empty())
+			{
+				Collect(true);
+			}
+		}
+
+		void KVulkanTransfer::WaitIdle()
+		{
+			Flush();
+
+			while (!inFlight.empty())
+			{
+				Collect(true);
+			}
+		}
+
+		VkDeviceSize KVulkanTransfer::Stage(const void *data, VkDeviceSize size, VkBuffer *srcBuffer)
+		{
+			VkDeviceSize capacity = stagingRing->size;
+
+			// Too big for the ring, this one gets a buffer of its own
+			if (size > capacity)
+			{
+				auto scratch = new KVulkanBuffer(context, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+				                                 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+				scratch->Map();
+				memcpy(scratch->mappedMemory, data, static_cast<size_t>(size));
+				scratch->Unmap();
+
+				GetRecordingBatch()->scratchBuffers.push_back(scratch);
+				*srcBuffer = scratch->buffer;
+
+				return 0;
+			}
+
+			while (true)
+			{
+				uint64_t start = (ringHead + ringAlignment - 1) & ~(ringAlignment - 1);
+				VkDeviceSize position = start % capacity;
+
+				// Never split data across the end of the ring
+				if (position + size > capacity)
+				{
+					start += capacity - position;
+					position = 0;
+				}
+
+				if (start + size - ringTail <= capacity)
+				{
+					ringHead = start + size;
+					memcpy(static_cast<char*>(stagingRing->mappedMemory) + position, data, static_cast<size_t>(size));
+					*srcBuffer = stagingRing->buffer;
+
+					return position;
+				}
+
+				// Out of room, free up space from the oldest batch (submitting ours first if it's all there is)
+				if (!inFlight.empty())
+				{
+					Collect(true);
+				}
+				else if (recording != nullptr)
+				{
+					Flush();
+				}
+				else
+				{
+					// Nothing is using the ring, start over from its beginning
+					ringHead = ((ringHead + capacity - 1) / capacity) * capacity;
+					ringTail = ringHead;
+				}
+			}
+		}
+
+		void KVulkanTransfer::Collect(bool waitForOldest)
+		{
+			while (!inFlight.empty())
+			{
+				KTransferBatch *batch = inFlight.front();
+
+				if (waitForOldest)
+				{
+					vkWaitForFences(device, 1, &batch->fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+					waitForOldest = false;
+				}
+				else if (vkGetFenceStatus(device, batch->fence) != VK_SUCCESS)
+				{
+					break;
+				}
+
+				inFlight.pop_front();
+
+				ringTail = batch->ringEnd;
+				completedTicket = batch->ticket;
+
+				for (auto scratch : batch->scratchBuffers)
+				{
+					delete(scratch);
+				}
+
+				batch->scratchBuffers.clear();
+				batch->copyBarriers.clear();
+				batch->imageCopies.clear();
+				batch->imageBarriers.clear();
+				batch->hasBufferWrites = false;
+				vkResetFences(device, 1, &batch->fence);
+
+				spareBatches.push_back(batch);
+			}
+		}
+
+		KVulkanTransfer::KTransferBatch *KVulkanTransfer::GetRecordingBatch()
+		{
+			if (recording != nullptr) return recording;
+
+			if (!spareBatches.empty())
+			{
+				recording = spareBatches.back();
+				spareBatches.pop_back();
+			}
+			else
+			{
+				recording = CreateBatch();
+			}
+
+			recording->ticket = nextTicket++;
+
+			VkCommandBufferBeginInfo beginInfo = {};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+			if (vkBeginCommandBuffer(recording->transferCmd, &beginInfo) != VK_SUCCESS)
+			{
+				throw std::runtime_error(WhatWentWrong(KE_VULKAN_TRANSFER_FAIL));
+			}
+
+			return recording;
+		}
+
+		KVulkanTransfer::KTransferBatch *KVulkanTransfer::CreateBatch()
+		{
+			auto batch = new KTransferBatch();
+
+			VkCommandBufferAllocateInfo allocInfo = {};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandBufferCount = 1;
+			allocInfo.commandPool = transferPool->commandPool;
+
+			if (vkAllocateCommandBuffers(device, &allocInfo, &batch->transferCmd) != VK_SUCCESS)
+			{
+				throw std::runtime_error(WhatWentWrong(KE_VULKAN_CMDBUFFERS_FAIL));
+			}
+
+			VkFenceCreateInfo fenceInfo = {};
+			fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+			if (vkCreateFence(device, &fenceInfo, nullptr, &batch->fence) != VK_SUCCESS)
+			{
+				throw std::runtime_error(WhatWentWrong(KE_VULKAN_FENCE_FAIL));
+			}
+
+			if (NeedsOwnershipTransfer())
+			{
+				allocInfo.commandPool = acquirePool->commandPool;
+
+				if (vkAllocateCommandBuffers(device, &allocInfo, &batch->acquireCmd) != VK_SUCCESS)
+				{
+					throw std::runtime_error(WhatWentWrong(KE_VULKAN_CMDBUFFERS_FAIL));
+				}
+
+				VkSemaphoreCreateInfo semaphoreInfo = {};
+				semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+				if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &batch->semaphore) != VK_SUCCESS)
+				{
+					throw std::runtime_error(WhatWentWrong(KE_VULKAN_SEMAPHORE_FAIL));
+				}
+			}
+
+			return batch;
+		}
+
+		void KVulkanTransfer::DestroyBatch(KTransferBatch *batch)
+		{
+			for (auto scratch : batch->scratchBuffers)
+			{
+				delete(scratch);
+			}
+
+			vkDestroyFence(device, batch->fence, nullptr);
+			if (batch->semaphore != VK_NULL_HANDLE) vkDestroySemaphore(device, batch->semaphore, nullptr);
+
+			// Command buffers go away with their pools
+			delete(batch);
+		}
+
+		KVulkanTransfer::~KVulkanTransfer()
+		{
+			WaitIdle();
+
+			for (auto batch : spareBatches)
+			{
+				DestroyBatch(batch);
+			}
+
+			spareBatches.clear();
+
+			stagingRing->Unmap();
+			delete(stagingRing);
+
+			delete(acquirePool);
+			delete(transferPool);
+		}
+	}
+}
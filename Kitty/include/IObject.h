@@ -3,7 +3,8 @@
  * IObject.h
  *
  * This class is a generic scene node, it just has a more newbie friendly name because
- * friendly names are nice. :)
+ * friendly names are nice. :) The node's data lives in the scene's entity store, the
+ * node itself only knows which entity is its own.
  *
  * \author Krista Koivisto
  * \copyright Read included LICENSE file.
@@ -14,6 +15,8 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "KHandle.h"
 
 namespace Kitty
 {
@@ -27,23 +30,17 @@ namespace Kitty
 	class IObject
 	{
 	protected:
-		KMesh *mesh = nullptr;
 		KScene *context = nullptr;
-		KMaterial *mat = nullptr;
+		KHandle handle = {};
 
-		glm::vec4 rotation;
-		glm::vec3 position;
-		glm::vec3 scale;
-		glm::mat4 rotationMatrix;
-		glm::mat4 translationMatrix;
-		glm::mat4 scaleMatrix;
-
-		uint32_t instanceCount = 0;
-		uint32_t index = 0;
+		/**
+		 * \brief Rebuild the model matrix after the transform changed and tell the scene.
+		 */
+		void TransformChanged();
 
 	public:
 		IObject() = default;
-		~IObject() = default;
+		virtual ~IObject() = default;
 
 		/**
 		 * \brief Create a new instance of this object.
@@ -57,6 +54,23 @@ namespace Kitty
 		 */
 		virtual KInstancedObject *CreateInstance();
 
+		/**
+		 * \brief Create many instances of this object at once.
+		 *
+		 * Much faster than calling CreateInstance in a loop, the instances are constructed
+		 * in one go into contiguous storage. Any of the transform arrays may be null, in
+		 * which case the instances get the default for it.
+		 *
+		 * \param count Number of instances to create.
+		 * \param positions [optional] Array of count positions.
+		 * \param rotations [optional] Array of count rotations.
+		 * \param scales [optional] Array of count uniform scales.
+		 * \return Pointer to the first instance, the rest follow it in memory.
+		 */
+		virtual KInstancedObject *CreateInstances(uint32_t count, const glm::vec3 *positions = nullptr,
+		                                          const glm::quat *rotations = nullptr,
+		                                          const float *scales = nullptr);
+
 		/**
 		 * \brief Set object position.
 		 *
@@ -101,67 +115,103 @@ namespace Kitty
 		virtual void SetMaterial(KMaterial *material);
 
 		/**
-		 * \brief Set scene object tracker index.
+		 * \brief Mark the object as never moving.
+		 *
+		 * Static objects are baked into combined geometry with the other static objects near
+		 * them using the same material, which saves a draw and an object table entry for each.
+		 * Once baked, changing the object does nothing until the scene is actualized again.
+		 * Objects with instances are never baked.
+		 *
+		 * \param makeStatic Is the object static?
+		 */
+		virtual void SetStatic(bool makeStatic);
+
+		/**
+		 * \brief Stop drawing the object itself.
 		 *
-		 * \param objectIndex Object index in scene object tracker.
+		 * Hidden objects still draw their instances, which makes them templates for their instances.
+		 * Prefabs hide the objects of their parts. Hidden objects are never baked.
+		 *
+		 * \param hide Should the object be hidden?
 		 */
-		virtual void SetIndex(uint32_t objectIndex);
+		virtual void SetHidden(bool hide);
 
 		/**
 		 * \brief Get object mesh data.
 		 *
 		 * \return Mesh object.
 		 */
-		KMesh *GetMesh() { return mesh; }
+		KMesh *GetMesh();
 
 		/**
 		 * \brief Get object material.
 		 *
 		 * \return Pointer to the object's material.
 		 */
-		KMaterial *GetMaterial() { return mat; }
+		KMaterial *GetMaterial();
 
 		/**
 		 * \brief Get object position.
 		 *
 		 * \return Object position.
 		 */
-		glm::vec3 GetPosition() { return position; }
+		glm::vec3 GetPosition();
 
 		/**
 		 * \brief Get object rotation.
 		 *
 		 * \return Object rotation, x, y, z for the axes and w for rotation degrees.
 		 */
-		glm::vec4 GetRotation() { return rotation; }
+		glm::vec4 GetRotation();
 
 		/**
 		 * \brief Get object scale.
 		 *
 		 * \return Object scale.
 		 */
-		glm::vec3 GetScale() { return scale; }
+		glm::vec3 GetScale();
 
 		/**
 		 * \brief Get the object's model matrix.
 		 *
 		 * \return Model matrix.
 		 */
-		glm::mat4 GetModelMatrix() { return translationMatrix * rotationMatrix * scaleMatrix; }
+		glm::mat4 GetModelMatrix();
 
 		/**
 		 * \brief Get the number of instances created by this object.
 		 *
 		 * \return Number of instances of this object.
 		 */
-		uint32_t GetInstanceCount() { return instanceCount; }
+		uint32_t GetInstanceCount();
+
+		/**
+		 * \brief Has the object been marked as never moving?
+		 *
+		 * \return True if the object is static.
+		 */
+		bool IsStatic();
 
 		/**
 		 * \brief Get scene object tracker index.
 		 *
-		 * \return Object index in scene object tracker.
+		 * \return Row of the object in its entity store archetype, the object table index for drawn objects.
+		 */
+		uint32_t GetIndex();
+
+		/**
+		 * \brief Get scene object handle.
+		 *
+		 * \return Handle which stays valid until the object is removed from the scene.
+		 */
+		KHandle GetHandle() { return handle; }
+
+		/**
+		 * \brief Get the scene the object belongs to.
+		 *
+		 * \return Scene the object was created in.
 		 */
-		uint32_t GetIndex() { return index; }
+		KScene *GetScene() { return context; }
 	};
 }
 
@@ -97,6 +97,23 @@ namespace Kitty
 		 */
 		float UpdateFPS(uint32_t fpsUpdateFrequency = 1000);
 
+		/**
+		 * \brief Change the number of threads scene draws are recorded with.
+		 *
+		 * The command buffers are recorded again right away, so GetLastRecordTime can be used to
+		 * see how recording scales with the thread count.
+		 *
+		 * \param threadCount Number of recording threads, 0 to use one per available core.
+		 */
+		void SetRecordingThreads(uint32_t threadCount);
+
+		/**
+		 * \brief Get how long the scene draws took to record the last time they were recorded.
+		 *
+		 * \return Wall clock time in milliseconds.
+		 */
+		double GetLastRecordTime();
+
 	private:
 		Vulkan::KVulkan *vulkan = nullptr;
 
@@ -109,11 +126,15 @@ namespace Kitty
 		uint32_t fpsCounter = 0;
 		float fps = 0;
 
+		bool resizePending = false;
+		std::chrono::high_resolution_clock::time_point lastResize = lastFPSUpdate;
+
 		/**
 		 * \brief Callback target for window interfaces
 		 *
 		 * This is the resize callback all window framework handlers must target. It
-		 * informs Vulkan to update to the new dimensions.
+		 * informs Vulkan to update to the new dimensions once the window has stopped
+		 * changing size for KVulkanSettings::swapChainResizeDelay milliseconds.
 		 *
 		 * \param window Pointer back to window object.
 		 * \param width New width.
@@ -0,0 +1,265 @@
+/**
+ * Kitty Engine
+ * KEntityStore.h
+ *
+ * Archetype based storage for scene objects. Objects with the same set
+ * of components share an archetype, which keeps each component in a
+ * column of its own so systems run over tightly packed arrays instead
+ * of chasing object pointers. Rows are removed by moving the last row
+ * into their place, and entities are found through generational handles
+ * which follow them as they move.
+ *
+ * \author Krista Koivisto
+ * \copyright Read included LICENSE file.
+ */
+
+#ifndef KENGINE_KENTITYSTORE_H
+#define KENGINE_KENTITYSTORE_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <vector>
+#include <cstdint>
+#include "KHandle.h"
+#include "KJobRunner.h"
+
+// Rows handed to a system at a time
+#define KE_ENTITY_CHUNK_SIZE 256
+
+// Entity locations keep the archetype in the top bits and the row in the rest
+#define KE_ENTITY_ROW_BITS 24
+#define KE_ENTITY_ROW_MASK ((1u << KE_ENTITY_ROW_BITS) - 1)
+
+namespace Kitty
+{
+	class KObject;
+	class KMesh;
+	class KMaterial;
+
+	enum KE_COMPONENTS
+	{
+		KC_TRANSFORM = 1 << 0,
+		KC_RENDER = 1 << 1,
+		KC_BOUNDS = 1 << 2,
+		KC_LIGHTS = 1 << 3
+	};
+
+	enum KE_ARCHETYPES
+	{
+		KA_DRAWN, // Drawn on their own, rows are object table indices
+		KA_STATIC, // Baked into static chunks
+		KA_COUNT
+	};
+
+	struct KTransformComponent
+	{
+		glm::vec3 position = glm::vec3(0.0f);
+		glm::vec4 rotation = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f); // x, y, z for the axis and w for degrees
+		glm::vec3 scale = glm::vec3(1.0f);
+		glm::mat4 matrix = glm::mat4(1.0f);
+	};
+
+	struct KRenderComponent
+	{
+		KMesh *mesh = nullptr;
+		KMaterial *material = nullptr;
+		uint32_t instanceCount = 0;
+		bool isStatic = false;
+		bool hidden = false; // Only drawn through its instances
+	};
+
+	struct KLightComponent
+	{
+		glm::uvec4 lights = glm::uvec4(0, 0, 0, 0); // Indices of the lights selected for the object
+		int32_t count = -1; // Number of selected lights, -1 to use the light clusters instead
+	};
+
+	class KArchetype
+	{
+	public:
+		uint32_t components = 0;
+
+		// Chunks are run through this when set, otherwise one after another
+		KJobRunner runner = nullptr;
+
+		// One column per component, unused ones stay empty
+		std::vector<KObject*> owners = {};
+		std::vector<KHandle> entities = {};
+		std::vector<KTransformComponent> transforms = {};
+		std::vector<KRenderComponent> renders = {};
+		std::vector<glm::vec4> bounds = {}; // Model space sphere around the object
+		std::vector<KLightComponent> lights = {};
+
+		/**
+		 * \brief Create an archetype.
+		 *
+		 * \param componentMask Components of the archetype, from KE_COMPONENTS.
+		 */
+		explicit KArchetype(uint32_t componentMask) : components(componentMask) {};
+
+		/**
+		 * \brief Does the archetype have a component?
+		 *
+		 * \param component Component from KE_COMPONENTS.
+		 * \return true if it does, otherwise false.
+		 */
+		bool Has(uint32_t component) { return (components & component) != 0; };
+
+		/**
+		 * \brief Get the number of rows.
+		 *
+		 * \return Number of entities in the archetype.
+		 */
+		uint32_t Size() { return static_cast<uint32_t>(owners.size()); };
+
+		/**
+		 * \brief Add a row with default components.
+		 *
+		 * \param owner Object the row belongs to.
+		 * \param entity Handle of the entity.
+		 * \return Index of the new row.
+		 */
+		uint32_t Add(KObject *owner, KHandle entity);
+
+		/**
+		 * \brief Remove a row, moving the last row into its place.
+		 *
+		 * \param row Row to remove.
+		 */
+		void Remove(uint32_t row);
+
+		/**
+		 * \brief Swap two rows.
+		 *
+		 * \param a First row.
+		 * \param b Second row.
+		 */
+		void Swap(uint32_t a, uint32_t b);
+
+		/**
+		 * \brief Run a system over a range of rows, a chunk at a time.
+		 *
+		 * Chunks run in parallel when the archetype has a job runner, so the system must only
+		 * write to the rows of the chunk it was given.
+		 *
+		 * \param first First row.
+		 * \param last One past the last row.
+		 * \param system Called with the first and one past the last row of each chunk.
+		 */
+		template <typename F>
+		void ForEachChunk(uint32_t first, uint32_t last, F system)
+		{
+			if (first >= last) return;
+
+			uint32_t chunks = (last - first + KE_ENTITY_CHUNK_SIZE - 1) / KE_ENTITY_CHUNK_SIZE;
+
+			if (runner == nullptr || chunks < 2)
+			{
+				for (uint32_t chunk = first; chunk < last; chunk += KE_ENTITY_CHUNK_SIZE)
+				{
+					system(chunk, std::min(chunk + KE_ENTITY_CHUNK_SIZE, last));
+				}
+
+				return;
+			}
+
+			runner(chunks, [&](uint32_t job) {
+				uint32_t chunk = first + job * KE_ENTITY_CHUNK_SIZE;
+				system(chunk, std::min(chunk + KE_ENTITY_CHUNK_SIZE, last));
+			});
+		}
+	};
+
+	class KEntityStore
+	{
+	private:
+		std::vector<KArchetype> archetypes = {};
+		KHandleTable handles;
+
+	public:
+		KEntityStore();
+
+		/**
+		 * \brief Get an archetype.
+		 *
+		 * \param archetype Archetype from KE_ARCHETYPES.
+		 * \return The archetype.
+		 */
+		KArchetype &Get(uint32_t archetype) { return archetypes[archetype]; };
+
+		/**
+		 * \brief Run the chunks of every archetype's systems through a job runner.
+		 *
+		 * \param runner Job runner, nullptr to run chunks one after another.
+		 */
+		void SetJobRunner(KJobRunner runner);
+
+		/**
+		 * \brief Create an entity.
+		 *
+		 * \param archetype Archetype to create the entity in.
+		 * \param owner Object the entity belongs to.
+		 * \return Handle of the new entity.
+		 */
+		KHandle Create(uint32_t archetype, KObject *owner);
+
+		/**
+		 * \brief Destroy an entity, the last row of its archetype takes its place.
+		 *
+		 * \param entity Handle of the entity.
+		 * \return true if destroyed, false if the handle was stale.
+		 */
+		bool Destroy(KHandle entity);
+
+		/**
+		 * \brief Move an entity to another archetype, keeping the components both have.
+		 *
+		 * \param entity Handle of the entity.
+		 * \param archetype Archetype to move the entity to.
+		 */
+		void Migrate(KHandle entity, uint32_t archetype);
+
+		/**
+		 * \brief Swap two rows of an archetype, keeping their handles pointing at them.
+		 *
+		 * \param archetype Archetype of the rows.
+		 * \param a First row.
+		 * \param b Second row.
+		 */
+		void Swap(uint32_t archetype, uint32_t a, uint32_t b);
+
+		/**
+		 * \brief Find where an entity is stored.
+		 *
+		 * \param entity Handle of the entity.
+		 * \param archetype [out] Archetype of the entity.
+		 * \param row [out] Row of the entity in its archetype.
+		 * \return true if the handle is still valid, otherwise false.
+		 */
+		bool Resolve(KHandle entity, uint32_t &archetype, uint32_t &row) const;
+
+		/**
+		 * \brief Get an entity's transform.
+		 *
+		 * \param entity Handle of the entity.
+		 * \return Pointer to the component, nullptr if the handle is stale or the archetype lacks it.
+		 */
+		KTransformComponent *Transform(KHandle entity);
+
+		/**
+		 * \brief Get an entity's render component.
+		 *
+		 * \param entity Handle of the entity.
+		 * \return Pointer to the component, nullptr if the handle is stale or the archetype lacks it.
+		 */
+		KRenderComponent *Render(KHandle entity);
+
+		/**
+		 * \brief Destroy every entity.
+		 */
+		void Clear();
+	};
+}
+
+
+#endif //KENGINE_KENTITYSTORE_H
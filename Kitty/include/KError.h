@@ -61,6 +61,10 @@ namespace Kitty
 			KE_UNSUPPORTED_LAYOUT,
 			KE_MODEL_LOAD_FAIL,
 			KE_UNKNOWN_BUFFER_TYPE,
+			KE_VULKAN_FENCE_FAIL,
+			KE_VULKAN_TRANSFER_FAIL,
+			KE_VULKAN_PIPELINE_CACHE_FAIL,
+			KE_VULKAN_CPIPELINE_FAIL,
 		};
 
 		/**
@@ -0,0 +1,83 @@
+/**
+ * Kitty Engine
+ * KHandle.h
+ *
+ * Generational handles for scene entities. A handle names a slot in a
+ * handle table and the generation the slot was on when the handle was
+ * made, so handles to removed entities are recognized as stale even
+ * after their slot has been reused. The table maps slots to wherever
+ * the entity currently sits in its densely packed storage.
+ *
+ * \author Krista Koivisto
+ * \copyright Read included LICENSE file.
+ */
+
+#ifndef KENGINE_KHANDLE_H
+#define KENGINE_KHANDLE_H
+
+#include <vector>
+#include <cstdint>
+
+#define KE_NULL_HANDLE_SLOT 0xFFFFFFFFu
+
+namespace Kitty
+{
+	struct KHandle
+	{
+		uint32_t slot = KE_NULL_HANDLE_SLOT;
+		uint32_t generation = 0;
+
+		bool IsNull() const { return slot == KE_NULL_HANDLE_SLOT; };
+		bool operator==(const KHandle &other) const { return slot == other.slot && generation == other.generation; };
+		bool operator!=(const KHandle &other) const { return !(*this == other); };
+	};
+
+	class KHandleTable
+	{
+	private:
+		std::vector<uint32_t> indices = {};
+		std::vector<uint32_t> generations = {};
+		std::vector<uint32_t> freeSlots = {};
+
+	public:
+		/**
+		 * \brief Create a handle for an entity.
+		 *
+		 * \param index Where the entity sits in its storage.
+		 * \return The new handle.
+		 */
+		KHandle Create(uint32_t index);
+
+		/**
+		 * \brief Find where a handle's entity currently sits.
+		 *
+		 * \param handle Handle to look up.
+		 * \param index [out] Index of the entity in its storage.
+		 * \return true if the handle is still valid, otherwise false.
+		 */
+		bool Resolve(KHandle handle, uint32_t &index) const;
+
+		/**
+		 * \brief Tell the table an entity was moved in its storage.
+		 *
+		 * \param handle Handle of the moved entity.
+		 * \param index New index of the entity.
+		 */
+		void Move(KHandle handle, uint32_t index);
+
+		/**
+		 * \brief Invalidate a handle and free its slot for reuse.
+		 *
+		 * \param handle Handle to release.
+		 */
+		void Release(KHandle handle);
+
+		/**
+		 * \brief Invalidate every handle.
+		 */
+		void Clear();
+	};
+}
+
+
+#endif //KENGINE_KHANDLE_H
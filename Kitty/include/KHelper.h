@@ -12,6 +12,7 @@
 #ifndef KENGINE_KHELPER_H
 #define KENGINE_KHELPER_H
 
+#include <cstdio>
 #include <fstream>
 #include <vector>
 #include <glm/detail/type_mat.hpp>
@@ -45,6 +46,18 @@ namespace Kitty
 		 * \return Vector containing all chars of the file, empty vector if file failed to open.
 		 */
 		std::vector<char> ReadBinaryFile(const std::string& filename);
+
+		/**
+		 * \brief Write an entire binary file.
+		 *
+		 * The data is written to a temporary file first which then replaces the target, so a
+		 * crash halfway through never leaves a truncated file behind.
+		 *
+		 * \param filename File to write.
+		 * \param data Data to write.
+		 * \return true on success, false on fail.
+		 */
+		bool WriteBinaryFile(const std::string& filename, const std::vector<char>& data);
 	};
 }
 
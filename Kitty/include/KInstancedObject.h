@@ -12,8 +12,10 @@
 #define KENGINE_KINSTANCEDOBJECT_H
 
 #include "IObject.h"
+#include "KHandle.h"
 #include "Vulkan/KVulkan.h"
 #include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 namespace Kitty
 {
@@ -23,9 +25,34 @@ namespace Kitty
 		IObject *instanceParent;
 		Vulkan::InstanceData instanceData;
 
+		glm::vec3 position = glm::vec3(0.0f);
+		glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+		float scale = 1.0f;
+		KHandle handle = {};
+
+		/**
+		 * \brief Pack the instance's transform into its instance data.
+		 */
+		void PackInstanceData();
+
+		/**
+		 * \brief Let the parent's scene know the instance's data needs uploading again.
+		 */
+		void InstanceChanged();
+
 	public:
 		explicit KInstancedObject(IObject *parent);
 
+		/**
+		 * \brief Create an instance with a transform.
+		 *
+		 * \param parent Object the instance is drawn as.
+		 * \param newPosition Position in the parent's model space.
+		 * \param newRotation Rotation quaternion.
+		 * \param newScale Uniform scale.
+		 */
+		KInstancedObject(IObject *parent, glm::vec3 newPosition, glm::quat newRotation, float newScale);
+
 		/**
 		 * \brief Set instance position.
 		 *
@@ -33,6 +60,51 @@ namespace Kitty
 		 */
 		void SetPosition(glm::vec3 newPosition);
 
+		/**
+		 * \brief Set instance rotation.
+		 *
+		 * \param axis Axis along which to rotate instance (for example 0, 0, 1 to rotate around the vertical axis).
+		 * \param newRotation New rotation angle in degrees.
+		 */
+		void SetRotation(glm::vec3 axis, float newRotation);
+
+		/**
+		 * \brief Set instance rotation.
+		 *
+		 * \param newRotation New rotation as a quaternion.
+		 */
+		void SetRotation(glm::quat newRotation);
+
+		/**
+		 * \brief Set instance scale.
+		 *
+		 * Stored at half precision, so expect around three significant digits.
+		 *
+		 * \param newScale New uniform scale.
+		 */
+		void SetScale(float newScale);
+
+		/**
+		 * \brief Get instance position.
+		 *
+		 * \return Position in the parent's model space.
+		 */
+		glm::vec3 GetPosition() { return position; };
+
+		/**
+		 * \brief Get instance rotation.
+		 *
+		 * \return Rotation quaternion.
+		 */
+		glm::quat GetRotation() { return rotation; };
+
+		/**
+		 * \brief Get instance scale.
+		 *
+		 * \return Uniform scale.
+		 */
+		float GetScale() { return scale; };
+
 		/**
 		 * \brief Get instance data for updating the vertex buffer.
 		 *
@@ -46,6 +118,20 @@ namespace Kitty
 		 * \return Instance's parent object.
 		 */
 		IObject *GetParent() { return instanceParent; };
+
+		/**
+		 * \brief Set the handle the scene tracks the instance with.
+		 *
+		 * \param instanceHandle Handle in the scene's instance handle table.
+		 */
+		void SetHandle(KHandle instanceHandle) { handle = instanceHandle; };
+
+		/**
+		 * \brief Get the handle the scene tracks the instance with.
+		 *
+		 * \return Handle which stays valid until the instance is removed from the scene.
+		 */
+		KHandle GetHandle() { return handle; };
 	};
 }
 
@@ -0,0 +1,27 @@
+/**
+ * Kitty Engine
+ * KJobRunner.h
+ *
+ * Hook for spreading work over threads. Systems and sorts hand their
+ * work to a job runner in independent pieces, the scene provides one
+ * which runs them on threads that already exist instead of starting
+ * new ones every time.
+ *
+ * \author Krista Koivisto
+ * \copyright Read included LICENSE file.
+ */
+
+#ifndef KENGINE_KJOBRUNNER_H
+#define KENGINE_KJOBRUNNER_H
+
+#include <functional>
+#include <cstdint>
+
+namespace Kitty
+{
+	//! Runs a number of jobs in parallel and returns once all of them finished, jobs get their index.
+	typedef std::function<void(uint32_t count, const std::function<void(uint32_t job)> &job)> KJobRunner;
+}
+
+
+#endif //KENGINE_KJOBRUNNER_H
@@ -12,7 +12,10 @@
 #define KENGINE_KLIGHT_H
 
 #include <glm/glm.hpp>
+#include <cmath>
+#include <limits>
 #include "KEngine.h"
+#include "KHandle.h"
 
 namespace Kitty
 {
@@ -25,8 +28,7 @@ namespace Kitty
 		glm::vec3 position;
 		glm::mat4 rotationMatrix;
 		glm::mat4 translationMatrix;
-
-
+		KHandle handle = {};
 
 	public:
 		explicit KLight(KScene *contextScene);
@@ -37,6 +39,9 @@ namespace Kitty
 		float linearAttenuation = 1.0f;
 		float quadraticAttenuation = 0.0f;
 
+		//! Light contributions weaker than this are treated as zero, which gives the light its range.
+		float cutoff = 1.0f / 256.0f;
+
 		/**
 		 * \brief Set light position.
 		 *
@@ -79,6 +84,29 @@ namespace Kitty
 		 * \return Light translation and rotation matrix.
 		 */
 		glm::mat4 GetLightMatrix() { return rotationMatrix * translationMatrix; }
+
+		/**
+		 * \brief Get the distance beyond which the light no longer contributes anything.
+		 *
+		 * Derived from the attenuation, color and cutoff, so it follows changes to them.
+		 *
+		 * \return Light range, infinite if the light doesn't attenuate.
+		 */
+		float GetRange();
+
+		/**
+		 * \brief Set the handle the scene tracks the light with.
+		 *
+		 * \param lightHandle Handle in the scene's light handle table.
+		 */
+		void SetHandle(KHandle lightHandle) { handle = lightHandle; };
+
+		/**
+		 * \brief Get the handle the scene tracks the light with.
+		 *
+		 * \return Handle which stays valid until the light is removed from the scene.
+		 */
+		KHandle GetHandle() { return handle; };
 	};
 }
 
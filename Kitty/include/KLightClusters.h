@@ -0,0 +1,108 @@
+/**
+ * Kitty Engine
+ * KLightClusters.h
+ *
+ * Light culling for clustered forward shading. The view frustum is split
+ * into screen space tiles and exponential depth slices, and each light is
+ * binned into the clusters its range reaches so fragments only need to
+ * consider the lights of the cluster they fall in.
+ *
+ * \author Krista Koivisto
+ * \copyright Read included LICENSE file.
+ */
+
+#ifndef KENGINE_KLIGHTCLUSTERS_H
+#define KENGINE_KLIGHTCLUSTERS_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+#include "KLight.h"
+#include "Vulkan/KVulkan.h"
+
+namespace Kitty
+{
+	class KLight;
+
+	//! Start of the cluster grid buffer, followed by one light count per cluster.
+	struct KClusterGridHeader
+	{
+		glm::uvec4 size; // x, y, z = Clusters along each axis, w = Max lights per cluster
+		glm::vec4 params; // x, y = Tile size in pixels, z = Depth slice scale, w = Depth slice bias
+	};
+
+	class KLightClusters
+	{
+	private:
+		uint32_t tilesX = 16;
+		uint32_t tilesY = 9;
+		uint32_t slices = 24;
+		uint32_t maxLightsPerCluster = KE_MAX_CLUSTER_LIGHTS;
+
+		std::vector<uint32_t> counts = {};
+
+	public:
+		/**
+		 * \brief Create a cluster grid.
+		 *
+		 * \param tileCountX [optional] Number of screen space tiles horizontally.
+		 * \param tileCountY [optional] Number of screen space tiles vertically.
+		 * \param sliceCount [optional] Number of depth slices.
+		 * \param maxLights [optional] Most lights a single cluster can hold, the rest are dropped.
+		 */
+		explicit KLightClusters(uint32_t tileCountX = 16, uint32_t tileCountY = 9, uint32_t sliceCount = 24,
+		                        uint32_t maxLights = KE_MAX_CLUSTER_LIGHTS);
+
+		/**
+		 * \brief Get the total number of clusters.
+		 *
+		 * \return Number of clusters.
+		 */
+		uint32_t GetClusterCount() { return tilesX * tilesY * slices; };
+
+		/**
+		 * \brief Get the size of the grid data written by Build.
+		 *
+		 * \return Size in bytes.
+		 */
+		size_t GetGridSize() { return sizeof(KClusterGridHeader) + GetClusterCount() * sizeof(uint32_t); };
+
+		/**
+		 * \brief Get the size of the light index data written by Build.
+		 *
+		 * \return Size in bytes.
+		 */
+		size_t GetIndexSize() { return GetClusterCount() * maxLightsPerCluster * sizeof(uint32_t); };
+
+		/**
+		 * \brief Get the most lights a single cluster can hold.
+		 *
+		 * \return Cluster capacity.
+		 */
+		uint32_t GetMaxLightsPerCluster() { return maxLightsPerCluster; };
+
+		/**
+		 * \brief Bin lights into the clusters of a view.
+		 *
+		 * Each light is treated as a sphere of its range and added to every cluster its screen
+		 * space bounds overlap, which is conservative but cheap.
+		 *
+		 * \param view View matrix.
+		 * \param proj Projection matrix (symmetric perspective).
+		 * \param zNear Near plane distance used by the projection.
+		 * \param zFar Far plane distance used by the projection.
+		 * \param width Render area width in pixels.
+		 * \param height Render area height in pixels.
+		 * \param lights Lights to bin.
+		 * \param lightCount Number of lights from the start of the list to bin.
+		 * \param grid [out] Memory to write GetGridSize bytes of grid data to.
+		 * \param indices [out] Memory to write GetIndexSize bytes of light indices to.
+		 */
+		void Build(const glm::mat4 &view, const glm::mat4 &proj, float zNear, float zFar, uint32_t width,
+		           uint32_t height, const std::vector<KLight*> &lights, uint32_t lightCount, void *grid,
+		           void *indices);
+	};
+}
+
+
+#endif //KENGINE_KLIGHTCLUSTERS_H
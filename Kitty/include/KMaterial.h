@@ -14,6 +14,7 @@
 
 #include <vulkan/vulkan.h>
 #include "Vulkan/KVulkanTexture.h"
+#include "KHandle.h"
 
 namespace Kitty
 {
@@ -36,6 +37,7 @@ namespace Kitty
 		VkDescriptorImageInfo descriptor = {};
 		Vulkan::KVulkanTexture *diffuseTexture = {};
 		KE_MATERIALS material = KM_PHONG;
+		bool hasTexture = true;
 
 		float shininess = 16.0f;
 		float specularStrength = 1.0f;
@@ -46,6 +48,7 @@ namespace Kitty
 	class KMaterial
 	{
 	private:
+		KHandle handle = {};
 
 	public:
 		KMaterial() = default;
@@ -53,6 +56,20 @@ namespace Kitty
 
 		void SetTextureImage(Vulkan::KVulkanTexture *texture, KE_TEXTURE_PROPERTY prop);
 
+		/**
+		 * \brief Set the handle the scene tracks the material with.
+		 *
+		 * \param materialHandle Handle in the scene's material handle table.
+		 */
+		void SetHandle(KHandle materialHandle) { handle = materialHandle; };
+
+		/**
+		 * \brief Get the handle the scene tracks the material with.
+		 *
+		 * \return Handle which stays valid until the material is removed from the scene.
+		 */
+		KHandle GetHandle() { return handle; };
+
 		VkDescriptorSet descriptorSet = {};
 		KMaterialProperties properties;
 	};
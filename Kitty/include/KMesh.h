@@ -13,6 +13,7 @@
 
 #include <vulkan/vulkan.h>
 #include <cstring>
+#include <glm/glm.hpp>
 #include "Vulkan/KVulkan.h"
 #include "KError.h"
 
@@ -24,6 +25,8 @@ namespace Kitty
 		{
 		private:
 			uint32_t bufferOffset = 0;
+			uint32_t firstIndex = 0;
+			glm::vec4 boundingSphere = glm::vec4(0.0f);
 
 		public:
 			KMesh() = default;
@@ -53,6 +56,32 @@ namespace Kitty
 			 * \return Mesh vertex buffer offset.
 			 */
 			uint32_t GetBufferOffset() { return bufferOffset; }
+
+			/**
+			 * \brief Set position of the mesh's first index in index buffer.
+			 *
+			 * \param first Index buffer position.
+			 */
+			void SetFirstIndex(uint32_t first) { firstIndex = first; }
+
+			/**
+			 * \brief Get position of the mesh's first index in index buffer.
+			 *
+			 * \return Mesh index buffer position.
+			 */
+			uint32_t GetFirstIndex() { return firstIndex; }
+
+			/**
+			 * \brief Recalculate the bounding sphere after changing vertices by hand.
+			 */
+			void UpdateBoundingSphere();
+
+			/**
+			 * \brief Get a sphere enclosing all vertices of the mesh.
+			 *
+			 * \return Sphere in model space, x, y, z for the center and w for the radius.
+			 */
+			glm::vec4 GetBoundingSphere() { return boundingSphere; }
 		};
 }
 
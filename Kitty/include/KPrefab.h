@@ -0,0 +1,172 @@
+/**
+ * Kitty Engine
+ * KPrefab.h
+ *
+ * Groups of objects instanced as a unit. Each part of a prefab is an
+ * object placed relative to the prefab, and every prefab instance is
+ * expanded into one instance of each part, so a structure made of
+ * several meshes still draws with one instanced draw per mesh.
+ *
+ * \author Krista Koivisto
+ * \copyright Read included LICENSE file.
+ */
+
+#ifndef KENGINE_KPREFAB_H
+#define KENGINE_KPREFAB_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+#include <cstdint>
+#include "KHandle.h"
+
+namespace Kitty
+{
+	class KScene;
+	class KObject;
+
+	class KPrefab
+	{
+	private:
+		//! Placement of a part within the prefab, or of a prefab instance within the world.
+		struct KPrefabTransform
+		{
+			glm::vec3 position = glm::vec3(0.0f);
+			glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+			float scale = 1.0f;
+		};
+
+		//! An object of the prefab and its instance in every prefab instance, null for removed ones.
+		struct KPrefabPart
+		{
+			KHandle object = {};
+			KPrefabTransform transform = {};
+			std::vector<KHandle> instances = {};
+		};
+
+		KScene *context = nullptr;
+
+		std::vector<KPrefabPart> parts = {};
+		std::vector<KPrefabTransform> transforms = {};
+		std::vector<bool> removed = {};
+
+		/**
+		 * \brief Combine a prefab instance's transform with a part's.
+		 *
+		 * \param outer Transform of the prefab instance.
+		 * \param inner Transform of the part within the prefab.
+		 * \return Transform of the part's instance.
+		 */
+		static KPrefabTransform Compose(const KPrefabTransform &outer, const KPrefabTransform &inner);
+
+		/**
+		 * \brief Get the transform from the world into an object's model space.
+		 *
+		 * Instances are placed in their parent's model space, so parts are composed against this
+		 * to stay where the prefab puts them however their object is placed. Only the x component
+		 * of the object's scale is taken into account, non-uniform scales can't be undone.
+		 *
+		 * \param object The object.
+		 * \return Inverse of the object's transform.
+		 */
+		static KPrefabTransform WorldToObject(KObject *object);
+
+		/**
+		 * \brief Create instances of a part for a run of prefab instances.
+		 *
+		 * \param part Part to instance.
+		 * \param first Index of the first prefab instance.
+		 * \param count Number of prefab instances.
+		 */
+		void InstancePart(KPrefabPart &part, uint32_t first, uint32_t count);
+
+	public:
+		/**
+		 * \brief Create an empty prefab.
+		 *
+		 * Use KScene::CreatePrefab instead, the scene keeps track of its prefabs.
+		 *
+		 * \param contextScene Scene the prefab's objects belong to.
+		 */
+		explicit KPrefab(KScene *contextScene) : context(contextScene) {};
+
+		/**
+		 * \brief Add an object to the prefab.
+		 *
+		 * The object is hidden and only drawn through its instances, which are placed relative to
+		 * the prefab instances wherever the object itself is. Existing prefab instances get an
+		 * instance of the new part.
+		 *
+		 * \param object Object to add.
+		 * \param position [optional] Position of the part within the prefab.
+		 * \param rotation [optional] Rotation of the part within the prefab.
+		 * \param scale [optional] Uniform scale of the part within the prefab.
+		 * \return Index of the part, or -1 if the object isn't in the prefab's scene.
+		 */
+		int32_t AddPart(KObject *object, glm::vec3 position = glm::vec3(0.0f),
+		                glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), float scale = 1.0f);
+
+		/**
+		 * \brief Create an instance of the whole prefab.
+		 *
+		 * \param position [optional] Position of the prefab instance.
+		 * \param rotation [optional] Rotation of the prefab instance.
+		 * \param scale [optional] Uniform scale of the prefab instance.
+		 * \return Index of the prefab instance.
+		 */
+		uint32_t CreateInstance(glm::vec3 position = glm::vec3(0.0f),
+		                        glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), float scale = 1.0f);
+
+		/**
+		 * \brief Create many instances of the whole prefab at once.
+		 *
+		 * Each part's instances are created in bulk, see IObject::CreateInstances.
+		 *
+		 * \param count Number of prefab instances to create.
+		 * \param positions [optional] Position of each prefab instance, at the origin if null.
+		 * \param rotations [optional] Rotation of each prefab instance, unrotated if null.
+		 * \param scales [optional] Uniform scale of each prefab instance, 1 if null.
+		 * \return Index of the first prefab instance, the rest follow it.
+		 */
+		uint32_t CreateInstances(uint32_t count, const glm::vec3 *positions = nullptr,
+		                         const glm::quat *rotations = nullptr, const float *scales = nullptr);
+
+		/**
+		 * \brief Move a prefab instance, along with the instances of all of its parts.
+		 *
+		 * \param instance Index of the prefab instance.
+		 * \param position New position.
+		 * \param rotation New rotation.
+		 * \param scale New uniform scale.
+		 * \return False if there's no such prefab instance.
+		 */
+		bool SetInstanceTransform(uint32_t instance, glm::vec3 position, glm::quat rotation, float scale);
+
+		/**
+		 * \brief Remove a prefab instance, along with the instances of all of its parts.
+		 *
+		 * The index isn't reused by later prefab instances.
+		 *
+		 * \param instance Index of the prefab instance.
+		 * \return False if there's no such prefab instance.
+		 */
+		bool RemoveInstance(uint32_t instance);
+
+		/**
+		 * \brief Get the number of parts in the prefab.
+		 *
+		 * \return Number of parts.
+		 */
+		uint32_t GetPartCount() { return static_cast<uint32_t>(parts.size()); };
+
+		/**
+		 * \brief Get the number of prefab instances created, including removed ones.
+		 *
+		 * \return Number of prefab instances.
+		 */
+		uint32_t GetInstanceCount() { return static_cast<uint32_t>(transforms.size()); };
+	};
+}
+
+
+#endif //KENGINE_KPREFAB_H
@@ -0,0 +1,208 @@
+/**
+ * Kitty Engine
+ * KRadixSort.h
+ *
+ * Least significant digit radix sort of keys which carry a 32-bit
+ * payload along, a byte at a time. Large sorts split every pass into
+ * blocks which are counted and scattered in parallel through a job
+ * runner.
+ *
+ * \author Krista Koivisto
+ * \copyright Read included LICENSE file.
+ */
+
+#ifndef KENGINE_KRADIXSORT_H
+#define KENGINE_KRADIXSORT_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "KJobRunner.h"
+
+// Fewer keys than this are sorted on the calling thread, handing out the work would cost more
+#define KE_RADIX_SORT_PARALLEL_MIN 16384
+
+namespace Kitty
+{
+	template <class Key>
+	class KRadixSort
+	{
+	private:
+		uint32_t threadCount = 1;
+		KJobRunner runner = nullptr;
+
+		std::vector<Key> keys = {};
+		std::vector<uint32_t> payloads = {};
+
+		// Each pass ping pongs between these and the above
+		std::vector<Key> scratchKeys = {};
+		std::vector<uint32_t> scratchPayloads = {};
+
+		std::vector<std::array<uint32_t, 256>> offsets = {};
+
+		/**
+		 * \brief Run a function over blocks of work, through the job runner if there is one.
+		 *
+		 * \param blocks Number of blocks.
+		 * \param work Called with the index of each block.
+		 */
+		void ForEachBlock(uint32_t blocks, const std::function<void(uint32_t block)> &work)
+		{
+			if (runner == nullptr || blocks < 2)
+			{
+				for (uint32_t block = 0; block < blocks; ++block) work(block);
+				return;
+			}
+
+			runner(blocks, work);
+		}
+
+	public:
+		/**
+		 * \brief Set what runs the blocks of large sorts in parallel.
+		 *
+		 * \param jobRunner Job runner, nullptr to sort on the calling thread.
+		 * \param threads [optional] Most blocks to split a pass into, 0 to use one per available core.
+		 */
+		void SetJobRunner(KJobRunner jobRunner, uint32_t threads = 0)
+		{
+			runner = std::move(jobRunner);
+			threadCount = (threads != 0) ? threads : std::max(std::thread::hardware_concurrency(), 1u);
+		}
+
+		/**
+		 * \brief Get the number of blocks a sort of some number of keys is split into.
+		 *
+		 * Also useful for filling the keys in parallel the same way.
+		 *
+		 * \param count Number of keys.
+		 * \return Number of blocks, 1 without a job runner.
+		 */
+		uint32_t GetBlockCount(uint32_t count) const
+		{
+			return (count < KE_RADIX_SORT_PARALLEL_MIN || runner == nullptr) ? 1 : std::min(threadCount, count);
+		}
+
+		/**
+		 * \brief Remove every key.
+		 *
+		 * \param reserve [optional] Number of keys about to be pushed.
+		 */
+		void Clear(size_t reserve = 0)
+		{
+			keys.clear();
+			payloads.clear();
+			keys.reserve(reserve);
+			payloads.reserve(reserve);
+		}
+
+		/**
+		 * \brief Change the number of keys, to fill them in through GetKeys and GetPayloads.
+		 *
+		 * \param count Number of keys.
+		 */
+		void Resize(size_t count)
+		{
+			keys.resize(count);
+			payloads.resize(count);
+		}
+
+		/**
+		 * \brief Add a key.
+		 *
+		 * \param key Key to sort by.
+		 * \param payload Value which follows the key around.
+		 */
+		void Push(Key key, uint32_t payload)
+		{
+			keys.push_back(key);
+			payloads.push_back(payload);
+		}
+
+		/**
+		 * \brief Get the keys, in sorted order after Sort.
+		 *
+		 * \return Keys.
+		 */
+		std::vector<Key> &GetKeys() { return keys; };
+		const std::vector<Key> &GetKeys() const { return keys; };
+
+		/**
+		 * \brief Get the payloads, in the order of their keys.
+		 *
+		 * \return Payloads.
+		 */
+		std::vector<uint32_t> &GetPayloads() { return payloads; };
+		const std::vector<uint32_t> &GetPayloads() const { return payloads; };
+
+		/**
+		 * \brief Sort the keys, along with their payloads.
+		 *
+		 * Bytes every key shares are skipped, so sorting mostly costs as much as the keys
+		 * actually differ. Stable, equal keys stay in the order they were added.
+		 */
+		void Sort()
+		{
+			auto count = static_cast<uint32_t>(keys.size());
+			if (count < 2) return;
+
+			scratchKeys.resize(count);
+			scratchPayloads.resize(count);
+
+			uint32_t blocks = GetBlockCount(count);
+			uint32_t blockSize = (count + blocks - 1) / blocks;
+			offsets.resize(blocks);
+
+			for (uint32_t shift = 0; shift < sizeof(Key) * 8; shift += 8)
+			{
+				// Each block counts its own digits so blocks can scatter without stepping on each other
+				ForEachBlock(blocks, [&](uint32_t block) {
+					uint32_t first = std::min(block * blockSize, count);
+					uint32_t last = std::min(first + blockSize, count);
+
+					offsets[block].fill(0);
+					for (uint32_t i = first; i < last; ++i) offsets[block][(keys[i] >> shift) & 0xFF]++;
+				});
+
+				// Every key has the same byte here, the pass wouldn't move anything
+				uint32_t digit = (keys[0] >> shift) & 0xFF;
+				uint32_t same = 0;
+				for (auto &counts : offsets) same += counts[digit];
+				if (same == count) continue;
+
+				// Buckets in digit order, within a bucket the blocks in order, which keeps the sort stable
+				uint32_t total = 0;
+
+				for (uint32_t d = 0; d < 256; ++d)
+				{
+					for (auto &counts : offsets)
+					{
+						uint32_t bucket = counts[d];
+						counts[d] = total;
+						total += bucket;
+					}
+				}
+
+				ForEachBlock(blocks, [&](uint32_t block) {
+					uint32_t first = std::min(block * blockSize, count);
+					uint32_t last = std::min(first + blockSize, count);
+
+					for (uint32_t i = first; i < last; ++i)
+					{
+						uint32_t target = offsets[block][(keys[i] >> shift) & 0xFF]++;
+						scratchKeys[target] = keys[i];
+						scratchPayloads[target] = payloads[i];
+					}
+				});
+
+				keys.swap(scratchKeys);
+				payloads.swap(scratchPayloads);
+			}
+		}
+	};
+}
+
+
+#endif //KENGINE_KRADIXSORT_H
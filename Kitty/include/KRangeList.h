@@ -0,0 +1,139 @@
+/**
+ * Kitty Engine
+ * KRangeList.h
+ *
+ * Free ranges of a buffer whose contents are handed out in runs of elements.
+ * Ranges given back while frames in flight may still read them are retired
+ * first, and only become free once those frames are done.
+ *
+ * \author Krista Koivisto
+ * \copyright Read included LICENSE file.
+ */
+
+#ifndef KENGINE_KRANGELIST_H
+#define KENGINE_KRANGELIST_H
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+namespace Kitty
+{
+	class KRangeList
+	{
+	private:
+		//! A run of elements, along with the frame it was given back in while retired.
+		struct KRange
+		{
+			uint32_t first;
+			uint32_t count;
+			uint64_t frame;
+		};
+
+		std::vector<KRange> ranges = {}; // Sorted by first element, neighbours are always merged
+		std::vector<KRange> retired = {};
+
+	public:
+		/**
+		 * \brief Forget every free and retired range.
+		 */
+		void Clear()
+		{
+			ranges.clear();
+			retired.clear();
+		}
+
+		/**
+		 * \brief Take a run of elements from the first free range large enough.
+		 *
+		 * \param count Number of elements needed.
+		 * \param first [out] First element of the run.
+		 * \return True if a free range was large enough.
+		 */
+		bool Allocate(uint32_t count, uint32_t &first)
+		{
+			for (size_t i = 0; i < ranges.size(); ++i)
+			{
+				if (ranges[i].count < count) continue;
+
+				first = ranges[i].first;
+				ranges[i].first += count;
+				ranges[i].count -= count;
+
+				if (ranges[i].count == 0) ranges.erase(ranges.begin() + i);
+
+				return true;
+			}
+
+			return false;
+		}
+
+		/**
+		 * \brief Give back a run of elements nothing reads anymore.
+		 *
+		 * \param first First element of the run.
+		 * \param count Number of elements.
+		 */
+		void Free(uint32_t first, uint32_t count)
+		{
+			if (count == 0) return;
+
+			auto next = std::lower_bound(ranges.begin(), ranges.end(), first, [](const KRange &range, uint32_t at) {
+				return range.first < at;
+			});
+
+			next = ranges.insert(next, { first, count, 0 });
+
+			// Merge with the following range, then with the preceding one
+			if (next + 1 != ranges.end() && next->first + next->count == (next + 1)->first)
+			{
+				next->count += (next + 1)->count;
+				ranges.erase(next + 1);
+			}
+
+			if (next != ranges.begin() && (next - 1)->first + (next - 1)->count == next->first)
+			{
+				(next - 1)->count += next->count;
+				ranges.erase(next);
+			}
+		}
+
+		/**
+		 * \brief Give back a run of elements frames in flight may still read.
+		 *
+		 * \param first First element of the run.
+		 * \param count Number of elements.
+		 * \param frame Number of the frame being prepared.
+		 */
+		void Retire(uint32_t first, uint32_t count, uint64_t frame)
+		{
+			if (count > 0) retired.push_back({ first, count, frame });
+		}
+
+		/**
+		 * \brief Free the ranges retired before the frames reading them finished.
+		 *
+		 * \param frame Ranges retired while preparing this frame or earlier are freed.
+		 */
+		void Release(uint64_t frame)
+		{
+			auto done = std::stable_partition(retired.begin(), retired.end(), [frame](const KRange &range) {
+				return range.frame > frame;
+			});
+
+			for (auto range = done; range != retired.end(); ++range)
+			{
+				Free(range->first, range->count);
+			}
+
+			retired.erase(done, retired.end());
+		}
+
+		/**
+		 * \brief Free every retired range, once nothing is in flight anymore.
+		 */
+		void ReleaseAll() { Release(UINT64_MAX); };
+	};
+}
+
+#endif //KENGINE_KRANGELIST_H
@@ -0,0 +1,109 @@
+/**
+ * Kitty Engine
+ * KRenderQueue.h
+ *
+ * Draw ordering for the scene. Every draw gets a 64-bit key made of
+ * its pipeline, material, mesh and depth, and the keys are radix
+ * sorted so draws sharing state end up next to each other and can
+ * skip binding it again.
+ *
+ * \author Krista Koivisto
+ * \copyright Read included LICENSE file.
+ */
+
+#ifndef KENGINE_KRENDERQUEUE_H
+#define KENGINE_KRENDERQUEUE_H
+
+#include <vector>
+#include <cstdint>
+#include "KRadixSort.h"
+
+// Depth is only roughly front to back, a finer order would change with every camera move
+#define KE_RENDER_QUEUE_DEPTH_BANDS 16
+
+namespace Kitty
+{
+	//! Commands issued while recording draws, and how many were skipped thanks to sorting.
+	struct KRenderQueueStats
+	{
+		uint32_t draws = 0;
+		uint32_t pipelineBinds = 0;
+		uint32_t descriptorBinds = 0; // Bind calls, not sets
+		uint32_t pushConstants = 0;
+		uint32_t mergedDraws = 0; // Objects drawn as instances of another object's draw
+		uint32_t bindsSaved = 0; // Compared to binding everything for every draw
+
+		KRenderQueueStats &operator+=(const KRenderQueueStats &other)
+		{
+			draws += other.draws;
+			pipelineBinds += other.pipelineBinds;
+			descriptorBinds += other.descriptorBinds;
+			pushConstants += other.pushConstants;
+			mergedDraws += other.mergedDraws;
+			bindsSaved += other.bindsSaved;
+
+			return *this;
+		}
+	};
+
+	class KRenderQueue
+	{
+	private:
+		// Keys carry their draw index along as the payload
+		KRadixSort<uint64_t> sorter;
+
+	public:
+		/**
+		 * \brief Build a sort key for a draw.
+		 *
+		 * Fields are ordered by how expensive they are to change: pipeline, then material,
+		 * then mesh. Depth comes last, split into KE_RENDER_QUEUE_DEPTH_BANDS bands on a
+		 * logarithmic scale, and sorts front to back. Coarse bands keep the order, and the
+		 * draws recorded from it, the same while the camera moves a little. Ids larger than
+		 * their field wrap around, which only costs some binds.
+		 *
+		 * \param pipeline Pipeline id, 8 bits.
+		 * \param material Material id, 20 bits.
+		 * \param mesh Mesh id, 20 bits.
+		 * \param depth View space distance to the draw, 0 to leave depth out of the order.
+		 * \param zNear Near plane distance.
+		 * \param zFar Far plane distance.
+		 * \return Sort key.
+		 */
+		static uint64_t MakeKey(uint32_t pipeline, uint32_t material, uint32_t mesh, float depth, float zNear,
+		                        float zFar);
+
+		/**
+		 * \brief Remove all draws from the queue.
+		 *
+		 * \param reserve [optional] Number of draws about to be pushed.
+		 */
+		void Clear(size_t reserve = 0);
+
+		/**
+		 * \brief Add a draw to the queue.
+		 *
+		 * \param key Sort key from MakeKey.
+		 * \param index Index of the draw, returned in sorted order by GetOrder.
+		 */
+		void Push(uint64_t key, uint32_t index);
+
+		/**
+		 * \brief Sort the queued draws by their keys.
+		 *
+		 * Radix sorted with KRadixSort, which skips the bytes every key shares. Stable, draws
+		 * with equal keys stay in the order they were pushed.
+		 */
+		void Sort();
+
+		/**
+		 * \brief Get the draw indices in sorted order.
+		 *
+		 * \return Draw indices, in the order they were pushed until Sort is called.
+		 */
+		const std::vector<uint32_t> &GetOrder() { return sorter.GetPayloads(); };
+	};
+}
+
+
+#endif //KENGINE_KRENDERQUEUE_H
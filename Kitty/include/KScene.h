@@ -18,6 +18,10 @@
 
 #include <glm/vec4.hpp>
 #include <glm/mat4x4.hpp>
+#include <unordered_map>
+#include <map>
+#include <tuple>
+#include <new>
 
 #include "KMesh.h"
 #include "Vulkan/KVulkanBuffer.h"
@@ -32,6 +36,17 @@
 #include "KInstancedObject.h"
 #include "KMaterial.h"
 #include "KLight.h"
+#include "KLightClusters.h"
+#include "KSlicedTable.h"
+#include "KRangeList.h"
+#include "KRenderQueue.h"
+#include "KHandle.h"
+#include "KEntityStore.h"
+#include "KSpatialSort.h"
+#include "KPrefab.h"
+
+// Instances are allocated this many at a time unless a bulk creation asks for more
+#define KE_INSTANCE_BLOCK_SIZE 4096
 
 using namespace Kitty::Error;
 
@@ -43,6 +58,7 @@ namespace Kitty
 	class KObject;
 	class KInstancedObject;
 	class KLight;
+	class KLightClusters;
 	class IModelLoader;
 
 	class KScene
@@ -58,10 +74,9 @@ namespace Kitty
 		KEngine *context = nullptr;
 		Vulkan::KVulkan *vulkan = nullptr;
 
-		Vulkan::vxDynamicUBO *vxUBO = nullptr;
-
 		Vulkan::KVulkanBuffer *instanceBuffer = nullptr;
 		Vulkan::KVulkanBuffer *vertexBuffer = nullptr;
+		Vulkan::KVulkanBuffer *positionBuffer = nullptr; // Vertex positions only, for the depth pre-pass
 		Vulkan::KVulkanBuffer *indexBuffer = nullptr;
 		Vulkan::KVulkanBuffer *dummyInstanceBuffer = nullptr;
 		Vulkan::KVulkanBuffer *dummyIndexBuffer = nullptr;
@@ -69,20 +84,189 @@ namespace Kitty
 
 		Vulkan::KVulkanBuffer *lightsBuffer = {};
 		Vulkan::KVulkanBuffer *uniformBuffer = {};
-		Vulkan::KVulkanBuffer *vxDynamicBuffer = {};
-		VkDescriptorSet lightsDescriptorSet = {};
-		VkDescriptorSet uniformDescriptorSet = {};
-		VkDescriptorSet vxDynamicUniformDescriptorSet = {};
-		size_t dynamicAlignment = 0;
+		Vulkan::KVulkanBuffer *objectTableBuffer = {};
+		Vulkan::KVulkanBuffer *drawOrderBuffer = {};
+		Vulkan::KVulkanBuffer *materialTableBuffer = {};
+		Vulkan::KVulkanBuffer *clusterGridBuffer = {};
+		Vulkan::KVulkanBuffer *clusterLightsBuffer = {};
+		Vulkan::KVulkanBuffer *bucketLightsBuffer = {};
+		std::vector<VkDescriptorSet> lightsDescriptorSets = {};
+		std::vector<VkDescriptorSet> uniformDescriptorSets = {};
+		std::vector<VkDescriptorSet> objectDescriptorSets = {};
+
+		// Per object data, looked up by the shaders through the draw order or the instance parent.
+		// Material parameters are deduplicated into a table of their own, objects only keep an index.
+		KSlicedTable<Vulkan::KObjectData> objectData;
+		KSlicedTable<uint32_t> drawOrderData;
+		KSlicedTable<glm::vec4> materialData;
+		std::unordered_map<KMaterial*, uint32_t> materialSlots = {};
+		uint32_t materialCapacity = 0;
+
+		// Parameters the material table was last built from, it's only rebuilt when they change
+		std::vector<std::pair<KMaterial*, glm::vec4>> materialParams = {};
+
+		// Uniform buffers hold one slice per swap chain image so frames in flight never share data
+		uint32_t uniformSlices = 0;
+		VkDeviceSize uniformSliceSize = 0;
+		VkDeviceSize lightsSliceSize = 0;
+		VkDeviceSize objectTableSliceSize = 0;
+		VkDeviceSize drawOrderSliceSize = 0;
+		VkDeviceSize materialTableSliceSize = 0;
+		VkDeviceSize clusterGridSliceSize = 0;
+		VkDeviceSize clusterLightsSliceSize = 0;
+		VkDeviceSize bucketLightsSliceSize = 0;
+
+		// Lights are binned into view space clusters every frame so fragments only loop over nearby ones
+		KLightClusters *lightClusters = nullptr;
+
+		// Regular objects are split into batches of at least this many draws for parallel recording
+		const uint32_t minDrawsPerBatch = 256;
+		uint32_t drawsPerBatch = 1;
+		uint32_t objectBatches = 0;
+		uint32_t prePassBatches = 0; // Depth pre-pass batches, recorded ahead of the regular ones
+
+		// Regular objects are drawn in sort key order, batches record ranges of it
+		KRenderQueue *renderQueue = nullptr;
+		std::vector<uint32_t> drawOrder = {};
+		std::vector<uint32_t> drawSlots = {}; // Position of each object in drawOrder
+		std::unordered_map<uint64_t, uint32_t> variantIds = {};
+		std::unordered_map<KMaterial*, uint32_t> materialIds = {};
+		std::unordered_map<uint32_t, uint32_t> meshIds = {}; // By buffer offset, shared mesh data shares an id
+
+		// What recording each batch took, written by the recording threads
+		std::vector<KRenderQueueStats> batchStats = {};
+		uint32_t actualizedObjects = 0;
+
+		//! Static objects sharing a material and a cell of the chunk grid, baked into one range of the object buffers.
+		struct KStaticChunk
+		{
+			KMaterial *material = nullptr;
+			uint32_t vertexOffset = 0;
+			uint32_t vertexCount = 0;
+			uint32_t firstIndex = 0;
+			uint32_t indexCount = 0;
+			glm::vec4 bounds = glm::vec4(0.0f); // World space sphere around the chunk
+			std::vector<KObject*> objects = {};
+			bool stale = false; // Objects were removed, baked again by the next update
+		};
+
+		//! Geometry and material of a regular draw, either an object or a static chunk.
+		struct KDrawItem
+		{
+			KMaterial *material;
+			uint32_t vertexOffset;
+			uint32_t firstIndex;
+			uint32_t indexCount;
+		};
+
+		// Chunks are drawn after the regular objects, and take the object table entries following theirs
+		std::vector<KStaticChunk> staticChunks = {};
+		std::unordered_map<KObject*, uint32_t> staticChunkOf = {};
+		uint32_t actualizedDraws = 0;
+
+		// Unused parts of the vertex and index buffers, left behind by removed objects and rebaked chunks.
+		// Parts frames in flight may still draw from are only reused once those frames are done.
+		KRangeList vertexRanges;
+		KRangeList indexRanges;
+		std::unordered_map<uint32_t, uint32_t> meshUsers = {}; // Objects drawing each mesh, by buffer offset
+		uint64_t frameNumber = 0;
+
+		// Light loop bound baked into the shader variants, the scene is re-actualized when lights outgrow it
+		uint32_t variantMaxLights = 1;
+
+		// Lights are stored in a storage buffer which grows with the scene, only changed lights are uploaded
+		uint32_t lightCapacity = 0;
+		uint32_t lightCount = 0;
+
+		//! Light properties laid out as separate arrays so the per-object selection loop vectorizes.
+		struct KLightSelectionData
+		{
+			std::vector<float> x, y, z;
+			std::vector<float> range;
+			std::vector<float> brightness;
+			std::vector<float> constant, linear, quadratic;
+			std::vector<float> influence;
+		};
+
+		KLightSelectionData lightSelection = {};
+
+		// Instances are lit in buckets of KE_INSTANCE_BUCKET_SIZE by where they sit in the instance buffer.
+		// Each bucket selects lights for world space bounds around its instances, which are only calculated
+		// again once the instances in the bucket or their parents move.
+		std::vector<glm::vec4> bucketBounds = {};
+		std::vector<uint8_t> staleBuckets = {};
+		KSlicedTable<Vulkan::KLightSelection> bucketLights;
+
+		//! A compute dispatch waiting to be recorded at the start of the next frame.
+		struct KComputeDispatch
+		{
+			Vulkan::KVulkanComputePipeline *pipeline = nullptr;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			uint32_t groups[3] = {1, 1, 1};
+			std::vector<char> pushData = {};
+		};
 
+		std::vector<KComputeDispatch> computeQueue = {};
+		std::vector<Vulkan::KVulkanComputePipeline*> computePipelines = {};
+		std::vector<Vulkan::KVulkanBuffer*> storageBuffers = {};
+
+		Vulkan::UniformBufferObject uniformData = {};
+		KSlicedTable<Vulkan::KLightData> lightsData;
+
+		//! Contiguous storage for instances, handed out front to back.
+		struct KInstanceBlock
+		{
+			KInstancedObject *data = nullptr;
+			uint32_t used = 0;
+			uint32_t capacity = 0;
+		};
+
+		//! Instances of one object, drawn together from one range of the instance buffer.
+		struct KInstanceRange
+		{
+			IObject *parent = nullptr;
+			uint32_t first = 0;
+			uint32_t count = 0;
+			glm::vec3 low = glm::vec3(0.0f); // Bounds the range's Morton codes are made in
+			glm::vec3 high = glm::vec3(0.0f);
+		};
+
+		std::vector<KInstanceBlock> instanceBlocks = {};
+		std::vector<KInstancedObject*> freeInstances = {};
+
+		// Actualized instances are grouped by parent, removed ones leave a null slot past the end of their range
+		// until the next actualization. Instances created since follow the actualized ones.
 		std::vector<KInstancedObject*> instancedObjects = {};
-		std::vector<KObject*> objects = {};
+		std::vector<KInstanceRange> instanceRanges = {};
+		std::unordered_map<IObject*, uint32_t> instanceRangeOf = {};
+		uint32_t actualizedInstances = 0;
+
+		// The instance buffer is written from the host like the object tables, one slice per swap chain image
+		KSlicedTable<Vulkan::InstanceData> instanceData;
+		VkDeviceSize instanceSliceSize = 0;
+
+		// Instances moved since the last update, uploaded and put back in Morton order by the next one
+		std::vector<KInstancedObject*> movedInstances = {};
+
+		// Morton code of each actualized instance, ranges stay in order of them while spatially ordered
+		std::vector<uint32_t> instanceCodes = {};
+		KSpatialSort spatialSort;
+		std::vector<glm::vec3> sortPositions = {};
+		std::vector<KInstancedObject*> sortScratch = {};
+
+		// Handles map to where their entity currently sits in the vectors, which change order as things are removed
+		KHandleTable instanceHandles;
+		KHandleTable materialHandles;
+		KHandleTable lightHandles;
+
+		// Objects keep their data in component columns, drawn ones first in their archetype's rows
+		KEntityStore entities;
+
 		std::vector<KMaterial*> materials = {};
 		std::vector<KLight*> lights = {};
+		std::vector<KPrefab*> prefabs = {};
 		KMaterial *dummyMat = {};
 
-		VkMemoryPropertyFlags srcMemFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-		VkBufferUsageFlags srcBufferFlags = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
 		VkMemoryPropertyFlags vertexMemFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 		VkBufferUsageFlags vertexBufferFlags = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
 		VkMemoryPropertyFlags indexMemFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
@@ -96,13 +280,127 @@ namespace Kitty
 
 		/**
 		 * \brief Create a UBO for passing view and projection information to the vertex shader.
+		 *
+		 * Also creates the light storage and light cluster buffers, which are sliced the same way.
 		 */
 		void CreateUniformBuffers();
 
 		/**
-		 * \brief Create dynamic UBOs for passing object translation matrices to the shader.
+		 * \brief Create the light storage, with room for at least every light in the scene.
+		 */
+		void CreateLightsBuffer();
+
+		/**
+		 * \brief Make room for lights created since the light storage was last sized.
+		 *
+		 * Only the light storage is replaced and its descriptors rewritten, the rest of the scene
+		 * stays as it is.
+		 */
+		void GrowLightStorage();
+
+		/**
+		 * \brief Create the storage for the lights selected per bucket of instances.
+		 */
+		void CreateBucketLightsBuffer();
+
+		/**
+		 * \brief Copy the latest uniform data into the slice used by a swap chain image.
+		 *
+		 * \param slice Index of the slice to update.
+		 */
+		void UpdateUniformSlice(uint32_t slice);
+
+		/**
+		 * \brief Reserve room for instances in the instance pool.
+		 *
+		 * \param count Number of instances needed.
+		 * \return Uninitialized storage for count instances, one after another.
+		 */
+		KInstancedObject *AllocateInstances(uint32_t count);
+
+		/**
+		 * \brief Destroy every instance and free the instance pool.
+		 */
+		void FreeInstances();
+
+		/**
+		 * \brief Group the instances by parent, dropping the slots of removed ones.
+		 */
+		void BuildInstanceRanges();
+
+		/**
+		 * \brief Rewrite part of the instance data from the instances now in it.
+		 *
+		 * \param first Index of the first instance to rewrite.
+		 * \param count Number of instances to rewrite.
+		 */
+		void UploadInstances(uint32_t first, uint32_t count);
+
+		/**
+		 * \brief Create the instance buffer from the instance data, one slice per swap chain image.
+		 */
+		void CreateInstanceBuffer();
+
+		/**
+		 * \brief Reorder an instance range along the Morton curve through its instances' positions.
+		 *
+		 * Handles follow their instances and the range remembers the bounds of the codes. Only reorders
+		 * the scene's list, uploading is up to the caller.
+		 *
+		 * \param range Range to sort.
+		 */
+		void SortInstanceRange(KInstanceRange &range);
+
+		/**
+		 * \brief Move an instance to where its Morton code belongs in its otherwise ordered range.
+		 *
+		 * Handles follow their instances and the instances which shifted over are uploaded.
+		 *
+		 * \param range Range of the instance.
+		 * \param index Index of the instance.
+		 * \param code New Morton code of the instance.
+		 */
+		void PlaceInstance(const KInstanceRange &range, uint32_t index, uint32_t code);
+
+		/**
+		 * \brief Upload the instances which moved since the last update, putting them back in order first.
+		 */
+		void UpdateMovedInstances();
+
+		/**
+		 * \brief Remove every instance of an object.
+		 *
+		 * \param parent Object whose instances to remove.
+		 */
+		void RemoveObjectInstances(IObject *parent);
+
+		/**
+		 * \brief Record the instance batches again before they're next drawn.
+		 */
+		void InvalidateInstanceBatches();
+
+		/**
+		 * \brief Create the object table and draw order storage buffers, one slice per swap chain image.
+		 */
+		void CreateObjectTables();
+
+		/**
+		 * \brief Create the material table storage buffer, with room for at least every material in the scene.
+		 */
+		void CreateMaterialTable();
+
+		/**
+		 * \brief Make room for material parameters added since the material table was last sized.
+		 *
+		 * Only the material table is replaced and its descriptors rewritten.
 		 */
-		void CreateDynamicUniformBuffers();
+		void GrowMaterialTable();
+
+		/**
+		 * \brief Rebuild the material table if any material's parameters changed, materials with equal
+		 * parameters share an entry.
+		 */
+		void UpdateMaterialTable();
 
 		/**
 		 * \brief Update vertex and index buffers.
@@ -118,48 +416,242 @@ namespace Kitty
 		Vulkan::KVulkanBuffer * CreateObjectBuffer(std::vector<T> data, KE_BUFFER_TYPE type);
 
 		/**
-		 * \brief Update dynamic uniform buffer data.
+		 * \brief Copy the object, draw order and material table entries which changed to a slice.
+		 *
+		 * \param slice Index of the slice to update.
+		 */
+		void UpdateObjectTables(uint32_t slice);
+
+		/**
+		 * \brief Update a drawn object's entry in the object table.
+		 *
+		 * \param index Row of the object in the drawn archetype, also its index in the table.
+		 */
+		void UpdateObjectData(uint32_t index);
+
+		/**
+		 * \brief Bake the static objects into chunks of pre-transformed geometry.
+		 *
+		 * Static objects are taken from the static archetype of the entity store.
+		 *
+		 * \param vx [in,out] Vertex data to append the chunks' vertices to.
+		 * \param ix [in,out] Index data to append the chunks' indices to.
+		 */
+		void BuildStaticChunks(std::vector<Vulkan::Vertex> &vx, std::vector<uint32_t> &ix);
+
+		/**
+		 * \brief Bake the objects of a static chunk into pre-transformed geometry.
+		 *
+		 * The chunk's ranges and bounds are set to where its geometry ended up.
+		 *
+		 * \param chunk Chunk to bake.
+		 * \param vx [in,out] Vertex data to append the chunk's vertices to.
+		 * \param ix [in,out] Index data to append the chunk's indices to.
+		 */
+		void BakeStaticChunk(KStaticChunk &chunk, std::vector<Vulkan::Vertex> &vx, std::vector<uint32_t> &ix);
+
+		/**
+		 * \brief Bake the chunks which lost objects again, into free parts of the object buffers.
+		 *
+		 * Chunks left without objects are dropped, only the batches drawing a rebaked chunk are recorded again.
+		 */
+		void RebakeStaticChunks();
+
+		/**
+		 * \brief Give a part of the object buffers back once the frames in flight are done with it.
+		 *
+		 * \param vertexOffset First vertex of the part.
+		 * \param vertexCount Number of vertices.
+		 * \param firstIndex First index of the part.
+		 * \param indexCount Number of indices.
+		 */
+		void RetireGeometry(uint32_t vertexOffset, uint32_t vertexCount, uint32_t firstIndex, uint32_t indexCount);
+
+		/**
+		 * \brief Write a static chunk's data to the object table.
+		 *
+		 * \param chunk Index of the chunk.
+		 */
+		void UpdateChunkData(uint32_t chunk);
+
+		/**
+		 * \brief Get what a regular draw draws.
+		 *
+		 * \param draw Index of the draw, regular objects first and static chunks after them.
+		 * \return Geometry and material of the draw.
+		 */
+		KDrawItem GetDrawItem(uint32_t draw);
+
+		/**
+		 * \brief Get the model matrix of a regular draw, identity for the pre-transformed static chunks.
+		 *
+		 * \param draw Index of the draw.
+		 * \return Model matrix.
+		 */
+		glm::mat4 GetDrawMatrix(uint32_t draw);
+
+		/**
+		 * \brief Get the bounding sphere of a regular draw, model space for objects and world space for chunks.
+		 *
+		 * \param draw Index of the draw.
+		 * \return Bounding sphere, xyz for the center and w for the radius.
+		 */
+		glm::vec4 GetDrawBounds(uint32_t draw);
+
+		/**
+		 * \brief Calculate the bounds of each drawn object, grown to cover its instances which share its light selection.
+		 */
+		void UpdateObjectBounds();
+
+		/**
+		 * \brief Pick the lights influencing each object the most and store them in its dynamic data.
+		 *
+		 * Buckets of instances get lights of their own.
+		 */
+		void SelectObjectLights();
+
+		/**
+		 * \brief Pick the lights influencing a sphere the most.
+		 *
+		 * Falls back to the light clusters when the sphere is larger than the reach of a selected light,
+		 * a few lights can't stand in for everything reaching it then.
+		 *
+		 * \param center Center of the sphere in world space.
+		 * \param radius Radius of the sphere.
+		 * \param influence [out] Scratch space for the influence of every light.
+		 * \return The selected lights.
 		 */
-		void UpdateDynamicUniformBuffers();
+		Vulkan::KLightSelection SelectLights(glm::vec3 center, float radius, float *influence);
 
 		/**
-		 * \brief Update object data in the dynamic object buffer.
+		 * \brief Calculate the bounds of instance buckets whose instances have moved.
+		 */
+		void UpdateBucketBounds();
+
+		/**
+		 * \brief Have the buckets holding an object's instances calculate their bounds again.
 		 *
-		 * \param obj Object whose data we want to update.
-		 * \param index Index of the object in the buffer.
+		 * \param parent Object whose instances moved.
 		 */
-		void UpdateDynamicObjectBuffer(IObject *obj, uint32_t index);
+		void MarkInstanceBuckets(IObject *parent);
 
 		/**
 		 * \brief Pass information to Vulkan about what we need from our layouts.
 		 */
 		void PrepareDescriptorLayouts();
 
+		/**
+		 * \brief Tell Vulkan which shader variants the scene's materials need built.
+		 */
+		void PrepareShaderVariants();
+
+		/**
+		 * \brief Get the shader features a material should be drawn with.
+		 *
+		 * \param material Material to get the features of.
+		 * \return Shader variant matching the material.
+		 */
+		Vulkan::KVulkanShaderVariant GetShaderVariant(KMaterial *material);
+
 		/**
 		 * \brief Create descriptor sets for loaded shaders.
 		 */
 		void InitializeDescriptorSets();
 
 		/**
-		 * \brief Default recorded render pass command callback.
+		 * \brief Split the draw list into batches which can be recorded in parallel.
 		 *
-		 * \param buf [in] Command buffer currently being processed by the command pool.
+		 * \param threadCount [in] Number of recording threads available.
+		 * \return Number of batches.
+		 */
+		uint32_t GetDrawBatchCount(uint32_t threadCount);
+
+		/**
+		 * \brief Default recorded render pass command callback, records a single batch.
+		 *
+		 * Called from the recording threads, so it must not modify anything shared.
+		 *
+		 * \param buf [in] Secondary command buffer being recorded.
+		 * \param imageIndex [in] Index of the swap chain image the buffer is recorded for.
+		 * \param batch [in] Index of the batch to record.
 		 */
-		void StaticRenderCallback(VkCommandBuffer buf);
+		void BatchRenderCallback(VkCommandBuffer buf, uint32_t imageIndex, uint32_t batch);
 
 		/**
-		 * \brief Draw all regular objects created by the scene.
+		 * \brief Record the queued compute dispatches, with barriers against the frames drawn around them.
+		 *
+		 * \param buf [in] Per-frame command buffer, submitted ahead of the render pass.
+		 */
+		void RecordComputeDispatches(VkCommandBuffer buf);
+
+		/**
+		 * \brief Draw a range of the regular objects created by the scene.
+		 *
+		 * Consecutive objects sharing mesh data and material are merged into a single instanced
+		 * draw when auto instancing is on.
 		 *
 		 * \param buf [in] Command buffer currently being processed by the command pool.
+		 * \param slice [in] Uniform buffer slice to bind.
+		 * \param first [in] Index of the first object to draw.
+		 * \param last [in] Index one past the last object to draw.
+		 * \param stats [out] Counts of the recorded commands.
 		 */
-		void DrawObjects(VkCommandBuffer buf);
+		void DrawObjects(VkCommandBuffer buf, uint32_t slice, uint32_t first, uint32_t last,
+		                 KRenderQueueStats &stats);
 
 		/**
 		 * \brief Draw all instanced objects created by the scene.
 		 *
 		 * \param buf [in] Command buffer currently being processed by the command pool.
+		 * \param slice [in] Uniform buffer slice to bind.
+		 * \param stats [out] Counts of the recorded commands.
+		 */
+		void DrawInstancedObjects(VkCommandBuffer buf, uint32_t slice, KRenderQueueStats &stats);
+
+		/**
+		 * \brief Sort the regular objects into draw order.
+		 *
+		 * Keys are built from each object's pipeline variant, material, mesh and distance from
+		 * the camera. Batches whose share of the order changed since the last sort are
+		 * re-recorded.
+		 */
+		void SortDraws();
+
+		/**
+		 * \brief Draw the depth of a range of the regular objects created by the scene.
+		 *
+		 * \param buf [in] Command buffer currently being processed by the command pool.
+		 * \param slice [in] Uniform buffer slice to bind.
+		 * \param first [in] Index of the first object to draw.
+		 * \param last [in] Index one past the last object to draw.
 		 */
-		void DrawInstancedObjects(VkCommandBuffer buf);
+		void DrawObjectsDepth(VkCommandBuffer buf, uint32_t slice, uint32_t first, uint32_t last);
+
+		/**
+		 * \brief Draw the depth of all instanced objects created by the scene.
+		 *
+		 * \param buf [in] Command buffer currently being processed by the command pool.
+		 * \param slice [in] Uniform buffer slice to bind.
+		 */
+		void DrawInstancedObjectsDepth(VkCommandBuffer buf, uint32_t slice);
+
+		/**
+		 * \brief Count the draws starting at a draw order position which can be merged into one.
+		 *
+		 * \param n Position in the draw order.
+		 * \param last Position one past the last draw which may be merged.
+		 * \param sameMaterial Only merge draws which share a material.
+		 * \return Number of draws to merge, at least 1.
+		 */
+		uint32_t GetDrawRun(uint32_t n, uint32_t last, bool sameMaterial);
+
+		/**
+		 * \brief Record the deferred lighting pass, lighting the G-buffer with the scene's lights.
+		 *
+		 * \param buf [in] Primary command buffer, inside the lighting subpass.
+		 * \param imageIndex [in] Index of the swap chain image the buffer is recorded for.
+		 */
+		void LightingRenderCallback(VkCommandBuffer buf, uint32_t imageIndex);
 
 		/**
 		 * \brief Default render callback function passed to Vulkan.
@@ -173,14 +665,6 @@ namespace Kitty
 		 * \brief Delete everything created by this scene.
 		 */
 		void DeleteEverything();
-
-		/**
-		 * Wrapper functions for aligned memory allocation.
-		 * There is currently no standard for this in C++ that works across all platforms and vendors, so we abstract this.
-		 * Credits go to Sascha Willems for these. (https://github.com/SaschaWillems/)
-		 */
-		void* AlignedAlloc(size_t size, size_t alignment);
-		void AlignedFree(void* data);
 	public:
 		/**
 		 * \brief Create a new scene.
@@ -207,6 +691,37 @@ namespace Kitty
 		// TODO: Make an actual camera entity.
 		glm::vec3 viewPosition = glm::vec3(2, 2, 2);
 		glm::vec3 viewRotation = -viewPosition;
+		float zNear = 0.1f;
+		float zFar = 1000.0f;
+
+		/**
+		 * \brief Light objects by their few nearest lights (KE_MAX_OBJECT_LIGHTS) instead of the light clusters.
+		 *
+		 * Saves the cluster lookups for small objects in scenes with few lights. Instances are lit the same
+		 * way by the bucket they are in. Objects and buckets larger than the reach of their selected lights
+		 * are still lit by the clusters.
+		 */
+		bool perObjectLights = false;
+
+		/**
+		 * \brief Draw objects sharing mesh data and material as instances of each other.
+		 *
+		 * Objects loaded from the same file get their mesh data uploaded once either way, this
+		 * also merges their draws. Takes effect the next time the scene is actualized.
+		 */
+		bool autoInstancing = true;
+
+		/**
+		 * \brief Keep each object's instances in Morton order of their positions.
+		 *
+		 * Instances close to each other in the world end up close to each other in the instance
+		 * buffer. Ranges are sorted when the scene is actualized, instances which move afterwards are
+		 * put back in place one by one. Takes effect the next time the scene is actualized.
+		 */
+		bool spatialInstanceOrder = false;
+
+		//! Edge length of the grid cells static objects are baked together in, keeps chunks small enough to cull.
+		float staticChunkSize = 32.0f;
 
 		/**
 		 * \brief Create a new model object.
@@ -231,6 +746,33 @@ namespace Kitty
 		 */
 		KInstancedObject *AddObjectInstance(IObject *parent);
 
+		/**
+		 * \brief Create many instances of an object at once.
+		 *
+		 * NOTE: This is called automatically when instances are created from a parent
+		 * object, if you want to create instances of an object call CreateInstances
+		 * from the parent object.
+		 *
+		 * \param parent Parent object from which to create the instances.
+		 * \param count Number of instances to create.
+		 * \param positions [optional] Position of each instance, origin if null.
+		 * \param rotations [optional] Rotation of each instance, none if null.
+		 * \param scales [optional] Scale of each instance, 1 if null.
+		 * \return Pointer to the first of count instances stored one after another.
+		 */
+		KInstancedObject *AddObjectInstances(IObject *parent, uint32_t count, const glm::vec3 *positions,
+		                                     const glm::quat *rotations, const float *scales);
+
+		/**
+		 * \brief Create an empty prefab.
+		 *
+		 * Add objects to the prefab as its parts, then instance the prefab to instance all of
+		 * them together. The scene deletes its prefabs along with everything else.
+		 *
+		 * \return Pointer to the new prefab.
+		 */
+		KPrefab *CreatePrefab();
+
 		/**
 		 * \brief Create a material with a texture from an image.
 		 *
@@ -273,11 +815,93 @@ namespace Kitty
 		 */
 		KLight *CreateLight();
 
+		/**
+		 * \brief Remove an object from the scene.
+		 *
+		 * The object's table entry is filled by the last drawn object, so no rebuild is needed. Its
+		 * instances are removed along with it and its geometry is reused by later rebakes. Static
+		 * objects are dropped from their baked chunk, which is baked again by the next update.
+		 *
+		 * \param object Handle of the object to remove.
+		 * \return true if the object was removed, false if the handle was stale.
+		 */
+		bool RemoveObject(KHandle object);
+
+		/**
+		 * \brief Remove an instance from the scene.
+		 *
+		 * The last instance of the same object takes its place in the instance buffer, so only
+		 * that one instance is uploaded again.
+		 *
+		 * \param instance Handle of the instance to remove.
+		 * \return true if the instance was removed, false if the handle was stale.
+		 */
+		bool RemoveInstance(KHandle instance);
+
+		/**
+		 * \brief Remove a material from the scene.
+		 *
+		 * Objects using the material fall back to the default material. Waits for the frames in
+		 * flight to finish, since they may still be using the material's textures.
+		 *
+		 * \param material Handle of the material to remove.
+		 * \return true if the material was removed, false if the handle was stale or the default material.
+		 */
+		bool RemoveMaterial(KHandle material);
+
+		/**
+		 * \brief Remove a light from the scene.
+		 *
+		 * \param light Handle of the light to remove.
+		 * \return true if the light was removed, false if the handle was stale.
+		 */
+		bool RemoveLight(KHandle light);
+
+		/**
+		 * \brief Find an object by its handle.
+		 *
+		 * \param object Handle of the object.
+		 * \return Pointer to the object, nullptr if the handle is stale.
+		 */
+		KObject *FindObject(KHandle object);
+
+		/**
+		 * \brief Find an instance by its handle.
+		 *
+		 * \param instance Handle of the instance.
+		 * \return Pointer to the instance, nullptr if the handle is stale.
+		 */
+		KInstancedObject *FindInstance(KHandle instance);
+
+		/**
+		 * \brief Find a material by its handle.
+		 *
+		 * \param material Handle of the material.
+		 * \return Pointer to the material, nullptr if the handle is stale.
+		 */
+		KMaterial *FindMaterial(KHandle material);
+
+		/**
+		 * \brief Find a light by its handle.
+		 *
+		 * \param light Handle of the light.
+		 * \return Pointer to the light, nullptr if the handle is stale.
+		 */
+		KLight *FindLight(KHandle light);
+
+		/**
+		 * \brief Get the store holding the scene objects' components.
+		 *
+		 * \return Entity store of the scene.
+		 */
+		KEntityStore &GetEntityStore() { return entities; };
+
 		/**
 		 * \brief Update the scene.
 		 *
 		 * Updates the uniform buffer object with new view, projection and light data. You would
-		 * typically call this once per frame.
+		 * typically call this once per frame. The data is handed to the GPU when the next frame
+		 * is drawn.
 		 */
 		void Update();
 
@@ -305,7 +929,84 @@ namespace Kitty
 		 */
 		void Actualize();
 
-		uint32_t GetMaxDynamicLights() { return KE_MAX_DYNAMIC_LIGHTS; };
+		/**
+		 * \brief Let the scene know one of its objects has changed.
+		 *
+		 * Objects call this themselves. Transform changes only update the object's uniform data,
+		 * changes affecting draw commands re-record just the batch the object is drawn in.
+		 *
+		 * \param obj The object which changed.
+		 * \param commandsChanged Does the change affect recorded draw commands (e.g. a new material)?
+		 * \param depthChanged [optional] Does it affect the depth pre-pass commands too (e.g. hiding)?
+		 */
+		void ObjectChanged(IObject *obj, bool commandsChanged, bool depthChanged = false);
+
+		/**
+		 * \brief Let the scene know one of its instances has moved.
+		 *
+		 * Instances call this themselves. The instance is uploaded with the next update, along
+		 * with the rest of its range if spatial instance order has to be restored.
+		 *
+		 * \param instance The instance which changed.
+		 */
+		void InstanceChanged(KInstancedObject *instance);
+
+		/**
+		 * \brief Get how many binds the recorded draws issue, and how many sorting saved.
+		 *
+		 * Covers the scene's draws as last recorded, batches are only recorded again when
+		 * something in them changes.
+		 *
+		 * \return Summed statistics of all recorded batches.
+		 */
+		KRenderQueueStats GetDrawStats();
+
+		/**
+		 * \brief Create a compute pipeline.
+		 *
+		 * The pipeline belongs to the scene and is destroyed along with it.
+		 *
+		 * \param shader Directory and name of the compiled compute shader.
+		 * \param bindings Descriptor type of each set 0 binding, in binding order.
+		 * \param pushSize [optional] Size of the shader's push constant block in bytes.
+		 * \param maxSets [optional] How many descriptor sets will be created for the pipeline.
+		 * \return Pointer to the new compute pipeline.
+		 */
+		Vulkan::KVulkanComputePipeline *CreateComputePipeline(const std::string &shader,
+		                                                      const std::vector<VkDescriptorType> &bindings,
+		                                                      uint32_t pushSize = 0, uint32_t maxSets = 1);
+
+		/**
+		 * \brief Create a storage buffer for compute shaders to work on.
+		 *
+		 * The buffer belongs to the scene and is destroyed along with it.
+		 *
+		 * \param size Size of the buffer in bytes.
+		 * \param data [optional] Initial contents, uploaded before the next frame is drawn.
+		 * \param usage [optional] Additional uses, e.g. VK_BUFFER_USAGE_VERTEX_BUFFER_BIT for generated vertices.
+		 * \return Pointer to the new buffer.
+		 */
+		Vulkan::KVulkanBuffer *CreateStorageBuffer(VkDeviceSize size, const void *data = nullptr,
+		                                           VkBufferUsageFlags usage = 0);
+
+		/**
+		 * \brief Queue a compute dispatch for the next frame.
+		 *
+		 * Queued dispatches run in order at the start of the next frame, before anything is drawn.
+		 * Their writes are visible to the frame's draws, and they don't start before the previous
+		 * frames have finished reading. Queue again every frame for continuous work.
+		 *
+		 * \param pipeline Compute pipeline to dispatch.
+		 * \param set Descriptor set created by the pipeline.
+		 * \param groupsX Number of work groups in X.
+		 * \param groupsY [optional] Number of work groups in Y.
+		 * \param groupsZ [optional] Number of work groups in Z.
+		 * \param pushData [optional] Push constant data, copied right away.
+		 * \param pushSize [optional] Size of the push constant data in bytes.
+		 */
+		void Dispatch(Vulkan::KVulkanComputePipeline *pipeline, VkDescriptorSet set, uint32_t groupsX,
+		              uint32_t groupsY = 1, uint32_t groupsZ = 1, const void *pushData = nullptr,
+		              uint32_t pushSize = 0);
 	};
 }
 
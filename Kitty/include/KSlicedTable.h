@@ -0,0 +1,197 @@
+/**
+ * Kitty Engine
+ * KSlicedTable.h
+ *
+ * Host side table of entries which is mirrored into a GPU buffer with one
+ * slice per swap chain image. Every entry remembers the version it last
+ * changed in and every slice the version it was last written at, so a
+ * slice only copies the entries which changed since it was last drawn with.
+ *
+ * \author Krista Koivisto
+ * \copyright Read included LICENSE file.
+ */
+
+#ifndef KENGINE_KSLICEDTABLE_H
+#define KENGINE_KSLICEDTABLE_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace Kitty
+{
+	template <class T>
+	class KSlicedTable
+	{
+	private:
+		std::vector<T> entries = {};
+		std::vector<uint64_t> versions = {};
+		std::vector<uint64_t> sliceVersions = {};
+
+		// Version changed entries are marked with and the newest version any entry was marked with.
+		// Slices start out at version 0, which every entry is newer than.
+		uint64_t version = 1;
+		uint64_t changedVersion = 0;
+
+	public:
+		/**
+		 * \brief Get the number of entries.
+		 *
+		 * \return Number of entries.
+		 */
+		size_t Size() const { return entries.size(); };
+
+		/**
+		 * \brief Check whether the table has no entries.
+		 *
+		 * \return True if there are no entries.
+		 */
+		bool Empty() const { return entries.empty(); };
+
+		/**
+		 * \brief Get the host side copy of the entries.
+		 *
+		 * \return Pointer to the first entry.
+		 */
+		const T *Data() const { return entries.data(); };
+
+		/**
+		 * \brief Access an entry.
+		 *
+		 * Entries written through this must be marked as changed with Mark.
+		 *
+		 * \param index Index of the entry.
+		 * \return Reference to the entry.
+		 */
+		T &operator[](size_t index) { return entries[index]; };
+		const T &operator[](size_t index) const { return entries[index]; };
+
+		/**
+		 * \brief Change the number of entries.
+		 *
+		 * \param count New number of entries.
+		 * \param value [optional] Value of added entries, which are marked as changed.
+		 */
+		void Resize(size_t count, const T &value = T())
+		{
+			size_t previous = entries.size();
+
+			entries.resize(count, value);
+			versions.resize(count);
+			if (count > previous) Mark(previous, count);
+		}
+
+		/**
+		 * \brief Replace every entry.
+		 *
+		 * \param count Number of entries.
+		 * \param value Value of each entry.
+		 */
+		void Assign(size_t count, const T &value)
+		{
+			entries.assign(count, value);
+			versions.resize(count);
+			Mark(0, count);
+		}
+
+		/**
+		 * \brief Remove an entry.
+		 *
+		 * The entries after it move down a slot and are marked as changed.
+		 *
+		 * \param index Index of the entry.
+		 */
+		void Erase(size_t index)
+		{
+			entries.erase(entries.begin() + index);
+			versions.erase(versions.begin() + index);
+			Mark(index, entries.size());
+		}
+
+		/**
+		 * \brief Write an entry, marking it as changed if the value is new.
+		 *
+		 * \param index Index of the entry.
+		 * \param value Value to write.
+		 * \return True if the entry changed.
+		 */
+		bool Write(size_t index, const T &value)
+		{
+			if (memcmp(&entries[index], &value, sizeof(T)) == 0) return false;
+
+			entries[index] = value;
+			Mark(index, index + 1);
+
+			return true;
+		}
+
+		/**
+		 * \brief Mark a run of entries as changed.
+		 *
+		 * \param first Index of the first entry.
+		 * \param last Index one past the last entry.
+		 */
+		void Mark(size_t first, size_t last)
+		{
+			if (first >= last) return;
+
+			for (size_t i = first; i < last; ++i)
+			{
+				versions[i] = version;
+			}
+
+			changedVersion = version;
+		}
+
+		/**
+		 * \brief Mark every entry as changed.
+		 */
+		void MarkAll() { Mark(0, entries.size()); };
+
+		/**
+		 * \brief Forget what the slices hold.
+		 *
+		 * New buffers start out empty, so every entry has to be uploaded to every slice again.
+		 *
+		 * \param sliceCount Number of slices in the new buffer.
+		 */
+		void Reset(uint32_t sliceCount) { sliceVersions.assign(sliceCount, 0); };
+
+		/**
+		 * \brief Copy the entries which changed since a slice was last written to it.
+		 *
+		 * Runs of changed entries are copied at once.
+		 *
+		 * \param slice Slice to bring up to date.
+		 * \param destination Mapped memory of the slice.
+		 */
+		void Upload(uint32_t slice, void *destination)
+		{
+			uint64_t sliceVersion = sliceVersions[slice];
+			if (changedVersion <= sliceVersion) return;
+
+			auto target = static_cast<T *>(destination);
+			size_t count = entries.size();
+
+			for (size_t i = 0; i < count;)
+			{
+				if (versions[i] <= sliceVersion)
+				{
+					++i;
+					continue;
+				}
+
+				size_t first = i;
+				while (i < count && versions[i] > sliceVersion) ++i;
+
+				memcpy(target + first, entries.data() + first, (i - first) * sizeof(T));
+			}
+
+			// Entries marked from here on are newer than what the slice holds
+			sliceVersions[slice] = changedVersion;
+			if (changedVersion == version) ++version;
+		}
+	};
+}
+
+#endif //KENGINE_KSLICEDTABLE_H
@@ -0,0 +1,97 @@
+/**
+ * Kitty Engine
+ * KSpatialSort.h
+ *
+ * Spatial ordering for point data. Positions are mapped onto a 3D
+ * Morton curve, which interleaves the bits of their coordinates so
+ * points close to each other in the world get codes close to each
+ * other, and the codes are sorted with KRadixSort.
+ *
+ * \author Krista Koivisto
+ * \copyright Read included LICENSE file.
+ */
+
+#ifndef KENGINE_KSPATIALSORT_H
+#define KENGINE_KSPATIALSORT_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+#include "KJobRunner.h"
+#include "KRadixSort.h"
+
+namespace Kitty
+{
+	class KSpatialSort
+	{
+	private:
+		uint32_t threadCount = 1;
+		KJobRunner runner = nullptr;
+
+		glm::vec3 low = glm::vec3(0.0f);
+		glm::vec3 high = glm::vec3(0.0f);
+
+		// Codes carry the index of their position along as the payload
+		KRadixSort<uint32_t> sorter;
+
+	public:
+		/**
+		 * \brief Create a spatial sorter.
+		 *
+		 * \param threads [optional] Most threads to sort with, 0 to use one per available core.
+		 */
+		explicit KSpatialSort(uint32_t threads = 0);
+
+		/**
+		 * \brief Set what runs the blocks of large sorts in parallel.
+		 *
+		 * \param jobRunner Job runner, nullptr to sort on the calling thread.
+		 */
+		void SetJobRunner(KJobRunner jobRunner);
+
+		/**
+		 * \brief Get the Morton code of a position.
+		 *
+		 * Each axis is quantized to 10 bits within the given bounds, positions outside them
+		 * are clamped.
+		 *
+		 * \param position Position to encode.
+		 * \param low Smallest corner of the bounds.
+		 * \param high Largest corner of the bounds.
+		 * \return 30-bit Morton code.
+		 */
+		static uint32_t MortonCode(glm::vec3 position, glm::vec3 low, glm::vec3 high);
+
+		/**
+		 * \brief Sort positions along the Morton curve through their bounds.
+		 *
+		 * Codes are made in parallel blocks, the same ones the radix sort splits its passes
+		 * into. Stable, positions with equal codes stay in their original order.
+		 *
+		 * \param positions Positions to sort.
+		 * \param count Number of positions.
+		 * \return Indices of the positions in sorted order, valid until the next call.
+		 */
+		const std::vector<uint32_t> &Sort(const glm::vec3 *positions, uint32_t count);
+
+		/**
+		 * \brief Get the Morton codes of the last sorted positions.
+		 *
+		 * \return Codes in sorted order, valid until the next call to Sort.
+		 */
+		const std::vector<uint32_t> &GetCodes() const { return sorter.GetKeys(); };
+
+		/**
+		 * \brief Get the bounds the last sorted positions were encoded in.
+		 *
+		 * Codes for positions added to the sorted ones later must be made in the same bounds.
+		 *
+		 * \param boundsLow [out] Smallest corner of the bounds.
+		 * \param boundsHigh [out] Largest corner of the bounds.
+		 */
+		void GetBounds(glm::vec3 &boundsLow, glm::vec3 &boundsHigh) const { boundsLow = low; boundsHigh = high; };
+	};
+}
+
+
+#endif //KENGINE_KSPATIALSORT_H
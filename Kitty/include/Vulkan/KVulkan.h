@@ -14,10 +14,16 @@
 #ifndef KENGINE_KVULKAN_H
 #define KENGINE_KVULKAN_H
 
-#define KE_MAX_DYNAMIC_LIGHTS 128
+// Most lights a single light cluster holds, and so the most lights any one fragment is lit by
+#define KE_MAX_CLUSTER_LIGHTS 64
+// Lights selected per object when lighting objects by their nearest lights, matches the uvec4 in the shaders
+#define KE_MAX_OBJECT_LIGHTS 4
+// Consecutive instances sharing a light selection, matches INSTANCE_BUCKET_SIZE in instance.vert
+#define KE_INSTANCE_BUCKET_SIZE 64
 
 #include <iostream>
 #include <algorithm>
+#include <cstring>
 #include <vulkan/vulkan.h>
 #include "KVulkanDefaults.h"
 #include "KVulkanDevice.h"
@@ -32,6 +38,9 @@
 #include "../IWindow.h"
 #include "../KError.h"
 #include "KVulkanImage.h"
+#include "KVulkanTransfer.h"
+#include "KVulkanCommandRecorder.h"
+#include "KVulkanComputePipeline.h"
 
 using namespace Kitty::Error;
 
@@ -48,6 +57,9 @@ namespace Kitty
 		class KVulkanCommandPool;
 		class KVulkanImage;
 		class KVulkanImageView;
+		class KVulkanTransfer;
+		class KVulkanCommandRecorder;
+		class KVulkanComputePipeline;
 
 		//! Requested validation layers
 		const std::vector<const char *> validationLayers = {"VK_LAYER_LUNARG_standard_validation"};
@@ -96,6 +108,37 @@ namespace Kitty
 			 */
 			KError InitializeDevice();
 
+			/**
+			 * \brief Initialize the transfer manager used for uploading data to the GPU.
+			 *
+			 * \return KE_OK on success, error code on fail.
+			 */
+			KError InitializeTransfer();
+
+			/**
+			 * \brief Initialize the threads used for recording command buffers in parallel.
+			 *
+			 * \return KE_OK on success, error code on fail.
+			 */
+			KError InitializeRecorder();
+
+			/**
+			 * \brief Initialize the pipeline cache, loading it from disk if a usable one exists.
+			 *
+			 * \return KE_OK on success, error code on fail.
+			 */
+			KError InitializePipelineCache();
+
+			/**
+			 * \brief Get the file the pipeline cache is kept in.
+			 *
+			 * The name includes the pipeline cache UUID and driver version, so a driver update
+			 * or a different GPU never picks up an incompatible cache.
+			 *
+			 * \return Path to the cache file, empty if the cache is not kept on disk.
+			 */
+			std::string GetPipelineCacheFilename();
+
 			/**
 			 * \brief Initialize main swap chain instance.
 			 *
@@ -145,13 +188,15 @@ namespace Kitty
 			KError InitializeCommandPools();
 
 			/**
-			 * \brief Initialize semaphores.
+			 * \brief Initialize per frame resources.
 			 *
-			 * Semaphores are used for synchronizing Vulkan operations.
+			 * Each frame in flight gets its own fence, semaphores and command pool so the CPU can
+			 * prepare one frame while the GPU is still busy with the previous ones. The pool is
+			 * transient and reset as a whole every time its frame comes around again.
 			 *
 			 * \return KE_OK on success, error code on fail.
 			 */
-			KError InitializeSemaphores();
+			KError InitializeFrames();
 
 			/**
 			 * \brief Initialize the depth buffer.
@@ -160,6 +205,16 @@ namespace Kitty
 			 */
 			KError InitializeDepthBuffer();
 
+			/**
+			 * \brief Initialize the G-buffer used for deferred shading.
+			 *
+			 * Does nothing unless deferred shading is enabled. Needs the depth buffer, which the
+			 * lighting pass reads along with the G-buffer.
+			 *
+			 * \return KE_OK on success, error code on fail.
+			 */
+			KError InitializeGBuffer();
+
 			/**
 			 * \brief Get all available Vulkan extensions.
 			 *
@@ -222,6 +277,21 @@ namespace Kitty
 			 */
 			void DestroySwapChain();
 
+			/**
+			 * \brief Destroy per frame resources.
+			 */
+			void DestroyFrames();
+
+			/**
+			 * \brief Destroy the G-buffer images and the descriptor set reading them.
+			 */
+			void DestroyGBuffer();
+
+			/**
+			 * \brief Destroy all graphics pipelines.
+			 */
+			void DestroyPipelines();
+
 			/**
 			 * \brief Validation layer debug callback.
 			 *
@@ -265,13 +335,24 @@ namespace Kitty
 			KVulkanRenderPass *mainRenderPass = nullptr;
 			KVulkanGraphicsPipeline *mainPipeline = nullptr;
 			KVulkanGraphicsPipeline *instancePipeline = nullptr;
+			KVulkanGraphicsPipeline *lightingPipeline = nullptr;
+			KVulkanGraphicsPipeline *depthPipeline = nullptr;
+			KVulkanGraphicsPipeline *depthInstancePipeline = nullptr;
 			KVulkanFramebuffer *frameBuffer = nullptr;
 			KVulkanCommandPool *cmdPool = nullptr;
 			KVulkanCommandPool *transferCmdPool = nullptr;
+			KVulkanTransfer *transfer = nullptr;
+			KVulkanCommandRecorder *recorder = nullptr;
+			VkPipelineCache pipelineCache = VK_NULL_HANDLE;
 			KVulkanImage *depthImage = nullptr;
 			KVulkanImageView *depthImageView = nullptr;
-			VkSemaphore imageAvailableSemaphore = {};
-			VkSemaphore renderFinishedSemaphore = {};
+			std::vector<KVulkanImage*> gBufferImages = {};
+			std::vector<KVulkanImageView*> gBufferImageViews = {};
+			KVulkanDescriptorPool *gBufferDescPool = nullptr;
+			VkDescriptorSet gBufferDescriptorSet = VK_NULL_HANDLE;
+			std::vector<KVulkanFrame> frames = {};
+			std::vector<VkFence> imagesInFlight = {};
+			uint32_t currentFrame = 0;
 			VkInstance instance = VK_NULL_HANDLE;
 			VkDebugReportCallbackEXT callback = VK_NULL_HANDLE;
 			VkSurfaceKHR surface = VK_NULL_HANDLE;
@@ -279,7 +360,8 @@ namespace Kitty
 			VkDescriptorSetLayout lightsDescriptorLayout = {};
 			VkDescriptorSetLayout vertexDescriptorLayout = {};
 			VkDescriptorSetLayout fragmentDescriptorLayout = {};
-			VkDescriptorSetLayout vxUniformBufferDescriptorLayout = {};
+			VkDescriptorSetLayout objectDescriptorLayout = {};
+			VkDescriptorSetLayout gBufferDescriptorLayout = {};
 
 			/**
 			 * \brief Instruct Vulkan to draw the next frame.
@@ -291,6 +373,14 @@ namespace Kitty
 			 */
 			void FinishDrawing();
 
+			/**
+			 * \brief Write the pipeline cache to disk.
+			 *
+			 * Happens automatically on shutdown, but can be called earlier to make sure freshly
+			 * built pipelines survive a crash.
+			 */
+			void SavePipelineCache();
+
 			/**
 			 * \brief Reinitialize main command pool.
 			 *
@@ -312,9 +402,39 @@ namespace Kitty
 			 * \brief Recreate the swap chain.
 			 *
 			 * This needs to be done every time the extents need to change. For example when the
-			 * window size or resolution has changed.
+			 * window size or resolution has changed. The old swap chain is handed over to the new
+			 * one and only the size dependent images and framebuffers are rebuilt, the render pass
+			 * and pipelines are kept unless the surface format changed.
 			 */
 			void RecreateSwapChain();
+
+			/**
+			 * \brief Change the number of command recording threads.
+			 *
+			 * Replaces the recorder and records the command buffers again with the new thread count.
+			 *
+			 * \param threadCount Number of worker threads, 0 to use one per available core.
+			 */
+			void SetRecordingThreads(uint32_t threadCount);
+
+			/**
+			 * \brief Recreate the graphics pipelines.
+			 *
+			 * This needs to be done when the descriptor layouts or shaders the pipelines were built
+			 * with have changed.
+			 */
+			void RecreatePipelines();
+
+			/**
+			 * \brief Record the viewport and scissor for the current swap chain extent.
+			 *
+			 * Viewport and scissor are dynamic pipeline state, so every command buffer drawing
+			 * with the graphics pipelines needs to set them. Secondary command buffers don't
+			 * inherit them from the primary buffer executing them.
+			 *
+			 * \param buf Command buffer to record into.
+			 */
+			void SetDynamicState(VkCommandBuffer buf);
 		};
 	}
 }
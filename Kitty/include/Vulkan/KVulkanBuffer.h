@@ -102,11 +102,43 @@ namespace Kitty
 			/**
 			 * \brief Copy the contents of another buffer into this.
 			 *
+			 * Blocks until the copy has completed, so the source buffer may be deleted right after.
+			 *
 			 * \param srcBuffer Source buffer.
 			 * \param copyRegion [optional] Region of data to copy.
 			 */
 			void Copy(KVulkanBuffer *srcBuffer, VkBufferCopy copyRegion = {});
 
+			/**
+			 * \brief Upload host data to the buffer through the transfer manager.
+			 *
+			 * Does not block, the data is staged right away and copied when the transfer manager
+			 * is flushed. Device local buffers should be filled this way.
+			 *
+			 * \param data Data to upload.
+			 * \param dataSize Size of the data in bytes.
+			 * \param offset [optional] Offset into this buffer.
+			 * \return Transfer ticket which can be waited on for completion.
+			 */
+			uint64_t Upload(const void *data, VkDeviceSize dataSize, VkDeviceSize offset = 0);
+
+			/**
+			 * \brief Describe (part of) the buffer for binding it to a descriptor.
+			 *
+			 * \param offset [optional] Offset of the range in bytes.
+			 * \param range [optional] Size of the range in bytes, the rest of the buffer by default.
+			 * \return Descriptor buffer info for the range.
+			 */
+			VkDescriptorBufferInfo GetDescriptorInfo(VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE)
+			{
+				VkDescriptorBufferInfo info = {};
+				info.buffer = buffer;
+				info.offset = offset;
+				info.range = range;
+
+				return info;
+			}
+
 			/**
 			 * \brief Tries to find a suitable memory type for the buffer to be created with.
 			 *
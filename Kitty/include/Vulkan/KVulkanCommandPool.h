@@ -32,6 +32,14 @@ namespace Kitty
 		private:
 			KVulkan *context;
 			KVulkanDefaults defaults;
+			KVulkanCommandSettings *commandSettings = nullptr;
+
+			// Batches which need to be re-recorded, per swap chain image
+			std::vector<std::vector<uint32_t>> dirtyBatches = {};
+
+			// Primary buffers which need to be re-recorded even without dirty batches, per swap chain image.
+			// The deferred lighting subpass is recorded straight into them.
+			std::vector<bool> stalePrimaries = {};
 
 			/**
 			 * \brief Create command buffers.
@@ -41,12 +49,22 @@ namespace Kitty
 			 */
 			bool CreateCommandBuffers(VkCommandBufferAllocateInfo *allocInfo = nullptr);
 
+			/**
+			 * \brief Record the primary command buffer for a swap chain image.
+			 *
+			 * Executes the secondary buffers already recorded for the image, if any.
+			 *
+			 * \param imageIndex Index of the swap chain image.
+			 */
+			void RecordGraphicsBuffer(uint32_t imageIndex);
+
 		public:
 			explicit KVulkanCommandPool(KVulkan *mainContext, KVulkanCommandSettings *settings);
 			~KVulkanCommandPool();
 
 			VkCommandPool commandPool = {};
 			std::vector<VkCommandBuffer> commandBuffers = {};
+			std::vector<std::vector<VkCommandBuffer>> secondaryBuffers = {};
 			VkRenderPassBeginInfo renderPassBeginInfo = {};
 
 			/**
@@ -57,6 +75,32 @@ namespace Kitty
 			 */
 			KError InitializeGraphicsBuffer(KVulkanCommandSettings *settings = nullptr);
 
+			/**
+			 * \brief Mark a batch as changed so it gets re-recorded.
+			 *
+			 * Only the batch itself and the primary buffers executing it are re-recorded, and
+			 * only once the GPU is done with each swap chain image's previous frame.
+			 *
+			 * \param batch Index of the batch.
+			 */
+			void InvalidateBatch(uint32_t batch);
+
+			/**
+			 * \brief Mark every batch as changed so they all get re-recorded.
+			 *
+			 * The primary buffers are re-recorded too, even when there are no batches.
+			 */
+			void InvalidateAllBatches();
+
+			/**
+			 * \brief Re-record any changed batches for a swap chain image.
+			 *
+			 * The GPU must no longer be using the image's command buffers.
+			 *
+			 * \param imageIndex Index of the swap chain image.
+			 */
+			void UpdateGraphicsBuffer(uint32_t imageIndex);
+
 			/**
 			 * \brief Initialize the transfer command pool.
 			 *
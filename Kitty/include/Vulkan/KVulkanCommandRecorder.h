@@ -0,0 +1,186 @@
+/**
+ * Kitty engine Vulkan implementation
+ * KVulkanCommandRecorder.h
+ *
+ * Multithreaded command recorder for the Kitty graphics engine. Work
+ * is split into batches which are recorded into secondary command
+ * buffers by a set of worker threads, each with its own command pool.
+ * This functions as an abstraction layer between Vulkan and the Kitty
+ * engine, direct access from the end user interface should never
+ * happen.
+ *
+ * \author Krista Koivisto
+ * \copyright Read included LICENSE file.
+ */
+
+#ifndef KENGINE_KVULKANCOMMANDRECORDER_H
+#define KENGINE_KVULKANCOMMANDRECORDER_H
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "KVulkan.h"
+#include "../KError.h"
+
+using namespace Kitty::Error;
+
+namespace Kitty
+{
+	namespace Vulkan
+	{
+		class KVulkan;
+
+		class KVulkanCommandRecorder
+		{
+		private:
+			//! A worker thread and the command pool only it records from.
+			struct KRecordWorker
+			{
+				std::thread thread;
+				VkCommandPool commandPool = VK_NULL_HANDLE;
+				std::vector<VkCommandBuffer> commandBuffers = {};
+				std::vector<VkCommandBuffer> freeBuffers = {};
+			};
+
+			KVulkan *context = nullptr;
+			VkDevice device = VK_NULL_HANDLE;
+
+			std::vector<KRecordWorker*> workers = {};
+			std::unordered_map<VkCommandBuffer, KRecordWorker*> owners = {};
+
+			// Current job, shared with the workers
+			std::mutex jobMutex;
+			std::condition_variable jobReady;
+			std::condition_variable jobDone;
+			uint64_t jobGeneration = 0;
+			uint32_t workersBusy = 0;
+			bool stopping = false;
+
+			std::function<void(VkCommandBuffer buf, uint32_t batch)> jobCallback = nullptr;
+			std::function<void(uint32_t job)> jobTask = nullptr; // Set instead of the callback for plain jobs
+			VkCommandBufferInheritanceInfo jobInheritance = {};
+			std::vector<VkCommandBuffer> *jobResults = nullptr;
+			std::atomic<uint32_t> nextBatch;
+			uint32_t batchCount = 0;
+			std::exception_ptr jobError = nullptr;
+
+			double lastRecordTime = 0.0;
+
+			/**
+			 * \brief Worker thread main loop.
+			 *
+			 * \param worker The worker this thread belongs to.
+			 */
+			void WorkerLoop(KRecordWorker *worker);
+
+			/**
+			 * \brief Hand the current job out to the workers and wait for them to finish it.
+			 *
+			 * \param lock Lock held on the job mutex.
+			 * \param count Number of batches or plain jobs.
+			 */
+			void Dispatch(std::unique_lock<std::mutex> &lock, uint32_t count);
+
+			/**
+			 * \brief Record batches of the current job until there are none left.
+			 *
+			 * \param worker The worker doing the recording.
+			 */
+			void RecordBatches(KRecordWorker *worker);
+
+			/**
+			 * \brief Run plain jobs until there are none left.
+			 */
+			void RunJobs();
+
+			/**
+			 * \brief Get an unused secondary command buffer from a worker's pool.
+			 *
+			 * Must only be called from the thread owning the worker.
+			 *
+			 * \param worker Worker whose pool to use.
+			 * \return Command buffer ready to begin recording.
+			 */
+			VkCommandBuffer GetCommandBuffer(KRecordWorker *worker);
+
+		public:
+			/**
+			 * \brief Create a command recorder.
+			 *
+			 * \param mainContext Parent Vulkan context.
+			 * \param threadCount Number of worker threads, 0 to use one per available core.
+			 */
+			explicit KVulkanCommandRecorder(KVulkan *mainContext, uint32_t threadCount = 0);
+			~KVulkanCommandRecorder();
+
+			/**
+			 * \brief Record batches of commands into secondary command buffers in parallel.
+			 *
+			 * Batches are handed out to the worker threads as they become free, so the callback
+			 * must be safe to call from several threads at once. The buffers continue the given
+			 * render pass and stay valid until they are released or the next call to Reset.
+			 *
+			 * \param count Number of batches.
+			 * \param renderPass Render pass the buffers will be executed in.
+			 * \param framebuffer [optional] Framebuffer the buffers will be executed in, if known.
+			 * \param callback Function recording a single batch.
+			 * \return Recorded secondary command buffers, in batch order.
+			 */
+			std::vector<VkCommandBuffer> Record(uint32_t count, VkRenderPass renderPass, VkFramebuffer framebuffer,
+			                                    std::function<void(VkCommandBuffer buf, uint32_t batch)> callback);
+
+			/**
+			 * \brief Run jobs which don't record anything on the worker threads.
+			 *
+			 * Jobs are handed out like batches, so the callback must be safe to call from several
+			 * threads at once. Returns once every job has finished.
+			 *
+			 * \param count Number of jobs.
+			 * \param callback Function running a single job.
+			 */
+			void Run(uint32_t count, std::function<void(uint32_t job)> callback);
+
+			/**
+			 * \brief Give a single command buffer back to be reused.
+			 *
+			 * The GPU must no longer be using it.
+			 *
+			 * \param buf Command buffer returned by Record.
+			 */
+			void Release(VkCommandBuffer buf);
+
+			/**
+			 * \brief Recycle every command buffer recorded so far.
+			 *
+			 * The GPU must no longer be using any of them.
+			 */
+			void Reset();
+
+			/**
+			 * \brief Get the number of worker threads.
+			 *
+			 * \return Number of worker threads.
+			 */
+			uint32_t GetThreadCount() { return static_cast<uint32_t>(workers.size()); };
+
+			/**
+			 * \brief Get how long the last call to Record took.
+			 *
+			 * Handy for measuring how recording scales with the number of threads.
+			 *
+			 * \return Wall clock time in milliseconds.
+			 */
+			double GetLastRecordTime() { return lastRecordTime; };
+		};
+	}
+}
+
+
+#endif //KENGINE_KVULKANCOMMANDRECORDER_H
@@ -0,0 +1,98 @@
+/**
+ * Kitty engine Vulkan implementation
+ * KVulkanComputePipeline.h
+ *
+ * Vulkan compute pipeline implementation for the Kitty graphics
+ * engine. Each pipeline runs a single compute shader whose set 0
+ * bindings are described on creation, and owns a small descriptor
+ * pool for the sets it is dispatched with. This functions as an
+ * abstraction layer between Vulkan and the Kitty engine, direct
+ * access from the end user interface should never happen.
+ *
+ * \author Krista Koivisto
+ * \copyright Read included LICENSE file.
+ */
+
+#ifndef KENGINE_KVULKANCOMPUTEPIPELINE_H
+#define KENGINE_KVULKANCOMPUTEPIPELINE_H
+
+#include <vulkan/vulkan.h>
+#include <string>
+#include <vector>
+#include "KVulkan.h"
+#include "KVulkanDescriptorPool.h"
+#include "../KHelper.h"
+#include "../KError.h"
+
+using namespace Kitty::Error;
+
+namespace Kitty
+{
+	namespace Vulkan
+	{
+		class KVulkan;
+		class KVulkanDescriptorPool;
+
+		class KVulkanComputePipeline
+		{
+		private:
+			KVulkan *context = nullptr;
+			KVulkanDescriptorPool *descPool = nullptr;
+
+			std::vector<VkDescriptorType> bindingTypes = {};
+			uint32_t pushConstantSize = 0;
+
+		public:
+			/**
+			 * \brief Create a compute pipeline.
+			 *
+			 * \param mainContext Parent Vulkan context.
+			 */
+			explicit KVulkanComputePipeline(KVulkan *mainContext) : context(mainContext) {}
+			~KVulkanComputePipeline();
+
+			VkDescriptorSetLayout descriptorLayout = VK_NULL_HANDLE;
+			VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+			VkPipeline computePipeline = VK_NULL_HANDLE;
+
+			/**
+			 * \brief Initialize the compute pipeline.
+			 *
+			 * \param shader Path to the compiled compute shader.
+			 * \param bindings Descriptor type of each set 0 binding, in binding order.
+			 * \param pushSize [optional] Size of the shader's push constant block in bytes.
+			 * \param maxSets [optional] How many descriptor sets can be created for the pipeline.
+			 * \return KE_OK on success, error code on fail.
+			 */
+			KError Initialize(const std::string &shader, const std::vector<VkDescriptorType> &bindings,
+			                  uint32_t pushSize = 0, uint32_t maxSets = 1);
+
+			/**
+			 * \brief Create a descriptor set for dispatching the pipeline with.
+			 *
+			 * \param buffers Buffer bound to each binding, in binding order.
+			 * \return The new descriptor set, freed along with the pipeline.
+			 */
+			VkDescriptorSet CreateDescriptorSet(const std::vector<VkDescriptorBufferInfo> &buffers);
+
+			/**
+			 * \brief Record a dispatch of the pipeline.
+			 *
+			 * No barriers are recorded, synchronizing with whatever reads or writes the same
+			 * buffers is up to the caller.
+			 *
+			 * \param buf Command buffer to record into.
+			 * \param set Descriptor set created by CreateDescriptorSet.
+			 * \param groupsX Number of work groups in X.
+			 * \param groupsY Number of work groups in Y.
+			 * \param groupsZ Number of work groups in Z.
+			 * \param pushData [optional] Push constant data, must be the size given on initialization.
+			 */
+			void Dispatch(VkCommandBuffer buf, VkDescriptorSet set, uint32_t groupsX, uint32_t groupsY,
+			              uint32_t groupsZ, const void *pushData = nullptr);
+		};
+	}
+}
+
+
+#endif //KENGINE_KVULKANCOMPUTEPIPELINE_H
@@ -61,8 +61,13 @@ namespace Kitty
 			KVulkanGraphicsSettings graphicsPipelineInfo = {};
 			VkDescriptorSetLayoutBinding vertexLayoutBinding = {};
 			VkDescriptorSetLayoutBinding fragmentShaderBinding = {};
-			VkDescriptorSetLayoutBinding vxUniformLayoutBinding = {};
+			VkDescriptorSetLayoutBinding objectTableLayoutBinding = {};
+			VkDescriptorSetLayoutBinding drawOrderLayoutBinding = {};
+			VkDescriptorSetLayoutBinding materialTableLayoutBinding = {};
 			VkDescriptorSetLayoutBinding lightsLayoutBinding = {};
+			VkDescriptorSetLayoutBinding clusterGridLayoutBinding = {};
+			VkDescriptorSetLayoutBinding clusterLightsLayoutBinding = {};
+			VkDescriptorSetLayoutBinding bucketLightsLayoutBinding = {};
 			VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
 			VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
 			VkViewport viewport = {};
@@ -75,6 +80,7 @@ namespace Kitty
 			VkDescriptorSetLayoutCreateInfo layoutInfo = {};
 			VkPushConstantRange pushConstantRange = {};
 			VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+			VkPipelineDynamicStateCreateInfo dynamicState = {};
 			VkGraphicsPipelineCreateInfo pipelineInfo = {};
 			VkAttachmentDescription colorAttachment = {};
 			VkAttachmentReference colorAttachmentRef = {};
@@ -212,6 +218,11 @@ namespace Kitty
 				vulkanSettings.swapChainCreateInfo = swapChainCreateInfo;
 				vulkanSettings.framebufferInfo = framebufferInfo;
 				vulkanSettings.textureSamplerInfo = textureSamplerInfo;
+				vulkanSettings.transferStagingSize = 32 * 1024 * 1024;
+				vulkanSettings.framesInFlight = 2;
+				vulkanSettings.recordingThreads = 0;
+				vulkanSettings.pipelineCacheDirectory = ".";
+				vulkanSettings.swapChainResizeDelay = 100;
 
 				vulkanSettings.outdatedSwapChainCallback = nullptr;
 
@@ -221,6 +232,9 @@ namespace Kitty
 				vulkanSettings.commands.graphicsCmdBufferInfo = graphicsCmdBufferInfo;
 				vulkanSettings.commands.renderPassInfo = renderPassInfo;
 				vulkanSettings.commands.graphicsCmdPoolOverride = nullptr;
+				vulkanSettings.commands.sceneBatchRenderCallback = nullptr;
+				vulkanSettings.commands.sceneBatchCount = nullptr;
+				vulkanSettings.commands.sceneLightingRenderCallback = nullptr;
 			}
 
 			void GraphicsPipelineSettings()
@@ -247,6 +261,11 @@ namespace Kitty
 				viewportState.viewportCount = 1;
 				viewportState.scissorCount = 1;
 
+				// Count without states means viewport and scissor, filled in when the pipeline is created
+				dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+				dynamicState.dynamicStateCount = 2;
+				dynamicState.pDynamicStates = nullptr;
+
 				rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
 				rasterizer.depthClampEnable = VK_FALSE;
 				rasterizer.rasterizerDiscardEnable = VK_FALSE;
@@ -278,22 +297,51 @@ namespace Kitty
 				vertexLayoutBinding.binding = 0;
 				vertexLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 				vertexLayoutBinding.descriptorCount = 1;
-				vertexLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+				// The deferred lighting pass reconstructs positions from depth with the inverse matrices
+				vertexLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
 
 				lightsLayoutBinding.binding = 0;
-				lightsLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+				lightsLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
 				lightsLayoutBinding.descriptorCount = 1;
 				lightsLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
+				// Light clusters live in the same set as the lights they index
+				clusterGridLayoutBinding.binding = 1;
+				clusterGridLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				clusterGridLayoutBinding.descriptorCount = 1;
+				clusterGridLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+				clusterLightsLayoutBinding.binding = 2;
+				clusterLightsLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				clusterLightsLayoutBinding.descriptorCount = 1;
+				clusterLightsLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+				// Lights selected per bucket of instances are passed on by the vertex shader
+				bucketLightsLayoutBinding.binding = 3;
+				bucketLightsLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				bucketLightsLayoutBinding.descriptorCount = 1;
+				bucketLightsLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
 				fragmentShaderBinding.binding = 0;
 				fragmentShaderBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 				fragmentShaderBinding.descriptorCount = 1;
 				fragmentShaderBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
-				vxUniformLayoutBinding.binding = 0;
-				vxUniformLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-				vxUniformLayoutBinding.descriptorCount = 1;
-				vxUniformLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+				// Objects are looked up in the object table by draw order position or instance parent
+				objectTableLayoutBinding.binding = 0;
+				objectTableLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				objectTableLayoutBinding.descriptorCount = 1;
+				objectTableLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+				drawOrderLayoutBinding.binding = 1;
+				drawOrderLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				drawOrderLayoutBinding.descriptorCount = 1;
+				drawOrderLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+				materialTableLayoutBinding.binding = 2;
+				materialTableLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				materialTableLayoutBinding.descriptorCount = 1;
+				materialTableLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
 				layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
 
@@ -327,10 +375,17 @@ namespace Kitty
 
 				dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
 				dependency.dstSubpass = 0;
-				dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-				dependency.srcAccessMask = 0;
-				dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-				dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+				dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+				                          VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+				                          VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+				// With several frames in flight the previous frame may still be writing the
+				// shared depth buffer (and the color image) when this one starts clearing them.
+				dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+				                           VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+				dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+				                          VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+				dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+				                           VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
 				depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
 				depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
@@ -358,8 +413,13 @@ namespace Kitty
 				graphicsPipelineInfo.layoutInfo = layoutInfo;
 				graphicsPipelineInfo.vertexShaderBinding = vertexLayoutBinding;
 				graphicsPipelineInfo.fragmentShaderBinding = fragmentShaderBinding;
-				graphicsPipelineInfo.vxUniformLayoutBinding = vxUniformLayoutBinding;
+				graphicsPipelineInfo.objectTableLayoutBinding = objectTableLayoutBinding;
+				graphicsPipelineInfo.drawOrderLayoutBinding = drawOrderLayoutBinding;
+				graphicsPipelineInfo.materialTableLayoutBinding = materialTableLayoutBinding;
 				graphicsPipelineInfo.lightsLayoutBinding = lightsLayoutBinding;
+				graphicsPipelineInfo.clusterGridLayoutBinding = clusterGridLayoutBinding;
+				graphicsPipelineInfo.clusterLightsLayoutBinding = clusterLightsLayoutBinding;
+				graphicsPipelineInfo.bucketLightsLayoutBinding = bucketLightsLayoutBinding;
 				graphicsPipelineInfo.pipelineInfo = pipelineInfo;
 				graphicsPipelineInfo.pushConstantRange = pushConstantRange;
 				graphicsPipelineInfo.pipelineLayoutInfo = pipelineLayoutInfo;
@@ -371,6 +431,7 @@ namespace Kitty
 				graphicsPipelineInfo.scissor = scissor;
 				graphicsPipelineInfo.inputAssembly = inputAssembly;
 				graphicsPipelineInfo.viewport = viewport;
+				graphicsPipelineInfo.dynamicState = dynamicState;
 				graphicsPipelineInfo.vertexInputInfo = vertexInputInfo;
 				graphicsPipelineInfo.colorAttachment = colorAttachment;
 				graphicsPipelineInfo.colorAttachmentRef = colorAttachmentRef;
@@ -384,6 +445,18 @@ namespace Kitty
 				graphicsPipelineInfo.vertexShaders = { "Shaders/Compiled/uber.vert.spv" };
 				graphicsPipelineInfo.fragmentShaders = { "Shaders/Compiled/uber.frag.spv" };
 				graphicsPipelineInfo.instanceVertexShaders = { "Shaders/Compiled/instance.vert.spv" };
+				graphicsPipelineInfo.depthVertexShaders = { "Shaders/Compiled/depth.vert.spv" };
+				graphicsPipelineInfo.depthInstanceVertexShaders = { "Shaders/Compiled/depthinstance.vert.spv" };
+				graphicsPipelineInfo.gBufferFragmentShaders = { "Shaders/Compiled/gbuffer.frag.spv" };
+				graphicsPipelineInfo.lightingVertexShaders = { "Shaders/Compiled/deferred.vert.spv" };
+				graphicsPipelineInfo.lightingFragmentShaders = { "Shaders/Compiled/deferred.frag.spv" };
+
+				// Normals and material parameters need more precision than colors
+				graphicsPipelineInfo.gBufferFormats = { VK_FORMAT_R8G8B8A8_UNORM,
+				                                        VK_FORMAT_R16G16B16A16_SFLOAT,
+				                                        VK_FORMAT_R16G16B16A16_SFLOAT };
+				graphicsPipelineInfo.deferredShading = false;
+				graphicsPipelineInfo.depthPrePass = false;
 
 				graphicsPipelineInfo.descriptorPoolSizes = descriptorPoolSizes;
 			}
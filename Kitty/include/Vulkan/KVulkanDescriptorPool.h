@@ -33,8 +33,11 @@ namespace Kitty
 			 * \brief Create a descriptor pool.
 			 *
 			 * \param mainContext Parent Vulkan context.
+			 * \param poolSizes Number of descriptors of each type the pool holds.
+			 * \param maxSets [optional] Maximum number of sets, 0 allows one set per descriptor.
 			 */
-			explicit KVulkanDescriptorPool(KVulkan *mainContext, std::vector<VkDescriptorPoolSize> poolSizes);
+			explicit KVulkanDescriptorPool(KVulkan *mainContext, std::vector<VkDescriptorPoolSize> poolSizes,
+			                               uint32_t maxSets = 0);
 			~KVulkanDescriptorPool();
 
 			VkDescriptorPool descriptorPool = {};
@@ -48,6 +51,16 @@ namespace Kitty
 			 */
 			bool InitializeBinding(VkDescriptorSetLayoutBinding *binding, VkDescriptorSetLayout *layout);
 
+			/**
+			 * \brief Create a descriptor set layout from several bindings.
+			 *
+			 * \param bindings [in] Bindings the layout consists of.
+			 * \param layout [out] Which layout should be initialized?
+			 * \return true on success, false on fail.
+			 */
+			bool InitializeBindings(const std::vector<VkDescriptorSetLayoutBinding> &bindings,
+			                        VkDescriptorSetLayout *layout);
+
 			/**
 			 * \brief Allocate a descriptor from the descriptor pool.
 			 *
@@ -66,6 +79,45 @@ namespace Kitty
 			                        VkDescriptorBufferInfo *bufferInfo,
 			                        uint32_t binding = 0,
 			                        uint32_t descCount = 1);
+
+			/**
+			 * \brief Allocate a descriptor set with one buffer bound to each of its bindings.
+			 *
+			 * \param layout Set layout to be given to the descriptor set.
+			 * \param descriptorSet Descriptor set to allocate.
+			 * \param types Descriptor type of each binding, in binding order.
+			 * \param bufferInfos Buffer bound to each binding, in binding order.
+			 */
+			void AllocateBufferDescriptors(VkDescriptorSetLayout *layout,
+			                               VkDescriptorSet *descriptorSet,
+			                               const std::vector<VkDescriptorType> &types,
+			                               const std::vector<VkDescriptorBufferInfo> &bufferInfos);
+
+			/**
+			 * \brief Point one binding of an existing descriptor set at another buffer.
+			 *
+			 * Command buffers which bound the set have to be recorded again before they are used.
+			 *
+			 * \param descriptorSet Descriptor set to update.
+			 * \param type Descriptor type of the binding.
+			 * \param binding Binding to update.
+			 * \param bufferInfo Buffer to bind.
+			 */
+			void UpdateBufferDescriptor(VkDescriptorSet descriptorSet, VkDescriptorType type, uint32_t binding,
+			                            const VkDescriptorBufferInfo &bufferInfo);
+
+			/**
+			 * \brief Allocate a descriptor set with one image bound to each of its bindings.
+			 *
+			 * \param layout Set layout to be given to the descriptor set.
+			 * \param descriptorSet Descriptor set to allocate.
+			 * \param types Descriptor type of each binding, in binding order.
+			 * \param imageInfos Image bound to each binding, in binding order.
+			 */
+			void AllocateImageDescriptors(VkDescriptorSetLayout *layout,
+			                              VkDescriptorSet *descriptorSet,
+			                              const std::vector<VkDescriptorType> &types,
+			                              const std::vector<VkDescriptorImageInfo> &imageInfos);
 		};
 	}
 }
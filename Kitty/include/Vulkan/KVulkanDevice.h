@@ -45,6 +45,12 @@ namespace Kitty
 			{
 				//! Device ID
 				uint32_t id = 0;
+				//! Vendor ID
+				uint32_t vendorId = 0;
+				//! Vendor specific driver version
+				uint32_t driverVersion = 0;
+				//! Identifies which pipeline caches the device and driver can use
+				uint8_t pipelineCacheUUID[VK_UUID_SIZE] = {};
 				//! Device name
 				std::string name = "";
 				//! Is this a discrete (external, dedicated) or internal GPU?
@@ -15,6 +15,9 @@
 #define KENGINE_KVULKANGRAPHICSPIPELINE_H
 
 #include <vulkan/vulkan.h>
+#include <array>
+#include <cstddef>
+#include <unordered_map>
 #include "KVulkan.h"
 #include "KVulkanDefaults.h"
 #include "KVulkanHelpers.h"
@@ -39,6 +42,9 @@ namespace Kitty
 			std::vector<VkShaderModule> fragShaders;
 			std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
 
+			//! Pipeline variants by variant key, all sharing the same layout.
+			std::unordered_map<uint64_t, VkPipeline> variants = {};
+
 			/**
 			 * \brief Load all needed shaders.
 			 *
@@ -58,6 +64,17 @@ namespace Kitty
 			 */
 			void InitializeShaderData(std::string filename, VkShaderStageFlagBits shaderStage);
 
+			/**
+			 * \brief Create a variant of the pipeline with its features specialized into the fragment shaders.
+			 *
+			 * \param pipelineInfo Creation info of the default pipeline.
+			 * \param variant Shader features of the variant.
+			 * \param pipeline [out] The created pipeline.
+			 * \return true on success, false on fail.
+			 */
+			bool CreateVariant(VkGraphicsPipelineCreateInfo pipelineInfo, const KVulkanShaderVariant &variant,
+			                   VkPipeline *pipeline);
+
 		public:
 			explicit KVulkanGraphicsPipeline(KVulkan *mainContext) : context(mainContext) {}
 			~KVulkanGraphicsPipeline();
@@ -73,6 +90,17 @@ namespace Kitty
 			 */
 			KError Initialize(KVulkanGraphicsSettings *createInfo = nullptr);
 
+			/**
+			 * \brief Get the pipeline compiled for a set of shader features.
+			 *
+			 * Only variants listed in KVulkanGraphicsSettings::shaderVariants are built, so this is
+			 * a lookup and safe to call from several recording threads at once.
+			 *
+			 * \param variant Shader features to look for.
+			 * \return The variant's pipeline, or the default pipeline if the variant wasn't built.
+			 */
+			VkPipeline GetVariant(const KVulkanShaderVariant &variant);
+
 			/**
 			 * \brief Transfer SPIR-V shader code into a Vulkan module.
 			 *
@@ -26,12 +26,25 @@ namespace Kitty
 {
 	namespace Vulkan
 	{
-		// Per-instance data block
+		// Per-instance data block, packed to keep the instance stream small
 		struct InstanceData
 		{
 			glm::vec3 pos;
-			glm::vec3 rot;
-			float scale;
+			int16_t rot[4]; // Rotation quaternion (x, y, z, w) as snorm16
+			uint32_t parent; // Object table index of the instanced object
+			uint16_t scale; // Uniform scale as a half float
+			uint16_t padding;
+		};
+
+		//! Entry of the object table storage buffer, laid out for std430.
+		struct KObjectData
+		{
+			glm::mat4 matrix;
+			glm::mat4 normalMatrix; // Inverse transpose of the model matrix
+			glm::uvec4 lights; // Indices of the lights selected for the object
+			int32_t lightCount; // Number of selected lights, -1 to use the light clusters instead
+			uint32_t material; // Index into the material table
+			uint32_t padding[2];
 		};
 
 		struct Vertex
@@ -52,6 +65,17 @@ namespace Kitty
 				return bindingDescription;
 			}
 
+			//! Get the binding description of the position only stream used by the depth pre-pass.
+			static VkVertexInputBindingDescription getPositionBindingDescription()
+			{
+				VkVertexInputBindingDescription bindingDescription = {};
+				bindingDescription.binding = 0;
+				bindingDescription.stride = sizeof(glm::vec3);
+				bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+				return bindingDescription;
+			}
+
 			//! Get instance binding description (stride and input rate)
 			static std::array<VkVertexInputBindingDescription, 2> getInstanceBindingDescription()
 			{
@@ -92,10 +116,22 @@ namespace Kitty
 				return attributeDescriptions;
 			}
 
+			//! Get the attribute of the position only stream, same location as the full vertex's position.
+			static VkVertexInputAttributeDescription getPositionAttributeDescription()
+			{
+				VkVertexInputAttributeDescription attributeDescription = {};
+				attributeDescription.binding = 0;
+				attributeDescription.location = 0;
+				attributeDescription.format = VK_FORMAT_R32G32B32_SFLOAT;
+				attributeDescription.offset = 0;
+
+				return attributeDescription;
+			}
+
 			//! Get instance attributes (such as position and color).
-			static std::array<VkVertexInputAttributeDescription, 7> getInstanceAttributeDescriptions()
+			static std::array<VkVertexInputAttributeDescription, 8> getInstanceAttributeDescriptions()
 			{
-				std::array<VkVertexInputAttributeDescription, 7> attributeDescriptions = {};
+				std::array<VkVertexInputAttributeDescription, 8> attributeDescriptions = {};
 				std::array<VkVertexInputAttributeDescription, 4> vxAttributes = getAttributeDescriptions();
 
 				attributeDescriptions[0] = vxAttributes[0];
@@ -110,13 +146,18 @@ namespace Kitty
 
 				attributeDescriptions[5].binding = 1;
 				attributeDescriptions[5].location = 5;
-				attributeDescriptions[5].format = VK_FORMAT_R32G32B32_SFLOAT;
-				attributeDescriptions[5].offset = static_cast<uint32_t>(sizeof(float) * 3);
+				attributeDescriptions[5].format = VK_FORMAT_R16G16B16A16_SNORM;
+				attributeDescriptions[5].offset = static_cast<uint32_t>(offsetof(InstanceData, rot));
 
 				attributeDescriptions[6].binding = 1;
 				attributeDescriptions[6].location = 6;
-				attributeDescriptions[6].format = VK_FORMAT_R32_SFLOAT;
-				attributeDescriptions[6].offset = static_cast<uint32_t>(sizeof(float) * 6);
+				attributeDescriptions[6].format = VK_FORMAT_R16_SFLOAT;
+				attributeDescriptions[6].offset = static_cast<uint32_t>(offsetof(InstanceData, scale));
+
+				attributeDescriptions[7].binding = 1;
+				attributeDescriptions[7].location = 7;
+				attributeDescriptions[7].format = VK_FORMAT_R32_UINT;
+				attributeDescriptions[7].offset = static_cast<uint32_t>(offsetof(InstanceData, parent));
 
 				return attributeDescriptions;
 			}
@@ -129,14 +170,41 @@ namespace Kitty
 
 		struct KVulkanPushConstants
 		{
-			VkBool32 usePhong;
 			uint32_t numLights;
 		};
 
-		struct vxDynamicUBO
+		/**
+		 * \brief Shader features compiled into a pipeline variant through specialization constants.
+		 *
+		 * Members are laid out in constant_id order, the struct is passed to Vulkan as is.
+		 */
+		struct KVulkanShaderVariant
 		{
-			glm::mat4 matrix;
-			glm::vec4 material;
+			//! Lighting model, same values as KE_MATERIALS. (0 = Simple, 1 = Phong)
+			uint32_t lightingModel = 1;
+			//! Upper bound of the light loop, must be at least the number of lights drawn with it.
+			uint32_t maxLights = KE_MAX_CLUSTER_LIGHTS;
+			//! Sample the diffuse texture or not.
+			VkBool32 hasTexture = VK_TRUE;
+
+			/**
+			 * \brief Get a key uniquely identifying the variant.
+			 *
+			 * \return Variant key.
+			 */
+			uint64_t GetKey() const
+			{
+				return (static_cast<uint64_t>(lightingModel) << 40) | (static_cast<uint64_t>(maxLights) << 8) |
+				       (hasTexture ? 1 : 0);
+			}
+		};
+
+		//! Lights selected for a bucket of instances, laid out as in the shaders.
+		struct KLightSelection
+		{
+			glm::uvec4 lights; // Indices of the selected lights
+			int32_t count; // Number of selected lights, -1 to use the light clusters instead
+			int32_t padding[3];
 		};
 
 		struct KLightData
@@ -147,16 +215,13 @@ namespace Kitty
 			glm::vec4 attenuation;
 		};
 
-		struct LightUniformBufferObject
-		{
-			KLightData lights[KE_MAX_DYNAMIC_LIGHTS];
-		};
-
 		struct UniformBufferObject
 		{
 			glm::mat4 view;
 			glm::mat4 proj;
 			glm::vec4 worldAmbient;
+			glm::mat4 invView;
+			glm::mat4 invProj;
 		};
 
 		//! Command buffer fun!
@@ -172,8 +237,32 @@ namespace Kitty
 			 *
 			 * Commands in this function get recorded and are not updated every frame. Let
 			 * Kitty take care of this unless you know what you're doing. :)
+			 *
+			 * \param buf [in] Buffer being recorded.
+			 * \param imageIndex [in] Index of the swap chain image the buffer is recorded for.
+			 */
+			std::function<void(VkCommandBuffer buf, uint32_t imageIndex)> sceneStaticRenderCallback = nullptr;
+
+			/**
+			 * \brief Recorded commands split into batches which are recorded in parallel.
+			 *
+			 * Each batch is recorded into its own secondary command buffer on one of Kitty's
+			 * recording threads, so this may be called from several threads at once. When set,
+			 * this replaces sceneStaticRenderCallback.
+			 *
+			 * \param buf [in] Secondary buffer being recorded.
+			 * \param imageIndex [in] Index of the swap chain image the buffer is recorded for.
+			 * \param batch [in] Index of the batch to record.
 			 */
-			std::function<void(VkCommandBuffer buf)> sceneStaticRenderCallback = nullptr;
+			std::function<void(VkCommandBuffer buf, uint32_t imageIndex, uint32_t batch)> sceneBatchRenderCallback = nullptr;
+
+			/**
+			 * \brief How many batches sceneBatchRenderCallback should be called for.
+			 *
+			 * \param threadCount [in] Number of recording threads available.
+			 * \return Number of batches.
+			 */
+			std::function<uint32_t(uint32_t threadCount)> sceneBatchCount = nullptr;
 
 			/**
 			 * \brief If you need to execute custom commands while rendering, you want this.
@@ -181,11 +270,25 @@ namespace Kitty
 			 * Usually the scene instance takes care of this, don't go messing about with this
 			 * unless you know what you're doing.
 			 *
+			 * The buffer has already been begun and must be ended by the callback. It belongs to
+			 * the frame's command pool and is reused every frame, so don't free it.
+			 *
 			 * \param [in] Buffer to feed yummy commands to.
 			 * \param imageIndex [in] Index of current swap chain image being processed.
 			 */
 			std::function<void(VkCommandBuffer *buf, uint32_t imageIndex)> sceneRenderCallback = nullptr;
 
+			/**
+			 * \brief Lighting commands for the deferred render path.
+			 *
+			 * Recorded inline into the lighting subpass, after everything recorded by the scene
+			 * callbacks above has filled the G-buffer. Only used when deferred shading is enabled.
+			 *
+			 * \param buf [in] Buffer being recorded.
+			 * \param imageIndex [in] Index of the swap chain image the buffer is recorded for.
+			 */
+			std::function<void(VkCommandBuffer buf, uint32_t imageIndex)> sceneLightingRenderCallback = nullptr;
+
 			/**
 			 * \brief If you need to replace the recorded render pass code, this is the place to do it.
 			 *
@@ -193,7 +296,8 @@ namespace Kitty
 			 * Kitty do this. You should set the sceneRenderCallback in most cases where you need
 			 * to execute custom render commands.
 			 *
-			 * All parameters are filled in by Kitty, you just need to receive and use them.
+			 * All parameters are filled in by Kitty, you just need to receive and use them. Viewport
+			 * and scissor are dynamic state, so remember to set them before drawing.
 			 *
 			 * \param [in] cmdBuffer Contains the command buffer KVulkan is currently executing.
 			 * \param [in] pipeline Contains the active pipeline.
@@ -208,6 +312,16 @@ namespace Kitty
 			                   VkExtent2D swapChainExtent)> graphicsCmdPoolOverride = nullptr;
 		};
 
+		//! Everything a single frame in flight needs for itself.
+		struct KVulkanFrame
+		{
+			VkFence inFlightFence = VK_NULL_HANDLE;
+			VkSemaphore imageAvailableSemaphore = VK_NULL_HANDLE;
+			VkSemaphore renderFinishedSemaphore = VK_NULL_HANDLE;
+			VkCommandPool commandPool = VK_NULL_HANDLE;
+			VkCommandBuffer renderCommand = VK_NULL_HANDLE;
+		};
+
 		//! One big, happy package for passing around custom Vulkan settings.
 		struct KVulkanSettings
 		{
@@ -221,6 +335,21 @@ namespace Kitty
 			VkFramebufferCreateInfo framebufferInfo = {};
 			VkSamplerCreateInfo textureSamplerInfo = {};
 
+			//! Size in bytes of the persistent staging ring used for uploading data to the GPU.
+			VkDeviceSize transferStagingSize = 0;
+
+			//! How many frames the CPU may prepare ahead of the GPU.
+			uint32_t framesInFlight = 0;
+
+			//! Number of threads recording command buffers, 0 uses one per available core.
+			uint32_t recordingThreads = 0;
+
+			//! Directory the pipeline cache is kept in between runs, leave empty to not keep it at all.
+			std::string pipelineCacheDirectory = "";
+
+			//! Milliseconds the window size must stay put before the swap chain is resized.
+			uint32_t swapChainResizeDelay = 0;
+
 			//! Command buffer stuffsies.
 			KVulkanCommandSettings commands;
 
@@ -233,8 +362,13 @@ namespace Kitty
 		{
 			VkDescriptorSetLayoutBinding vertexShaderBinding = {};
 			VkDescriptorSetLayoutBinding fragmentShaderBinding = {};
-			VkDescriptorSetLayoutBinding vxUniformLayoutBinding = {};
+			VkDescriptorSetLayoutBinding objectTableLayoutBinding = {};
+			VkDescriptorSetLayoutBinding drawOrderLayoutBinding = {};
+			VkDescriptorSetLayoutBinding materialTableLayoutBinding = {};
 			VkDescriptorSetLayoutBinding lightsLayoutBinding = {};
+			VkDescriptorSetLayoutBinding clusterGridLayoutBinding = {};
+			VkDescriptorSetLayoutBinding clusterLightsLayoutBinding = {};
+			VkDescriptorSetLayoutBinding bucketLightsLayoutBinding = {};
 			VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
 			VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
 			VkViewport viewport = {};
@@ -262,9 +396,44 @@ namespace Kitty
 			std::vector<std::string> fragmentShaders = {};
 			std::vector<std::string> instanceVertexShaders = {};
 
+			//! Vertex shaders of the depth pre-pass, which has no fragment shaders.
+			std::vector<std::string> depthVertexShaders = {};
+			std::vector<std::string> depthInstanceVertexShaders = {};
+
+			//! Fragment shaders filling the G-buffer, replace fragmentShaders when shading deferred.
+			std::vector<std::string> gBufferFragmentShaders = {};
+			//! Shaders of the full screen deferred lighting pass.
+			std::vector<std::string> lightingVertexShaders = {};
+			std::vector<std::string> lightingFragmentShaders = {};
+
+			//! Formats of the albedo, normal and material G-buffer attachments, in that order.
+			std::vector<VkFormat> gBufferFormats = {};
+
 			std::vector<VkDescriptorPoolSize> descriptorPoolSizes = {};
 
+			//! Pipeline variants to build up front, in addition to the default one.
+			std::vector<KVulkanShaderVariant> shaderVariants = {};
+
 			bool doCreateInstancingPipeline = false;
+
+			/**
+			 * \brief Shade in a separate pass instead of while drawing objects.
+			 *
+			 * Objects write albedo, normals and material parameters into a G-buffer in the first
+			 * subpass of the main render pass, and a second subpass lights every pixel once by
+			 * reading them back as input attachments. Set before the engine is created.
+			 */
+			bool deferredShading = false;
+
+			/**
+			 * \brief Lay down depth before shading anything.
+			 *
+			 * Everything is drawn twice, first from a position only vertex stream without a
+			 * fragment shader, then for real with an equal depth test so only visible fragments
+			 * get shaded. Helps scenes with a lot of overdraw, costs vertex work in the rest.
+			 * Takes effect the next time the scene is actualized.
+			 */
+			bool depthPrePass = false;
 		};
 	}
 }
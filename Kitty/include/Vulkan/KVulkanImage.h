@@ -52,15 +52,46 @@ namespace Kitty
 			/**
 			 * \brief Function for transitioning one image layout to another.
 			 *
-			 * \param image Vulkan image to be transitioned.
+			 * Submits the transition on its own and waits for it. Prefer recording transitions into
+			 * a command buffer you are submitting anyway.
+			 *
 			 * \param format Image format.
 			 * \param oldLayout Old image layout.
 			 * \param newLayout Desired image layout.
 			 */
 			void TransitionImageLayout(VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout);
 
+			/**
+			 * \brief Record a layout transition into a command buffer.
+			 *
+			 * \param commandBuffer Command buffer to record the barrier into.
+			 * \param format Image format.
+			 * \param oldLayout Old image layout.
+			 * \param newLayout Desired image layout.
+			 */
+			void TransitionImageLayout(VkCommandBuffer commandBuffer, VkFormat format, VkImageLayout oldLayout,
+			                           VkImageLayout newLayout);
+
+			/**
+			 * \brief Fill in the barrier needed to transition one image layout to another.
+			 *
+			 * Lets callers gather barriers for several images and record them all with a single
+			 * vkCmdPipelineBarrier call.
+			 *
+			 * \param format Image format.
+			 * \param oldLayout Old image layout.
+			 * \param newLayout Desired image layout.
+			 * \param barrier [out] Image memory barrier for the transition.
+			 * \param srcStage [out] Pipeline stages the barrier waits on.
+			 * \param dstStage [out] Pipeline stages which wait on the barrier.
+			 */
+			void GetTransitionBarrier(VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout,
+			                          VkImageMemoryBarrier *barrier, VkPipelineStageFlags *srcStage,
+			                          VkPipelineStageFlags *dstStage);
+
 			VkImage image = {};
 			VkDeviceMemory imageMemory = {};
+			VkFormat format = VK_FORMAT_UNDEFINED;
 		};
 	}
 }
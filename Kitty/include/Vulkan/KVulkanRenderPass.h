@@ -29,6 +29,19 @@ namespace Kitty
 			KVulkan *context;
 			KVulkanDefaults defaults;
 
+			/**
+			 * \brief Create the two subpass render pass used for deferred shading.
+			 *
+			 * \param colorAttach Swap chain image attachment, written by the lighting subpass.
+			 * \param depthAttachment Depth attachment, read back by the lighting subpass.
+			 * \param colorAttachRef Reference to the swap chain image attachment.
+			 * \param depthAttachmentRef Reference to the depth attachment.
+			 * \param dependency Dependency on whatever came before the render pass.
+			 */
+			void CreateDeferredRenderPass(VkAttachmentDescription colorAttach, VkAttachmentDescription depthAttachment,
+			                              VkAttachmentReference colorAttachRef,
+			                              VkAttachmentReference depthAttachmentRef, VkSubpassDependency dependency);
+
 		public:
 			/**
 			 * \brief Create the Vulkan render pass instance.
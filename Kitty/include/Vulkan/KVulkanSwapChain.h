@@ -65,11 +65,13 @@ namespace Kitty
 			 * \param desiredFormat [optional] Request a specific surface format.
 			 * \param desiredPresentMode [optional] Request a specific present mode.
 			 * \param swapChainCreateInfo Custom swap chain creation info.
+			 * \param oldSwapChain [optional] Swap chain being replaced, it is retired but must still be destroyed.
 			 * \return KE_OK on success, error code on fail.
 			 */
 			KError Initialize(VkSurfaceFormatKHR *desiredFormat = nullptr,
 			                  VkPresentModeKHR *desiredPresentMode = nullptr,
-			                  VkSwapchainCreateInfoKHR *swapChainCreateInfo = nullptr);
+			                  VkSwapchainCreateInfoKHR *swapChainCreateInfo = nullptr,
+			                  VkSwapchainKHR oldSwapChain = VK_NULL_HANDLE);
 
 			/**
 			 * \brief Verify adequacy of swap chain.
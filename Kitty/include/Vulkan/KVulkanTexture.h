@@ -18,6 +18,7 @@
 #include "KVulkan.h"
 #include "KVulkanBuffer.h"
 #include "KVulkanImage.h"
+#include "KVulkanTransfer.h"
 
 using namespace Kitty::Error;
 
@@ -33,15 +34,8 @@ namespace Kitty
 			KVulkan *context;
 			KVulkanSettings *settings = nullptr;
 
-			/**
-			 * \brief Copy 2D data from a Vulkan buffer to an image.
-			 *
-			 * \param buffer Vulkan buffer containing texels.
-			 * \param image Vulkan image to copy the data to.
-			 * \param width Width of the data.
-			 * \param height Height of the data.
-			 */
-			void CopyFromBuffer2D(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
+			//! Transfer ticket of the last image upload.
+			uint64_t uploadTicket = 0;
 
 			/**
 			 * \brief Create an image view to present the texture through to Vulkan.
@@ -61,8 +55,6 @@ namespace Kitty
 			VkImageView textureImageView = VK_NULL_HANDLE;
 			KVulkanImage *image = nullptr;
 
-			// TODO: Set things up so only a single command buffer is used by these functions.
-
 			/**
 			 * \brief Load 2D 8-bit RGBA pixel data into the texture.
 			 *
@@ -0,0 +1,235 @@
+/**
+ * Kitty engine Vulkan implementation
+ * KVulkanTransfer.h
+ *
+ * Vulkan transfer manager for the Kitty graphics engine. Uploads are
+ * staged through a persistent ring buffer and recorded into batches
+ * which are submitted to the transfer queue together. This functions
+ * as an abstraction layer between Vulkan and the Kitty engine, direct
+ * access from the end user interface should never happen.
+ *
+ * \author Krista Koivisto
+ * \copyright Read included LICENSE file.
+ */
+
+#ifndef KENGINE_KVULKANTRANSFER_H
+#define KENGINE_KVULKANTRANSFER_H
+
+#include <vulkan/vulkan.h>
+#include <deque>
+#include <vector>
+#include "KVulkan.h"
+#include "KVulkanBuffer.h"
+#include "KVulkanImage.h"
+#include "KVulkanCommandPool.h"
+#include "../KError.h"
+
+using namespace Kitty::Error;
+
+namespace Kitty
+{
+	namespace Vulkan
+	{
+		class KVulkan;
+		class KVulkanBuffer;
+		class KVulkanImage;
+		class KVulkanCommandPool;
+
+		class KVulkanTransfer
+		{
+		private:
+			//! A buffer to image copy waiting to be recorded.
+			struct KImageCopy
+			{
+				VkBuffer srcBuffer = VK_NULL_HANDLE;
+				VkImage dstImage = VK_NULL_HANDLE;
+				VkBufferImageCopy region = {};
+			};
+
+			//! A batch of transfer commands which is submitted (and completes) as one.
+			struct KTransferBatch
+			{
+				VkCommandBuffer transferCmd = VK_NULL_HANDLE;
+				VkCommandBuffer acquireCmd = VK_NULL_HANDLE;
+				VkFence fence = VK_NULL_HANDLE;
+				VkSemaphore semaphore = VK_NULL_HANDLE;
+				uint64_t ticket = 0;
+				uint64_t ringEnd = 0;
+				bool hasBufferWrites = false;
+				std::vector<VkImageMemoryBarrier> copyBarriers = {};
+				std::vector<KImageCopy> imageCopies = {};
+				std::vector<VkImageMemoryBarrier> imageBarriers = {};
+				std::vector<KVulkanBuffer*> scratchBuffers = {};
+			};
+
+			KVulkan *context = nullptr;
+			VkDevice device = VK_NULL_HANDLE;
+
+			KVulkanCommandPool *transferPool = nullptr;
+			KVulkanCommandPool *acquirePool = nullptr;
+			KVulkanBuffer *stagingRing = nullptr;
+
+			uint32_t transferFamily = UINT32_MAX;
+			uint32_t graphicsFamily = UINT32_MAX;
+
+			// Ring positions are kept as ever-increasing byte counts, position in the buffer is count % size.
+			VkDeviceSize ringAlignment = 16;
+			uint64_t ringHead = 0;
+			uint64_t ringTail = 0;
+
+			KTransferBatch *recording = nullptr;
+			std::deque<KTransferBatch*> inFlight = {};
+			std::vector<KTransferBatch*> spareBatches = {};
+
+			uint64_t nextTicket = 1;
+			uint64_t completedTicket = 0;
+
+			/**
+			 * \brief Does data need to change queue family ownership before graphics can use it?
+			 *
+			 * \return true if the transfer and graphics queue families differ, otherwise false.
+			 */
+			bool NeedsOwnershipTransfer() { return transferFamily != graphicsFamily; }
+
+			/**
+			 * \brief Create a new batch along with its command buffers and synchronization primitives.
+			 *
+			 * \return Pointer to the new batch.
+			 */
+			KTransferBatch *CreateBatch();
+
+			/**
+			 * \brief Destroy a batch and its synchronization primitives.
+			 *
+			 * \param batch Batch to destroy.
+			 */
+			void DestroyBatch(KTransferBatch *batch);
+
+			/**
+			 * \brief Get the batch currently being recorded, beginning a new one if needed.
+			 *
+			 * \return Pointer to the recording batch.
+			 */
+			KTransferBatch *GetRecordingBatch();
+
+			/**
+			 * \brief Copy data into staging memory.
+			 *
+			 * Data is placed in the staging ring if it fits, reclaiming space from finished batches
+			 * (and waiting for them if it has to). Data larger than the whole ring gets a buffer of
+			 * its own which is released once the batch it belongs to has completed.
+			 *
+			 * \param data Data to stage.
+			 * \param size Size of the data in bytes.
+			 * \param srcBuffer [out] Buffer the data was staged in.
+			 * \return Offset of the data within srcBuffer.
+			 */
+			VkDeviceSize Stage(const void *data, VkDeviceSize size, VkBuffer *srcBuffer);
+
+			/**
+			 * \brief Record the image copies gathered for a batch.
+			 *
+			 * All images are moved into a transfer layout with one barrier, copied, and left for
+			 * Flush to move into their final layouts with one more barrier.
+			 *
+			 * \param batch Batch to record the copies into.
+			 */
+			void RecordImageCopies(KTransferBatch *batch);
+
+			/**
+			 * \brief Retire finished batches, freeing their staging memory for reuse.
+			 *
+			 * \param waitForOldest Block until the oldest batch in flight has completed.
+			 */
+			void Collect(bool waitForOldest = false);
+
+		public:
+			/**
+			 * \brief Create a transfer manager.
+			 *
+			 * \param mainContext Parent Vulkan context.
+			 * \param stagingSize Size of the persistent staging ring in bytes.
+			 */
+			explicit KVulkanTransfer(KVulkan *mainContext, VkDeviceSize stagingSize);
+			~KVulkanTransfer();
+
+			/**
+			 * \brief Queue an upload of host data into a buffer.
+			 *
+			 * The data is copied into staging memory immediately, so it may be freed as soon as
+			 * this returns. The copy itself happens when the batch is flushed.
+			 *
+			 * \param dst Destination buffer.
+			 * \param data Data to upload.
+			 * \param size Size of the data in bytes.
+			 * \param dstOffset [optional] Offset into the destination buffer.
+			 * \return Ticket which can be waited on for completion.
+			 */
+			uint64_t UploadBuffer(KVulkanBuffer *dst, const void *data, VkDeviceSize size, VkDeviceSize dstOffset = 0);
+
+			/**
+			 * \brief Queue an upload of host data into a 2D image.
+			 *
+			 * The image is expected to be in an undefined layout and will be in finalLayout, owned
+			 * by the graphics queue family, once the upload has completed. Barriers and copies for
+			 * all images uploaded before the next flush are recorded together and submitted once.
+			 *
+			 * \param dst Destination image.
+			 * \param data Texel data to upload.
+			 * \param size Size of the data in bytes.
+			 * \param width Width of the image.
+			 * \param height Height of the image.
+			 * \param finalLayout [optional] Layout the image should end up in.
+			 * \return Ticket which can be waited on for completion.
+			 */
+			uint64_t UploadImage2D(KVulkanImage *dst, const void *data, VkDeviceSize size, uint32_t width,
+			                       uint32_t height,
+			                       VkImageLayout finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+			/**
+			 * \brief Queue a copy from one buffer to another.
+			 *
+			 * The source buffer must stay alive until the returned ticket has completed.
+			 *
+			 * \param src Source buffer.
+			 * \param dst Destination buffer.
+			 * \param region Region of data to copy.
+			 * \return Ticket which can be waited on for completion.
+			 */
+			uint64_t CopyBuffer(KVulkanBuffer *src, KVulkanBuffer *dst, VkBufferCopy region);
+
+			/**
+			 * \brief Submit everything recorded so far to the transfer queue.
+			 *
+			 * Does not wait for the transfers to finish. Work submitted to the graphics queue
+			 * afterwards will see the uploaded data.
+			 *
+			 * \return Ticket of the submitted batch.
+			 */
+			uint64_t Flush();
+
+			/**
+			 * \brief Has the work belonging to a ticket completed?
+			 *
+			 * \param ticket Ticket returned by one of the upload functions.
+			 * \return true if completed, otherwise false.
+			 */
+			bool IsComplete(uint64_t ticket);
+
+			/**
+			 * \brief Block until the work belonging to a ticket has completed.
+			 *
+			 * \param ticket Ticket returned by one of the upload functions.
+			 */
+			void Wait(uint64_t ticket);
+
+			/**
+			 * \brief Submit all pending work and wait for all of it to complete.
+			 */
+			void WaitIdle();
+		};
+	}
+}
+
+
+#endif //KENGINE_KVULKANTRANSFER_H